@@ -0,0 +1,21 @@
+#ifndef E_BROADCAST_H
+#define E_BROADCAST_H
+
+#include "e_common.h"
+
+/*
+ * A message sent to many klients. It is copied once into a reference counted
+ * leaf that the output buffers of all recipients share, so queueing it costs
+ * one node per recipient no matter how large it is.
+ */
+struct EBroadcast {
+	struct RopeStr message;
+};
+
+int e_broadcast_init(struct EBroadcast *broadcast, struct Rope *message);
+
+int e_broadcast_queue(struct EBroadcast *broadcast, struct Rope *output);
+
+void e_broadcast_cleanup(struct EBroadcast *broadcast);
+
+#endif /* E_BROADCAST_H */
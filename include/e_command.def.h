@@ -1,5 +1,6 @@
 DEF(ping)
 DEF(shutdown)
+DEF(stats)
 
 //DEF(new)
 //DEF(open)
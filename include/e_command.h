@@ -15,4 +15,13 @@ struct ECommand {
 #include "e_command.def.h"
 #undef DEF
 
+enum ECommandId {
+#define DEF(cmd) E_COMMAND_##cmd,
+#include "e_command.def.h"
+#undef DEF
+	E_COMMAND_COUNT,
+};
+
+enum ECommandId e_command_lookup(struct RopeRange *name);
+
 #endif /* E_COMMAND_H */
@@ -0,0 +1,20 @@
+#ifndef E_COMMAND_HASH_H
+#define E_COMMAND_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * FNV-1a over a command name. build-command-hash searches for a seed that
+ * gives every command of e_command.def.h its own slot.
+ */
+static inline uint32_t
+e_command_hash(uint32_t seed, const uint8_t *data, size_t size) {
+	uint32_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+#endif /* E_COMMAND_HASH_H */
@@ -9,5 +9,6 @@
 #include <time.h>
 #include <assert.h>
 #include <errno.h>
+#include <sys/types.h>
 
 #endif
@@ -7,4 +7,30 @@
 int
 e_dokument_new(union EStruktur *e, struct EKonstrukt *k);
 
+/*
+ * Adds `klient` to the dokument. It starts at the current revision.
+ */
+int e_dokument_join(union EStruktur *e, union EStruktur *klient);
+
+/*
+ * Records that `klient` has seen `revision`. The history is trimmed to the
+ * revision all klients of the dokument have acknowledged.
+ */
+int e_dokument_acknowledge(
+		union EStruktur *e, union EStruktur *klient, size_t revision);
+
+/*
+ * Applies `edits` that `klient` made against `revision` of the dokument.
+ * Edits of klients that lag behind are transformed against everything
+ * applied since, so klients never wait for each other.
+ */
+int e_dokument_edit(
+		union EStruktur *e, union EStruktur *klient, size_t revision,
+		const struct RopeHistoryEdit *edits, size_t count);
+
+/*
+ * Reports the memory statistics of the content of the dokument.
+ */
+void e_dokument_stats(union EStruktur *e, struct RopeStats *stats);
+
 #endif /* E_DOKUMENT_H */
@@ -15,6 +15,6 @@ int e_klient_new(
 
 int e_klient_flush_output(union EStruktur *e);
 
-int e_klient_handle_input(union EStruktur *e, struct pollfd *pfd);
+int e_klient_handle_input(union EStruktur *e);
 
 #endif /* E_KLIENT_H */
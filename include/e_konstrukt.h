@@ -3,6 +3,18 @@
 
 #include "e_list.h"
 #include "e_rand_gen.h"
+#include "e_struktur.h"
+#include <sys/epoll.h>
+
+/*
+ * A file descriptor epoll can't watch, like a regular file. These are always
+ * ready, so their events are dispatched on every iteration.
+ */
+struct EReadyFd {
+	int fd;
+	uint32_t events;
+	uint64_t data;
+};
 
 struct EKonstrukt {
 	bool running;
@@ -13,12 +25,26 @@ struct EKonstrukt {
 	struct EList dokuments;
 
 	struct EList klients;
+	size_t klient_count;
+	size_t lauscher_count;
 
 	struct RopePool rope_pool;
 
+	// Backpressure settings new klients start with.
+	size_t output_high_mark;
+	size_t output_low_mark;
+	enum EOutputPolicy output_policy;
+
+	// Indexed by ECommandId, commands without a function are unknown.
 	const struct ECommand *commands;
 
-	struct pollfd *poll_list;
+	int epoll_fd;
+	struct EReadyFd *ready_fds;
+	size_t ready_count;
+	// Events dispatched again on the next iteration, see e_defer_event().
+	struct epoll_event *deferred;
+	size_t deferred_count;
+	size_t deferred_cap;
 
 	struct ERandGen rand_gen;
 };
@@ -29,4 +55,35 @@ int e_main(struct EKonstrukt *konstrukt, int argc, char *argv[]);
 
 void e_cleanup(struct EKonstrukt *konstrukt);
 
+int e_print_error(struct EKonstrukt *konstrukt, const char *format, ...);
+
+/*
+ * Waits for events and dispatches them to their strukturen.
+ */
+int e_handle_event(struct EKonstrukt *konstrukt);
+
+/*
+ * Registers `fd` edge triggered for `events`. Events are dispatched to the
+ * `handle_event` function of the type of `e`.
+ */
+int e_watch_fd(
+		struct EKonstrukt *konstrukt, union EStruktur *e,
+		enum EEventSource source, int fd, uint32_t events);
+
+/*
+ * Changes the events an already watched `fd` is registered for.
+ */
+int e_rewatch_fd(
+		struct EKonstrukt *konstrukt, union EStruktur *e,
+		enum EEventSource source, int fd, uint32_t events);
+
+/*
+ * Dispatches `events` to `e` again on the next iteration. Strukturen that
+ * stop early to let the others go first use this, as the edge triggered
+ * `fd` won't report the data that is left.
+ */
+int e_defer_event(
+		struct EKonstrukt *konstrukt, union EStruktur *e,
+		enum EEventSource source, uint32_t events);
+
 #endif /* E_KONSTRUKT_H */
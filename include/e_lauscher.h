@@ -0,0 +1,13 @@
+#ifndef E_LAUSCHER_H
+#define E_LAUSCHER_H
+
+#include "e_konstrukt.h"
+#include "e_struktur.h"
+
+/*
+ * Listens on the unix domain socket `path`. Every accepted connection
+ * becomes a klient. Only processes of the same user may connect.
+ */
+int e_lauscher_new(union EStruktur *e, struct EKonstrukt *k, const char *path);
+
+#endif /* E_LAUSCHER_H */
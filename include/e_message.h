@@ -3,15 +3,84 @@
 
 #include "e_common.h"
 
+struct EMessageFramer;
+
 struct EMessageParser {
 	struct Rope unescape_buffer;
 	struct Rope *message;
 	struct RopeCursor line;
 	struct RopeRange post;
+	// The framer that found the message, see e_message_parser_init_framed().
+	const struct EMessageFramer *framer;
+	size_t payload;
+};
+
+/*
+ * Finds the end of messages as their bytes arrive, so incomplete messages
+ * aren't parsed again on every read. Each byte is examined once.
+ */
+enum EMessageFrameState {
+	E_FRAME_SPACE,
+	E_FRAME_FIELD,
+	E_FRAME_QUOTED,
+	E_FRAME_AT,
+	E_FRAME_SIZE,
+	E_FRAME_STOPWORD,
+	E_FRAME_PAYLOAD,
+};
+
+/*
+ * A payload of a message, either `size` bytes followed by a newline or the
+ * lines up to `stopword`, which is kept in the stopwords of the framer.
+ * `start` and `end` are the offsets of its data in the message.
+ */
+struct EMessagePayload {
+	uint64_t size;
+	size_t stopword_index;
+	size_t stopword_size;
+	size_t start;
+	size_t end;
+};
+
+struct EMessageFramer {
+	enum EMessageFrameState state;
+	// Bytes of the current message that have been examined.
+	size_t size;
+	uint8_t quote;
+	bool escaped;
+
+	struct EMessagePayload *payloads;
+	size_t payload_count;
+	size_t payload_cap;
+	uint8_t *stopwords;
+	size_t stopwords_size;
+	size_t stopwords_cap;
+
+	// The payload that is currently read.
+	size_t payload;
+	// Bytes a sized payload still needs.
+	uint64_t remaining;
+	// Bytes of the stopword that match the current line, SIZE_MAX if the
+	// line doesn't match.
+	size_t match;
 };
 
+void e_message_framer_init(struct EMessageFramer *framer);
+
+int e_message_framer_feed(
+		struct EMessageFramer *framer, const uint8_t *data, size_t size,
+		size_t *consumed);
+
+void e_message_framer_reset(struct EMessageFramer *framer);
+
+void e_message_framer_cleanup(struct EMessageFramer *framer);
+
 int e_message_parser_init(struct EMessageParser *iter, struct Rope *message);
 
+int e_message_parser_init_framed(
+		struct EMessageParser *parser, struct Rope *message,
+		const struct EMessageFramer *framer);
+
 bool e_message_parser_next(
 		struct EMessageParser *iter, struct RopeRange *tgt, int *err);
 
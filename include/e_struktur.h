@@ -1,14 +1,25 @@
 #ifndef E_STRUKTUR_H
 #define E_STRUKTUR_H
 
+#include "e_broadcast.h"
 #include "e_common.h"
 #include "e_list.h"
 #include "e_message.h"
 
 union EStruktur;
 
+/*
+ * A struktur can watch up to two file descriptors. Events tell them apart
+ * by their source.
+ */
+enum EEventSource {
+	E_EVENT_READER,
+	E_EVENT_WRITER,
+};
+
 struct EStrukturType {
-	int (*notify)(union EStruktur *, struct Rope *);
+	int (*notify)(union EStruktur *, struct EBroadcast *);
+	int (*handle_event)(union EStruktur *, enum EEventSource, uint32_t);
 	void (*cleanup)(union EStruktur *);
 };
 
@@ -50,6 +61,7 @@ union EStruktur {
 	const struct EStrukturType e_struktur_type_##type = { \
 			.cleanup = e_##type##_cleanup, \
 			.notify = e_##type##_notify, \
+			.handle_event = e_##type##_handle_event, \
 	}
 
 int e_struktur_alloc(
@@ -10,8 +10,12 @@ STRUCT(EDokument, dokument, {
 	struct EBase base;
 
 	struct EList klients;
+	// The revision each klient has seen, by its slot in `klients`.
+	size_t *acknowledged;
 
 	struct Rope content;
+
+	struct RopeHistory history;
 })
 
 STRUCT(ECursor, cursor, {
@@ -33,10 +37,51 @@ STRUCT(EKlient, klient, {
 	size_t endpunkt_count;
 
 	struct Rope input_buffer;
+	// Where the message at the start of the input buffer ends.
+	struct EMessageFramer framer;
+	// Leaves the next read fills.
+	size_t read_leaves;
 	struct Rope output_buffer;
+	// Whether the writer is watched for EPOLLOUT.
+	bool writing;
+	// Whether the reader is closed and the klient only sends pending output.
+	bool closing;
+
+	// Backpressure, see klient_update_backpressure(). The klient is lagging
+	// from when its output reaches the high mark until it drains to the low
+	// mark.
+	size_t output_high_mark;
+	size_t output_low_mark;
+	enum EOutputPolicy {
+		// Notifications are dropped and replaced by a single resync.
+		E_OUTPUT_COALESCE,
+		// Messages of the klient are not handled.
+		E_OUTPUT_PAUSE,
+		// The klient is disconnected.
+		E_OUTPUT_DISCONNECT,
+	} output_policy;
+	bool lagging;
+	// Whether notifications were dropped and a resync is due.
+	bool resync;
+	// Whether the klient is disconnected for its output.
+	bool overflowed;
+	size_t output_peak;
+	size_t coalesced_count;
 
 	int writer_fd;
 	int reader_fd;
+
+	// Credentials of the peer of a socket, -1 for other klients.
+	pid_t peer_pid;
+	uid_t peer_uid;
+	gid_t peer_gid;
+})
+
+STRUCT(ELauscher, lauscher, {
+	struct EBase base;
+
+	int fd;
+	char path[108];
 })
 
 STRUCT(EEndpunkt, endpunkt, {
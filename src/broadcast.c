@@ -0,0 +1,81 @@
+#include <e_broadcast.h>
+#include <string.h>
+
+int
+e_broadcast_init(struct EBroadcast *broadcast, struct Rope *message) {
+	int rv = 0;
+	struct RopeRange range = {0};
+	struct RopeIterator it = {0};
+	struct RopeStr str = {0};
+	uint8_t *data = NULL;
+	const size_t size = rope_size(message, ROPE_BYTE);
+
+	rv = rope_str_alloc(&broadcast->message, size, &data);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_to_range(message, &range);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_iterator_init(&it, &range, 0);
+	if (rv < 0) {
+		goto out;
+	}
+	while (rope_iterator_next(&it, &str)) {
+		size_t str_size = 0;
+		const uint8_t *str_data = rope_str_data(&str, &str_size);
+		memcpy(data, str_data, str_size);
+		data += str_size;
+	}
+	rope_str_alloc_commit(&broadcast->message, size);
+
+out:
+	if (rv < 0) {
+		rope_str_cleanup(&broadcast->message);
+	}
+	rope_str_cleanup(&str);
+	rope_iterator_cleanup(&it);
+	rope_range_cleanup(&range);
+	return rv;
+}
+
+/*
+ * Appends the message to `output`. The leaf shares the data of the
+ * broadcast, so nothing is copied.
+ */
+int
+e_broadcast_queue(struct EBroadcast *broadcast, struct Rope *output) {
+	int rv = 0;
+	struct RopeCursor cursor = {0};
+	if (rope_str_size(&broadcast->message, ROPE_BYTE) == 0) {
+		goto out;
+	}
+
+	struct RopeNode *node = rope_node_new(output->pool);
+	if (node == NULL) {
+		rv = -ENOMEM;
+		goto out;
+	}
+	rv = rope_str_clone(&node->data.leaf, &broadcast->message);
+	if (rv < 0) {
+		rope_node_free(node, output->pool);
+		goto out;
+	}
+	rv = rope_to_end_cursor(output, &cursor);
+	if (rv < 0) {
+		rope_node_free(node, output->pool);
+		goto out;
+	}
+	// Takes the node, even if it fails.
+	rv = rope_cursor_insert_node(&cursor, node);
+
+out:
+	rope_cursor_cleanup(&cursor);
+	return rv;
+}
+
+void
+e_broadcast_cleanup(struct EBroadcast *broadcast) {
+	rope_str_cleanup(&broadcast->message);
+}
@@ -1,5 +1,66 @@
 #include <e.h>
 #include <e_command.h>
+#include <e_command_hash.h>
+#include <e_command_table.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *const command_names[] = {
+#define DEF(cmd) #cmd,
+#include <e_command.def.h>
+#undef DEF
+};
+
+/*
+ * Copies the name to `buffer` leaf by leaf. Returns false if it doesn't
+ * fit, as no command is that long then.
+ */
+static bool
+command_name(struct RopeRange *range, uint8_t *buffer, size_t *size) {
+	const size_t name_size = rope_range_size(range, ROPE_BYTE);
+	size_t index = 0;
+	size_t copied = 0;
+	if (name_size == 0 || name_size >= sizeof(((struct ECommand *)0)->name)) {
+		return false;
+	}
+
+	struct RopeNode *node = rope_cursor_node(rope_range_start(range), &index);
+	for (; copied < name_size; node = rope_node_next(node)) {
+		size_t leaf_size = 0;
+		const uint8_t *data = node ? rope_node_value(node, &leaf_size) : NULL;
+		if (data == NULL) {
+			return false;
+		}
+		const size_t chunk = CX_MIN(name_size - copied, leaf_size - index);
+		memcpy(&buffer[copied], &data[index], chunk);
+		copied += chunk;
+		index = 0;
+	}
+	*size = name_size;
+	return true;
+}
+
+/*
+ * Returns the command called `name`, or E_COMMAND_COUNT if there is none,
+ * with a single lookup in the perfect hash generated by build-command-hash.
+ */
+enum ECommandId
+e_command_lookup(struct RopeRange *name) {
+	uint8_t buffer[sizeof(((struct ECommand *)0)->name)];
+	size_t size = 0;
+	if (!command_name(name, buffer, &size)) {
+		return E_COMMAND_COUNT;
+	}
+
+	const uint32_t hash = e_command_hash(E_COMMAND_HASH_SEED, buffer, size);
+	const uint8_t id = e_command_slots[hash & (E_COMMAND_HASH_SIZE - 1)];
+	if (id == UINT8_MAX || strlen(command_names[id]) != size ||
+		memcmp(command_names[id], buffer, size) != 0) {
+		return E_COMMAND_COUNT;
+	}
+	return (enum ECommandId)id;
+}
 
 int
 e_command_ping(struct EKonstrukt *konstrukt, union EStruktur *e) {
@@ -20,6 +81,39 @@ e_command_shutdown(struct EKonstrukt *konstrukt, union EStruktur *e) {
 	return 0;
 }
 
+/*
+ * Reports the queue depth of every klient, so operators can tell which one
+ * is lagging. The first line holds the number of klients that follow.
+ */
+int
+e_command_stats(struct EKonstrukt *konstrukt, union EStruktur *e) {
+	int rv = 0;
+	assert(e->base->type == &e_struktur_type_klient);
+	struct Rope *output = &e->klient->output_buffer;
+	char line[160];
+	union EStruktur klient = {0};
+
+	snprintf(line, sizeof(line), "stats %zu\n", konstrukt->klient_count);
+	rv = rope_append_str(output, line);
+	for (uint64_t it = 0;
+		 e_list_it(&klient, konstrukt, &konstrukt->klients, &it);) {
+		if (rv < 0) {
+			// The iterator releases the klient on the next call.
+			continue;
+		}
+		snprintf(
+				line, sizeof(line),
+				"klient %" PRIu64 " output %zu peak %zu lagging %i "
+				"coalesced %zu\n",
+				klient.base->id,
+				rope_size(&klient.klient->output_buffer, ROPE_BYTE),
+				klient.klient->output_peak, klient.klient->lagging,
+				klient.klient->coalesced_count);
+		rv = rope_append_str(output, line);
+	}
+	return rv;
+}
+
 int
 e_command_endpoint(struct EKonstrukt *konstrukt, union EStruktur *e) {
 	(void)konstrukt;
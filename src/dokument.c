@@ -1,16 +1,155 @@
 #include "e_list.h"
+#include <e_dokument.h>
+#include <e_konstrukt.h>
 #include <e_struktur.h>
+#include <stdlib.h>
 
 E_TYPE_BEGIN(dokument);
 
 int
 e_dokument_new(union EStruktur *e, struct EKonstrukt *k) {
 	int rv = E_TYPE_ALLOC(e, k);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_init(&e->dokument->content, &k->rope_pool);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_history_init(
+			&e->dokument->history, &e->dokument->content, ROPE_CP);
+	if (rv < 0) {
+		goto out;
+	}
+out:
 	return rv;
 }
 
 static int
-e_dokument_notify(union EStruktur *e, struct Rope *message) {
+dokument_slot(
+		struct EDokument *dokument, union EStruktur *klient, size_t *slot) {
+	for (size_t i = 0; i < dokument->klients.cap; i++) {
+		if (dokument->klients.ids[i] == klient->base->id) {
+			*slot = i;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+/*
+ * Drops the history that every klient has acknowledged. Edits against
+ * older revisions are rejected from then on.
+ */
+static void
+dokument_trim(union EStruktur *e) {
+	struct EDokument *dokument = e->dokument;
+	struct EKonstrukt *k = e->base->konstrukt;
+	size_t revision = rope_history_revision(&dokument->history);
+	union EStruktur klient;
+	for (uint64_t it = 0; e_list_it(&klient, k, &dokument->klients, &it);) {
+		revision = CX_MIN(revision, dokument->acknowledged[it - 1]);
+	}
+	rope_history_trim(&dokument->history, revision);
+}
+
+static void
+dokument_acknowledge(union EStruktur *e, size_t slot, size_t revision) {
+	struct EDokument *dokument = e->dokument;
+	if (revision > dokument->acknowledged[slot]) {
+		dokument->acknowledged[slot] = revision;
+		dokument_trim(e);
+	}
+}
+
+int
+e_dokument_join(union EStruktur *e, union EStruktur *klient) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	struct EDokument *dokument = e->dokument;
+	size_t slot = 0;
+
+	// e_list_add() at most doubles the list.
+	size_t *acknowledged = realloc(
+			dokument->acknowledged,
+			CX_MAX(1, dokument->klients.cap * 2) * sizeof(size_t));
+	if (acknowledged == NULL) {
+		rv = -ENOMEM;
+		goto out;
+	}
+	dokument->acknowledged = acknowledged;
+	rv = e_list_add(&dokument->klients, klient);
+	if (rv < 0) {
+		rv = -ENOMEM;
+		goto out;
+	}
+	rv = dokument_slot(dokument, klient, &slot);
+	if (rv < 0) {
+		goto out;
+	}
+	acknowledged[slot] = rope_history_revision(&dokument->history);
+
+out:
+	return rv;
+}
+
+int
+e_dokument_acknowledge(
+		union EStruktur *e, union EStruktur *klient, size_t revision) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	struct EDokument *dokument = e->dokument;
+	size_t slot = 0;
+
+	rv = dokument_slot(dokument, klient, &slot);
+	if (rv < 0) {
+		goto out;
+	} else if (revision > rope_history_revision(&dokument->history)) {
+		rv = -EINVAL;
+		goto out;
+	}
+	dokument_acknowledge(e, slot, revision);
+
+out:
+	return rv;
+}
+
+int
+e_dokument_edit(
+		union EStruktur *e, union EStruktur *klient, size_t revision,
+		const struct RopeHistoryEdit *edits, size_t count) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	struct EDokument *dokument = e->dokument;
+	size_t slot = 0;
+
+	rv = dokument_slot(dokument, klient, &slot);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_history_apply(&dokument->history, revision, edits, count);
+	if (rv < 0) {
+		goto out;
+	}
+	// The klient made its edits against `revision`, so it has seen it.
+	dokument_acknowledge(e, slot, revision);
+
+out:
+	return rv;
+}
+
+void
+e_dokument_stats(union EStruktur *e, struct RopeStats *stats) {
+	E_TYPE_ASSERT(e);
+	rope_stats(&e->dokument->content, stats);
+}
+
+/*
+ * Queues `message` for every klient of the dokument. They all share the
+ * same copy of it.
+ */
+static int
+e_dokument_notify(union EStruktur *e, struct EBroadcast *message) {
 	E_TYPE_ASSERT(e);
 	int rv = 0;
 	struct EKonstrukt *k = e->base->konstrukt;
@@ -24,9 +163,23 @@ e_dokument_notify(union EStruktur *e, struct Rope *message) {
 	return rv;
 }
 
+static int
+e_dokument_handle_event(
+		union EStruktur *e, enum EEventSource source, uint32_t events) {
+	E_TYPE_ASSERT(e);
+	// Dokuments don't watch file descriptors.
+	(void)source;
+	(void)events;
+	return 0;
+}
+
 static void
 e_dokument_cleanup(union EStruktur *e) {
 	E_TYPE_ASSERT(e);
+	rope_history_cleanup(&e->dokument->history);
+	rope_cleanup(&e->dokument->content);
+	e_list_cleanup(&e->dokument->klients);
+	free(e->dokument->acknowledged);
 }
 
 E_TYPE_END(dokument);
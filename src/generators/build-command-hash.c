@@ -0,0 +1,68 @@
+/*
+ * Generates a perfect hash over the commands of e_command.def.h. The table
+ * maps the slot of a name to its ECommandId, UINT8_MAX marks empty slots.
+ */
+#include <e_command_hash.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *const names[] = {
+#define DEF(cmd) #cmd,
+#include <e_command.def.h>
+#undef DEF
+};
+
+#define COUNT (sizeof(names) / sizeof(*names))
+#define MAX_SIZE 1024
+#define TRIES_PER_SIZE 100000
+
+_Static_assert(COUNT < UINT8_MAX, "Too many commands for the slot table");
+
+static uint32_t
+slot(uint32_t seed, size_t i, size_t size) {
+	const uint8_t *name = (const uint8_t *)names[i];
+	return e_command_hash(seed, name, strlen(names[i])) & (size - 1);
+}
+
+static int
+try_seed(uint32_t seed, size_t size, uint8_t *slots) {
+	memset(slots, UINT8_MAX, size);
+	for (size_t i = 0; i < COUNT; i++) {
+		const uint32_t s = slot(seed, i, size);
+		if (slots[s] != UINT8_MAX) {
+			return -1;
+		}
+		slots[s] = (uint8_t)i;
+	}
+	return 0;
+}
+
+int
+main(void) {
+	uint8_t slots[MAX_SIZE];
+	size_t size = 1;
+	while (size < COUNT * 2) {
+		size *= 2;
+	}
+
+	for (; size <= MAX_SIZE; size *= 2) {
+		for (uint32_t seed = 2166136261u;
+			 seed != 2166136261u + TRIES_PER_SIZE; seed++) {
+			if (try_seed(seed, size, slots) < 0) {
+				continue;
+			}
+			printf("/* Generated by build-command-hash, do not edit. */\n");
+			printf("#define E_COMMAND_HASH_SEED 0x%08xu\n", (unsigned)seed);
+			printf("#define E_COMMAND_HASH_SIZE %zu\n", size);
+			printf("static const uint8_t "
+				   "e_command_slots[E_COMMAND_HASH_SIZE] = {\n");
+			for (size_t i = 0; i < size; i++) {
+				printf("\t%u,\n", slots[i]);
+			}
+			printf("};\n");
+			return 0;
+		}
+	}
+	fprintf(stderr, "No perfect hash for %zu commands\n", COUNT);
+	return 1;
+}
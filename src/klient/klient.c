@@ -1,25 +1,58 @@
+#define _GNU_SOURCE
+
 #include <e_klient.h>
 #include <e_konstrukt.h>
 #include <e_command.h>
 #include <e_list.h>
 #include <e_struktur.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <rope.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+// Reads fill up to 256 leaves, about 256 KiB.
+#define KLIENT_READ_MAX_LEAVES 256
+// Messages and bytes read a klient gets per event before the others get
+// their turn.
+#define KLIENT_MESSAGE_BUDGET 128
+#define KLIENT_READ_BUDGET (1024 * 1024)
+
 E_TYPE_BEGIN(klient);
 
+static int
+klient_set_nonblocking(int fd) {
+	const int flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		return -errno;
+	}
+	return 0;
+}
+
 int
 e_klient_new(
 		union EStruktur *e, struct EKonstrukt *k, int reader_fd,
 		int writer_fd) {
 	int rv = E_TYPE_ALLOC(e, k);
 
+	if (rv < 0) {
+		goto out;
+	}
+
 	e->klient->reader_fd = reader_fd;
 	e->klient->writer_fd = writer_fd;
+	e->klient->peer_pid = -1;
+	e->klient->peer_uid = -1;
+	e->klient->peer_gid = -1;
+	e->klient->output_high_mark = k->output_high_mark;
+	e->klient->output_low_mark = k->output_low_mark;
+	e->klient->output_policy = k->output_policy;
+	e_message_framer_init(&e->klient->framer);
+	k->klient_count++;
 
 	rv = e_list_add(&k->klients, e);
 	if (rv < 0) {
@@ -34,165 +67,506 @@ e_klient_new(
 		goto out;
 	}
 
+	// Events are edge triggered, so reads and writes must not block.
+	rv = klient_set_nonblocking(reader_fd);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = klient_set_nonblocking(writer_fd);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = e_watch_fd(k, e, E_EVENT_READER, reader_fd, EPOLLIN);
+	if (rv < 0) {
+		goto out;
+	}
+	if (writer_fd != reader_fd) {
+		// Without EPOLLOUT this only reports errors and hangups.
+		rv = e_watch_fd(k, e, E_EVENT_WRITER, writer_fd, 0);
+	}
+
 out:
 	return rv;
 }
 
+/*
+ * Watches the writer for EPOLLOUT only while there's output left, so idle
+ * klients don't wake up the konstrukt.
+ */
 static int
-e_klient_notify(union EStruktur *e, struct Rope *message) {
-	E_TYPE_ASSERT(e);
+klient_watch_output(union EStruktur *e, bool writing) {
 	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
 	struct EKlient *klient = e->klient;
+	const uint32_t events = writing ? EPOLLOUT : 0;
 
-	struct RopeRange source = {0};
-	struct RopeCursor output = {0};
-
-	rv = rope_to_range(message, &source);
-	if (rv < 0) {
-		goto out;
-	}
-
-	rv = rope_to_end_cursor(&klient->output_buffer, &output);
-	if (rv < 0) {
+	if (klient->writing == writing) {
 		goto out;
+	} else if (klient->writer_fd == klient->reader_fd) {
+		rv = e_rewatch_fd(
+				k, e, E_EVENT_READER, klient->reader_fd, EPOLLIN | events);
+	} else {
+		rv = e_rewatch_fd(k, e, E_EVENT_WRITER, klient->writer_fd, events);
 	}
-
-	rv = rope_range_copy_to(&source, &output, 0);
 	if (rv < 0) {
 		goto out;
 	}
-
+	klient->writing = writing;
 out:
-	rope_range_cleanup(&source);
-	rope_cursor_cleanup(&output);
 	return rv;
 }
 
-int
-e_klient_handle_input(union EStruktur *e, struct pollfd *pfd) {
-	E_TYPE_ASSERT(e);
+static bool
+klient_input_paused(struct EKlient *klient) {
+	return klient->output_policy == E_OUTPUT_PAUSE &&
+			(klient->lagging ||
+			 rope_size(&klient->output_buffer, ROPE_BYTE) >=
+					 klient->output_high_mark);
+}
+
+/*
+ * Applies the output policy of a klient that doesn't read its output fast
+ * enough. Disconnecting is deferred to the next event of the klient, so
+ * notifying it never fails. Returns 1 if a resync was queued.
+ */
+static int
+klient_update_backpressure(union EStruktur *e) {
 	int rv = 0;
 	struct EKonstrukt *k = e->base->konstrukt;
-	uint8_t buffer[ROPE_STR_FAST_SIZE];
-	struct RopeCursor cursor = {0};
-	char *command_name = NULL;
+	struct EKlient *klient = e->klient;
+	const size_t size = rope_size(&klient->output_buffer, ROPE_BYTE);
 
-	if ((pfd->revents & POLLIN) == 0) {
-		return 0;
+	klient->output_peak = CX_MAX(klient->output_peak, size);
+	if (klient->overflowed) {
+		goto out;
+	} else if (size >= klient->output_high_mark) {
+		klient->lagging = true;
+		if (klient->output_policy != E_OUTPUT_DISCONNECT) {
+			goto out;
+		}
+		e_print_error(
+				k, "Disconnecting klient %" PRIu64 ": %zu bytes of output",
+				e->base->id, size);
+		klient->overflowed = true;
+		rope_clear(&klient->output_buffer);
+		rv = e_defer_event(k, e, E_EVENT_WRITER, 0);
+	} else if (klient->lagging && size <= klient->output_low_mark) {
+		klient->lagging = false;
+		if (klient->output_policy == E_OUTPUT_PAUSE) {
+			// The reader won't report the input that is left.
+			rv = e_defer_event(k, e, E_EVENT_READER, EPOLLIN);
+			if (rv < 0) {
+				goto out;
+			}
+		}
+		if (klient->resync) {
+			klient->resync = false;
+			rv = rope_append_str(&klient->output_buffer, "resync\n");
+			rv = rv < 0 ? rv : 1;
+		}
 	}
+out:
+	return rv;
+}
 
-	struct Rope *rope = &e->klient->input_buffer;
+/*
+ * Writes as much output as the writer takes and waits for EPOLLOUT if
+ * there's output left.
+ */
+static int
+klient_update_output(union EStruktur *e) {
+	int rv = 0;
+	struct Rope *output = &e->klient->output_buffer;
 
-	rv = read(e->klient->reader_fd, buffer, sizeof(buffer));
+	rv = klient_update_backpressure(e);
 	if (rv < 0) {
-		rv = -errno;
 		goto out;
 	}
-	size_t bytes_read = (size_t)rv;
-	if (bytes_read == 0) {
-		rv = -EPIPE;
-		goto out;
+	// A resync is only queued once the output drained.
+	for (bool flush = rope_size(output, ROPE_BYTE) > 0; flush;) {
+		rv = e_klient_flush_output(e);
+		if (rv < 0) {
+			goto out;
+		}
+		rv = klient_update_backpressure(e);
+		if (rv < 0) {
+			goto out;
+		}
+		flush = rv > 0;
 	}
+	rv = klient_watch_output(e, rope_size(output, ROPE_BYTE) > 0);
+out:
+	return rv;
+}
 
-	rv = rope_append(rope, buffer, bytes_read);
+static int
+e_klient_notify(union EStruktur *e, struct EBroadcast *message) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	struct EKlient *klient = e->klient;
+
+	if (klient->overflowed) {
+		goto out;
+	} else if (klient->lagging && klient->output_policy == E_OUTPUT_COALESCE) {
+		klient->resync = true;
+		klient->coalesced_count++;
+		goto out;
+	}
+	rv = e_broadcast_queue(message, &klient->output_buffer);
 	if (rv < 0) {
 		goto out;
 	}
+	rv = klient_update_output(e);
+
+out:
+	return rv;
+}
+
+/*
+ * Handles the message at the start of the input buffer once the framer
+ * found its end and removes it from the buffer.
+ */
+static int
+klient_handle_message(union EStruktur *e) {
+	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
+	struct Rope *rope = &e->klient->input_buffer;
+	enum ECommandId command = E_COMMAND_COUNT;
+	bool has_command = false;
+	struct RopeRange field = {0};
 
 	struct EMessageParser parser = {0};
-	rv = e_message_parser_init(&parser, &e->klient->input_buffer);
+	rv = e_message_parser_init_framed(&parser, rope, &e->klient->framer);
 	if (rv < 0) {
 		goto out;
 	}
 
-	struct RopeRange field = {0};
 	while (e_message_parser_next(&parser, &field, &rv)) {
 		if (rv < 0) {
 			break;
 		}
-		if (command_name == NULL) {
-			command_name = rope_range_to_cstr(&field, 0);
+		if (!has_command) {
+			command = e_command_lookup(&field);
+			has_command = true;
 		}
 	}
-	if (rv == -ROPE_ERROR_OOB) {
-		// Incomplete message, wait for more data.
-		rv = 0;
+	if (rv == -ENOMEM) {
+		goto out;
 	} else if (rv < 0) {
+		// The message is complete, so running out of data is a parse error
+		// as well.
 		rope_append_str(&e->klient->output_buffer, "error \"parse error\"\n");
-		rv = e_message_parse_consume(&parser);
-	} else {
-		bool found = false;
-		for (size_t i = 0; k->commands[i].function; i++) {
-			if (strcmp(command_name, k->commands[i].name) == 0) {
-				rv = k->commands[i].function(e->base->konstrukt, e);
-				found = true;
-				break;
-			}
+	} else if (command < E_COMMAND_COUNT && k->commands[command].function) {
+		rv = k->commands[command].function(e->base->konstrukt, e);
+	} else if (has_command) {
+		rope_append_str(&e->klient->output_buffer, "error \"unknown command\"\n");
+	}
+	rv = rope_delete(rope, ROPE_BYTE, 0, e->klient->framer.size);
+
+out:
+	rope_range_cleanup(&field);
+	e_message_parser_cleanup(&parser);
+	return rv;
+}
+
+/*
+ * Frames the bytes of the input buffer that haven't been looked at yet and
+ * handles the messages that are complete until `budget` runs out. Bytes are
+ * only looked at once, no matter how many reads an incomplete message takes.
+ */
+static int
+klient_handle_messages(union EStruktur *e, size_t *budget) {
+	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
+	struct EKlient *klient = e->klient;
+	struct Rope *rope = &klient->input_buffer;
+	struct RopeCursor cursor = {0};
+
+	rv = rope_cursor_init(&cursor, rope);
+	if (rv < 0) {
+		goto out;
+	}
+	while (k->running && *budget > 0 && !klient_input_paused(klient) &&
+		   klient->framer.size < rope_size(rope, ROPE_BYTE)) {
+		size_t index = 0;
+		int complete = 0;
+		rv = rope_cursor_move_to(&cursor, ROPE_BYTE, klient->framer.size, 0);
+		if (rv < 0) {
+			goto out;
 		}
-		if (!found) {
-			rope_append_str(&e->klient->output_buffer, "error \"unknown command\"\n");
+		struct RopeNode *node = rope_cursor_node(&cursor, &index);
+		for (; node != NULL && complete == 0; node = rope_node_next(node)) {
+			size_t size = 0;
+			size_t consumed = 0;
+			const uint8_t *data = rope_node_value(node, &size);
+			complete = e_message_framer_feed(
+					&klient->framer, &data[index], size - index, &consumed);
+			index = 0;
 		}
-		rv = e_message_parse_consume(&parser);
+		if (complete < 0) {
+			rv = complete;
+			goto out;
+		} else if (complete == 0) {
+			break;
+		}
+
+		rv = klient_handle_message(e);
+		e_message_framer_reset(&klient->framer);
+		if (rv < 0) {
+			goto out;
+		}
+		(*budget)--;
+	}
+
+out:
+	rope_cursor_cleanup(&cursor);
+	return rv;
+}
+
+/*
+ * Reads into new leaves that are inserted into the input buffer as they
+ * are, so the data is not copied again. The number of leaves grows while
+ * reads fill all of them and shrinks again if they stay mostly empty.
+ * Returns the number of bytes read.
+ */
+static ssize_t
+klient_read(union EStruktur *e) {
+	ssize_t rv = 0;
+	struct EKlient *klient = e->klient;
+	struct RopeStr leaves[KLIENT_READ_MAX_LEAVES] = {0};
+	struct iovec iov[KLIENT_READ_MAX_LEAVES];
+	struct RopeCursor cursor = {0};
+	const size_t count = CX_MAX(1, klient->read_leaves);
+
+	for (size_t i = 0; i < count; i++) {
+		uint8_t *data = NULL;
+		rv = rope_str_alloc(&leaves[i], ROPE_STR_FAST_SIZE, &data);
+		if (rv < 0) {
+			goto out;
+		}
+		iov[i].iov_base = data;
+		iov[i].iov_len = ROPE_STR_FAST_SIZE;
+	}
+
+	do {
+		rv = readv(klient->reader_fd, iov, (int)count);
+	} while (rv < 0 && errno == EINTR);
+	if (rv < 0) {
+		rv = -errno;
+		goto out;
 	}
 
+	const size_t bytes_read = (size_t)rv;
+	const size_t capacity = count * ROPE_STR_FAST_SIZE;
+	if (bytes_read == capacity) {
+		klient->read_leaves = CX_MIN(count * 2, KLIENT_READ_MAX_LEAVES);
+	} else if (bytes_read < capacity / 4) {
+		klient->read_leaves = CX_MAX(count / 2, 1);
+	}
+
+	rv = rope_cursor_init(&cursor, &klient->input_buffer);
 	if (rv < 0) {
 		goto out;
 	}
+	rv = rope_cursor_move_to(
+			&cursor, ROPE_BYTE, rope_size(&klient->input_buffer, ROPE_BYTE),
+			0);
+	if (rv < 0) {
+		goto out;
+	}
+	size_t remaining = bytes_read;
+	for (size_t i = 0; remaining > 0; i++) {
+		const size_t size = CX_MIN(remaining, ROPE_STR_FAST_SIZE);
+		rope_str_alloc_commit(&leaves[i], size);
+		// The leaf is moved into the rope.
+		rv = rope_cursor_insert(&cursor, &leaves[i], 0);
+		if (rv < 0) {
+			goto out;
+		}
+		remaining -= size;
+	}
+	rv = (ssize_t)bytes_read;
 
 out:
-	free(command_name);
-	rope_range_cleanup(&field);
-	e_message_parser_cleanup(&parser);
 	rope_cursor_cleanup(&cursor);
+	for (size_t i = 0; i < count; i++) {
+		rope_str_cleanup(&leaves[i]);
+	}
 	return rv;
 }
 
+/*
+ * Reads until the reader would block and handles all complete messages,
+ * so pipelined messages are answered with a single flush. A klient that
+ * runs out of its budget is deferred to the next iteration, so it doesn't
+ * starve the others. A paused klient is resumed by
+ * klient_update_backpressure(). Returns -EPIPE once the reader is closed.
+ */
+int
+e_klient_handle_input(union EStruktur *e) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
+	size_t message_budget = KLIENT_MESSAGE_BUDGET;
+	size_t read_budget = KLIENT_READ_BUDGET;
+	bool closed = false;
+
+	for (;;) {
+		// Messages left over from a deferred event come first.
+		rv = klient_handle_messages(e, &message_budget);
+		if (rv < 0) {
+			goto out;
+		} else if (!k->running) {
+			break;
+		} else if (klient_input_paused(e->klient)) {
+			// Closing the reader is noticed again once it's resumed.
+			goto out;
+		} else if (message_budget == 0 || read_budget == 0) {
+			rv = e_defer_event(k, e, E_EVENT_READER, EPOLLIN);
+			goto out;
+		} else if (closed) {
+			break;
+		}
+
+		const ssize_t bytes_read = klient_read(e);
+		if (bytes_read == -EAGAIN) {
+			break;
+		} else if (bytes_read < 0) {
+			rv = (int)bytes_read;
+			goto out;
+		}
+		closed = bytes_read == 0;
+		read_budget -= CX_MIN(read_budget, (size_t)bytes_read);
+	}
+	if (closed) {
+		rv = -EPIPE;
+	}
+
+out:
+	return rv;
+}
+
+/*
+ * Collects the leaves at the start of the output buffer into `iov`, up to
+ * the first compressed one. Returns the number of leaves.
+ */
+static int
+klient_output_iov(struct RopeCursor *cursor, struct iovec *iov, int max) {
+	int count = 0;
+	size_t index = 0;
+	struct RopeNode *node = rope_cursor_node(cursor, &index);
+
+	for (; node != NULL && count < max; node = rope_node_next(node)) {
+		size_t size = 0;
+		const uint8_t *data = rope_node_value(node, &size);
+		if (size == 0) {
+			continue;
+		}
+		iov[count].iov_base = (void *)data;
+		iov[count].iov_len = size;
+		count++;
+		if (rope_str_is_compressed(&node->data.leaf)) {
+			// Reading the next compressed leaf may reuse its cache slot.
+			break;
+		}
+	}
+	return count;
+}
+
+/*
+ * Writes the leaves of the output buffer with writev() until the writer
+ * would block. Written leaves are unlinked from the rope.
+ */
 int
 e_klient_flush_output(union EStruktur *e) {
 	int rv = 0;
-	char *output_data;
 	struct RopeCursor cursor = {0};
+	struct iovec iov[IOV_MAX];
 	E_TYPE_ASSERT(e);
 
 	struct Rope *rope = &e->klient->output_buffer;
 
-	// TODO: same as above, avoid copying the entire rope to a string.
-	size_t size = rope_size(rope, ROPE_BYTE);
-	output_data = rope_to_str(rope, 0);
-	if (output_data == NULL) {
-		rv = -ENOMEM;
+	rv = rope_cursor_init(&cursor, rope);
+	if (rv < 0) {
 		goto out;
 	}
+	while (rope_size(rope, ROPE_BYTE) > 0) {
+		rv = klient_output_iov(&cursor, iov, IOV_MAX);
+		if (rv < 0) {
+			goto out;
+		}
+		const ssize_t written = writev(e->klient->writer_fd, iov, rv);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		} else if (written < 0 && errno == EAGAIN) {
+			// Continue on EPOLLOUT.
+			rv = 0;
+			break;
+		} else if (written < 0) {
+			rv = -errno;
+			goto out;
+		}
+		rv = rope_cursor_delete(&cursor, ROPE_BYTE, (size_t)written);
+		if (rv < 0) {
+			goto out;
+		}
+	}
 
-	rv = write(e->klient->writer_fd, output_data, size);
-	if (rv < 0) {
-		rv = -errno;
+out:
+	rope_cursor_cleanup(&cursor);
+	return rv;
+}
+
+static int
+e_klient_handle_event(
+		union EStruktur *e, enum EEventSource source, uint32_t events) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+
+	if (e->klient->overflowed) {
+		rv = -EPIPE;
+		goto out;
+	} else if (
+			source == E_EVENT_READER &&
+			events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+		rv = e_klient_handle_input(e);
+	} else if (events & (EPOLLHUP | EPOLLERR)) {
+		rv = -EPIPE;
 		goto out;
 	}
-	size_t bytes_written = (size_t)rv;
-
-	rv = rope_cursor_init(&cursor, rope);
-	if (rv < 0) {
+	if (rv == -EPIPE) {
+		// The reader is closed, but pending replies are still sent.
+		e->klient->closing = true;
+		rv = 0;
+	} else if (rv < 0) {
 		goto out;
 	}
-	rv = rope_cursor_delete(&cursor, ROPE_BYTE, bytes_written);
+
+	rv = klient_update_output(e);
 	if (rv < 0) {
 		goto out;
 	}
-
+	if (e->klient->overflowed) {
+		rv = -EPIPE;
+	} else if (e->klient->closing &&
+		rope_size(&e->klient->output_buffer, ROPE_BYTE) == 0) {
+		rv = -EPIPE;
+	}
 out:
-	rope_cursor_cleanup(&cursor);
-	free(output_data);
 	return rv;
 }
 
 static void
 e_klient_cleanup(union EStruktur *e) {
 	E_TYPE_ASSERT(e);
+	e->base->konstrukt->klient_count--;
 	close(e->klient->reader_fd);
-	close(e->klient->writer_fd);
+	if (e->klient->writer_fd != e->klient->reader_fd) {
+		close(e->klient->writer_fd);
+	}
 	rope_cleanup(&e->klient->output_buffer);
 	rope_cleanup(&e->klient->input_buffer);
+	e_message_framer_cleanup(&e->klient->framer);
 }
 
 E_TYPE_END(klient);
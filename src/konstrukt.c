@@ -1,105 +1,220 @@
 #include <e_klient.h> // Temporary for debugging
 #include <e_konstrukt.h>
+#include <e_lauscher.h>
 #include <e_list.h>
 #include <e_struktur.h>
 
 #include <errno.h>
-#include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-static int
-handle_io(struct EKonstrukt *k) {
-	size_t poll_list_cap = k->klients.cap * 2;
+int
+e_print_error(struct EKonstrukt *konstrukt, const char *format, ...) {
+	(void)konstrukt;
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+	return 0;
+}
 
-	// TODO: rather exitting directly, wait for new connections for a certain
-	// time.
-	if (poll_list_cap == 0) {
-		k->running = false;
-		return 0;
+#define E_EVENT_BATCH 64
+#define E_EVENT_SOURCE_SHIFT 32
+// Output a klient may queue before its output policy kicks in.
+#define E_OUTPUT_HIGH_MARK (8 * 1024 * 1024)
+#define E_OUTPUT_LOW_MARK (1024 * 1024)
+
+static uint64_t
+event_data(union EStruktur *e, enum EEventSource source) {
+	return e->base->id | (uint64_t)source << E_EVENT_SOURCE_SHIFT;
+}
+
+static struct EReadyFd *
+find_ready_fd(struct EKonstrukt *k, int fd, uint64_t data) {
+	for (size_t i = 0; i < k->ready_count; i++) {
+		if (k->ready_fds[i].fd == fd && k->ready_fds[i].data == data) {
+			return &k->ready_fds[i];
+		}
 	}
+	return NULL;
+}
 
-	k->poll_list = realloc(k->poll_list, sizeof(struct pollfd) * poll_list_cap);
-	if (k->poll_list == NULL) {
+static int
+add_ready_fd(struct EKonstrukt *k, int fd, uint32_t events, uint64_t data) {
+	struct EReadyFd *ready_fds = realloc(
+			k->ready_fds, sizeof(struct EReadyFd) * (k->ready_count + 1));
+	if (ready_fds == NULL) {
 		return -ENOMEM;
 	}
-	memset(k->poll_list, 0, sizeof(struct pollfd) * poll_list_cap);
+	ready_fds[k->ready_count++] =
+			(struct EReadyFd){.fd = fd, .events = events, .data = data};
+	k->ready_fds = ready_fds;
+	return 0;
+}
 
-	struct pollfd *poll_list = k->poll_list;
+int
+e_watch_fd(
+		struct EKonstrukt *k, union EStruktur *e, enum EEventSource source,
+		int fd, uint32_t events) {
+	struct epoll_event event = {
+			.events = events | EPOLLET,
+			.data.u64 = event_data(e, source),
+	};
+	if (epoll_ctl(k->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0) {
+		return 0;
+	} else if (errno == EPERM) {
+		return add_ready_fd(k, fd, events, event.data.u64);
+	}
+	return -errno;
+}
 
-	size_t idx = 0;
-	union EStruktur e;
-	for (uint64_t it = 0; e_list_it(&e, k, &k->klients, &it);) {
-		poll_list[idx].fd = e.klient->reader_fd;
-		poll_list[idx].events = POLLIN;
-		idx++;
-		if (rope_size(&e.klient->output_buffer, ROPE_BYTE) == 0) {
-			continue;
+int
+e_rewatch_fd(
+		struct EKonstrukt *k, union EStruktur *e, enum EEventSource source,
+		int fd, uint32_t events) {
+	struct epoll_event event = {
+			.events = events | EPOLLET,
+			.data.u64 = event_data(e, source),
+	};
+	struct EReadyFd *ready_fd = find_ready_fd(k, fd, event.data.u64);
+	if (ready_fd != NULL) {
+		ready_fd->events = events;
+	} else if (epoll_ctl(k->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0) {
+		return -errno;
+	}
+	return 0;
+}
+
+int
+e_defer_event(
+		struct EKonstrukt *k, union EStruktur *e, enum EEventSource source,
+		uint32_t events) {
+	if (k->deferred_count == k->deferred_cap) {
+		const size_t cap = CX_MAX(8, k->deferred_cap * 2);
+		struct epoll_event *deferred =
+				realloc(k->deferred, sizeof(struct epoll_event) * cap);
+		if (deferred == NULL) {
+			return -ENOMEM;
 		}
-		poll_list[idx].fd = e.klient->writer_fd;
-		poll_list[idx].events = POLLOUT | POLLHUP;
-		idx++;
+		k->deferred = deferred;
+		k->deferred_cap = cap;
 	}
-	size_t timeout_ms = -1;
-	if (k->timeout_ms > 0) {
-		timeout_ms = k->timeout_ms;
+	k->deferred[k->deferred_count++] = (struct epoll_event){
+			.events = events,
+			.data.u64 = event_data(e, source),
+	};
+	return 0;
+}
+
+/*
+ * Returns false if the struktur the event belongs to is gone.
+ */
+static bool
+dispatch_event(struct EKonstrukt *k, const struct epoll_event *event) {
+	// Ids are 32 bit, see e_struktur_alloc().
+	const uint64_t id = event->data.u64 & UINT32_MAX;
+	const enum EEventSource source = event->data.u64 >> E_EVENT_SOURCE_SHIFT;
+	union EStruktur e = {.any = cx_rc_hash_map_retain(&k->struktur, id)};
+	if (e.any == NULL) {
+		// Released while handling an earlier event of the same batch.
+		return false;
 	}
-	int rv = poll(poll_list, idx, timeout_ms);
+
+	int rv = e.base->type->handle_event(&e, source, event->events);
 	if (rv < 0) {
-		return -errno;
+		if (rv != -EPIPE) {
+			e_print_error(k, "Error handling event: %d", rv);
+		}
+		// Drop the reference of the konstrukt, which closes the struktur.
+		cx_rc_hash_map_release_key(&k->struktur, id);
 	}
+	e_struktur_release(&e);
+	return rv >= 0;
+}
 
-	idx = 0;
-	for (uint64_t it = 0; e_list_it(&e, k, &k->klients, &it);) {
-		rv = e_klient_handle_input(&e, &poll_list[idx]);
-		idx++;
-		if (rope_size(&e.klient->output_buffer, ROPE_BYTE) == 0) {
-			continue;
-		}
-		if (poll_list[idx].revents & POLLOUT) {
-			rv = e_klient_flush_output(&e);
-			if (rv < 0) {
-				goto out;
-			}
+static void
+dispatch_ready_fds(struct EKonstrukt *k) {
+	for (size_t i = 0; i < k->ready_count;) {
+		const struct epoll_event event = {
+				.events = k->ready_fds[i].events,
+				.data.u64 = k->ready_fds[i].data,
+		};
+		if (event.events == 0 || dispatch_event(k, &event)) {
+			i++;
+		} else {
+			k->ready_fds[i] = k->ready_fds[--k->ready_count];
 		}
-		if (poll_list[idx].revents & POLLHUP) {
-			e_struktur_release(&e);
+	}
+}
+
+/*
+ * Dispatches the events deferred before this iteration. Events deferred
+ * while doing so wait for the next one.
+ */
+static void
+dispatch_deferred(struct EKonstrukt *k) {
+	const size_t count = k->deferred_count;
+	if (count == 0) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		const struct epoll_event event = k->deferred[i];
+		dispatch_event(k, &event);
+	}
+	k->deferred_count -= count;
+	memmove(k->deferred, &k->deferred[count],
+			sizeof(struct epoll_event) * k->deferred_count);
+}
+
+static bool
+has_ready_fds(struct EKonstrukt *k) {
+	for (size_t i = 0; i < k->ready_count; i++) {
+		if (k->ready_fds[i].events != 0) {
+			return true;
 		}
-		idx++;
 	}
-out:
-	return rv;
+	return false;
 }
 
-int
-e_handle_event(struct EKonstrukt *k) {
-	int rv = 0;
-	rv = handle_io(k);
-	if (rv < 0) {
-		goto out;
+static int
+handle_io(struct EKonstrukt *k) {
+	struct epoll_event events[E_EVENT_BATCH];
+
+	// TODO: rather exitting directly, wait for new connections for a certain
+	// time.
+	if (k->klient_count == 0 && k->lauscher_count == 0) {
+		k->running = false;
+		return 0;
 	}
 
-	union EStruktur e;
-	for (uint64_t it = 0; e_list_it(&e, k, &k->klients, &it);) {
+	int timeout_ms = k->timeout_ms > 0 ? k->timeout_ms : -1;
+	if (has_ready_fds(k) || k->deferred_count > 0) {
+		timeout_ms = 0;
+	}
+	int rv = epoll_wait(k->epoll_fd, events, E_EVENT_BATCH, timeout_ms);
+	if (rv < 0) {
+		return errno == EINTR ? 0 : -errno;
 	}
 
-out:
-	return rv;
+	const size_t count = (size_t)rv;
+	for (size_t i = 0; i < count; i++) {
+		dispatch_event(k, &events[i]);
+	}
+	dispatch_deferred(k);
+	dispatch_ready_fds(k);
+	return 0;
 }
 
 int
-e_print_error(struct EKonstrukt *konstrukt, const char *format, ...) {
-	(void)konstrukt;
-	va_list args;
-	va_start(args, format);
-	vfprintf(stderr, format, args);
-	va_end(args);
-	fprintf(stderr, "\n");
-	return 0;
+e_handle_event(struct EKonstrukt *k) {
+	return handle_io(k);
 }
 
 void
@@ -108,22 +223,98 @@ e_cleanup(struct EKonstrukt *konstrukt) {
 	e_list_cleanup(&konstrukt->dokuments);
 	e_list_cleanup(&konstrukt->klients);
 	rope_pool_cleanup(&konstrukt->rope_pool);
-	free(konstrukt->poll_list);
+	close(konstrukt->epoll_fd);
+	free(konstrukt->ready_fds);
+	free(konstrukt->deferred);
 }
 
-int
-e_main(struct EKonstrukt *konstrukt, int argc, char **argv) {
-	int rv = e_init(konstrukt, argc, argv);
-	if (rv < 0) {
-		e_print_error(konstrukt, "Error initializing konstrukt: %d", rv);
+static int
+parse_size(const char *arg, size_t *size) {
+	char *end = NULL;
+	errno = 0;
+	const unsigned long long value = strtoull(arg, &end, 10);
+	if (errno != 0 || end == arg || *end != '\0' || value > SIZE_MAX) {
+		return -EINVAL;
+	}
+	*size = (size_t)value;
+	return 0;
+}
+
+static int
+parse_output_policy(const char *arg, enum EOutputPolicy *policy) {
+	if (strcmp(arg, "coalesce") == 0) {
+		*policy = E_OUTPUT_COALESCE;
+	} else if (strcmp(arg, "pause") == 0) {
+		*policy = E_OUTPUT_PAUSE;
+	} else if (strcmp(arg, "disconnect") == 0) {
+		*policy = E_OUTPUT_DISCONNECT;
+	} else {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void
+print_usage(struct EKonstrukt *konstrukt, const char *name) {
+	e_print_error(
+			konstrukt,
+			"Usage: %s [-l socket] [-H bytes] [-L bytes] "
+			"[-P coalesce|pause|disconnect]",
+			name);
+}
+
+static int
+main_run(struct EKonstrukt *konstrukt, int argc, char **argv) {
+	int rv = 0;
+	const char *socket_path = NULL;
+	for (int opt; (opt = getopt(argc, argv, "l:H:L:P:")) != -1;) {
+		switch (opt) {
+		case 'l':
+			socket_path = optarg;
+			break;
+		case 'H':
+			rv = parse_size(optarg, &konstrukt->output_high_mark);
+			break;
+		case 'L':
+			rv = parse_size(optarg, &konstrukt->output_low_mark);
+			break;
+		case 'P':
+			rv = parse_output_policy(optarg, &konstrukt->output_policy);
+			break;
+		default:
+			// getopt() already reported the unknown option.
+			rv = -EINVAL;
+			break;
+		}
+		if (rv < 0 && opt != '?') {
+			e_print_error(konstrukt, "Invalid value for -%c: %s", opt, optarg);
+		}
+		if (rv < 0) {
+			print_usage(konstrukt, argv[0]);
+			goto out;
+		}
+	}
+	if (konstrukt->output_low_mark >= konstrukt->output_high_mark) {
+		e_print_error(konstrukt, "The low mark must be below the high mark");
+		print_usage(konstrukt, argv[0]);
+		rv = -EINVAL;
 		goto out;
 	}
 
 	union EStruktur e = {0};
-	rv = e_klient_new(&e, konstrukt, STDIN_FILENO, STDOUT_FILENO);
-	if (rv < 0) {
-		e_print_error(konstrukt, "Error creating initial klient: %d", rv);
-		goto out;
+	if (socket_path != NULL) {
+		rv = e_lauscher_new(&e, konstrukt, socket_path);
+		if (rv < 0) {
+			e_print_error(
+					konstrukt, "Error listening on %s: %d", socket_path, rv);
+			goto out;
+		}
+	} else {
+		rv = e_klient_new(&e, konstrukt, STDIN_FILENO, STDOUT_FILENO);
+		if (rv < 0) {
+			e_print_error(konstrukt, "Error creating initial klient: %d", rv);
+			goto out;
+		}
 	}
 
 	while (konstrukt->running) {
@@ -134,6 +325,19 @@ e_main(struct EKonstrukt *konstrukt, int argc, char **argv) {
 		rv = 0;
 	}
 
+out:
+	return rv;
+}
+
+int
+e_main(struct EKonstrukt *konstrukt, int argc, char **argv) {
+	int rv = e_init(konstrukt, argc, argv);
+	if (rv < 0) {
+		e_print_error(konstrukt, "Error initializing konstrukt: %d", rv);
+		goto out;
+	}
+
+	rv = main_run(konstrukt, argc, argv);
 	e_cleanup(konstrukt);
 
 out:
@@ -158,8 +362,18 @@ e_init(struct EKonstrukt *konstrukt, int argc, char **argv) {
 	if (rv < 0) {
 		goto out;
 	}
+	konstrukt->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (konstrukt->epoll_fd < 0) {
+		rv = -errno;
+		goto out;
+	}
+	// Klients that hang up are noticed by their failing writes.
+	signal(SIGPIPE, SIG_IGN);
 	konstrukt->running = true;
 	konstrukt->timeout_ms = 1000; // TODO: should be -1 by default.
+	konstrukt->output_high_mark = E_OUTPUT_HIGH_MARK;
+	konstrukt->output_low_mark = E_OUTPUT_LOW_MARK;
+	konstrukt->output_policy = E_OUTPUT_COALESCE;
 	rv = e_rand_gen_init(&konstrukt->rand_gen);
 	rope_pool_init(&konstrukt->rope_pool);
 out:
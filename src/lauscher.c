@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+
+#include <e_klient.h>
+#include <e_konstrukt.h>
+#include <e_lauscher.h>
+#include <e_struktur.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+E_TYPE_BEGIN(lauscher);
+
+static int
+lauscher_connect(const struct sockaddr_un *addr) {
+	int rv = 0;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		rv = -errno;
+		goto out;
+	}
+	if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+		rv = -errno;
+	}
+out:
+	if (fd >= 0) {
+		close(fd);
+	}
+	return rv;
+}
+
+/*
+ * Binds `fd` to `addr`. A socket file that is left over from a konstrukt
+ * that didn't shut down cleanly is replaced, one that is still in use isn't.
+ */
+static int
+lauscher_bind(int fd, const struct sockaddr_un *addr) {
+	if (bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0) {
+		return 0;
+	} else if (errno != EADDRINUSE) {
+		return -errno;
+	} else if (lauscher_connect(addr) != -ECONNREFUSED) {
+		return -EADDRINUSE;
+	} else if (unlink(addr->sun_path) < 0) {
+		return -errno;
+	} else if (bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+		return -errno;
+	}
+	return 0;
+}
+
+static int
+lauscher_listen(union EStruktur *e, const struct sockaddr_un *addr) {
+	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
+	struct ELauscher *lauscher = e->lauscher;
+
+	lauscher->fd =
+			socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (lauscher->fd < 0) {
+		rv = -errno;
+		goto out;
+	}
+	rv = lauscher_bind(lauscher->fd, addr);
+	if (rv < 0) {
+		goto out;
+	}
+	strcpy(lauscher->path, addr->sun_path);
+	if (listen(lauscher->fd, SOMAXCONN) < 0) {
+		rv = -errno;
+		goto out;
+	}
+	rv = e_watch_fd(k, e, E_EVENT_READER, lauscher->fd, EPOLLIN);
+	if (rv < 0) {
+		goto out;
+	}
+
+out:
+	return rv;
+}
+
+int
+e_lauscher_new(union EStruktur *e, struct EKonstrukt *k, const char *path) {
+	int rv = 0;
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		rv = -ENAMETOOLONG;
+		goto out;
+	}
+	strcpy(addr.sun_path, path);
+
+	rv = E_TYPE_ALLOC(e, k);
+	if (rv < 0) {
+		goto out;
+	}
+	e->lauscher->fd = -1;
+	k->lauscher_count++;
+
+	rv = lauscher_listen(e, &addr);
+	if (rv < 0) {
+		// Closes the socket and removes it again if it was bound.
+		e_struktur_release(e);
+		goto out;
+	}
+
+out:
+	return rv;
+}
+
+static int
+lauscher_add_klient(union EStruktur *e, int fd) {
+	int rv = 0;
+	struct EKonstrukt *k = e->base->konstrukt;
+	struct ucred cred = {0};
+	socklen_t cred_size = sizeof(cred);
+	union EStruktur klient = {0};
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) < 0) {
+		rv = -errno;
+		close(fd);
+		goto out;
+	} else if (cred.uid != geteuid()) {
+		e_print_error(k, "Rejected klient of user %u", (unsigned)cred.uid);
+		close(fd);
+		goto out;
+	}
+
+	rv = e_klient_new(&klient, k, fd, fd);
+	if (rv < 0) {
+		goto out;
+	}
+	klient.klient->peer_pid = cred.pid;
+	klient.klient->peer_uid = cred.uid;
+	klient.klient->peer_gid = cred.gid;
+out:
+	return rv;
+}
+
+static int
+e_lauscher_notify(union EStruktur *e, struct EBroadcast *message) {
+	E_TYPE_ASSERT(e);
+	(void)message;
+	return 0;
+}
+
+/*
+ * Accepts all pending connections. Events are edge triggered, so this has
+ * to go on until accept would block.
+ */
+static int
+e_lauscher_handle_event(
+		union EStruktur *e, enum EEventSource source, uint32_t events) {
+	E_TYPE_ASSERT(e);
+	int rv = 0;
+	(void)source;
+	(void)events;
+
+	for (;;) {
+		const int fd =
+				accept4(e->lauscher->fd, NULL, NULL,
+						SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0 && (errno == EINTR || errno == ECONNABORTED)) {
+			continue;
+		} else if (fd < 0 && errno == EAGAIN) {
+			break;
+		} else if (fd < 0) {
+			// Out of file descriptors or buffers. The pending connections
+			// don't raise another edge, so they are retried on the next
+			// iteration.
+			struct EKonstrukt *k = e->base->konstrukt;
+			e_print_error(k, "Error accepting klient: %d", -errno);
+			return e_defer_event(k, e, E_EVENT_READER, EPOLLIN);
+		}
+		rv = lauscher_add_klient(e, fd);
+		if (rv < 0) {
+			e_print_error(
+					e->base->konstrukt, "Error creating klient: %d", rv);
+		}
+	}
+	return 0;
+}
+
+static void
+e_lauscher_cleanup(union EStruktur *e) {
+	E_TYPE_ASSERT(e);
+	e->base->konstrukt->lauscher_count--;
+	if (e->lauscher->fd >= 0) {
+		close(e->lauscher->fd);
+	}
+	if (e->lauscher->path[0] != '\0') {
+		unlink(e->lauscher->path);
+	}
+}
+
+E_TYPE_END(lauscher);
@@ -1,11 +1,11 @@
 #include <e.h>
 #include <e_command.h>
 
-const struct ECommand commands[] = {
-#define DEF(cmd) {.name = #cmd, .function = e_command_##cmd},
+const struct ECommand commands[E_COMMAND_COUNT] = {
+#define DEF(cmd) \
+	[E_COMMAND_##cmd] = {.name = #cmd, .function = e_command_##cmd},
 #include <e_command.def.h>
 #undef DEF
-		{.name = "", .function = NULL},
 };
 
 static struct EKonstrukt e = {.commands = commands};
@@ -5,6 +5,7 @@
 #include <e_struktur.h>
 #include <e_utils.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 int
@@ -19,7 +20,11 @@ e_message_parser_init(struct EMessageParser *parser, struct Rope *message) {
 	if (rv < 0) {
 		goto out;
 	}
+	parser->message = message;
 	rv = rope_init(&parser->unescape_buffer, message->pool);
+	if (rv < 0) {
+		goto out;
+	}
 
 	struct RopeCursor *end = rope_range_end(&parser->post);
 
@@ -41,48 +46,180 @@ out:
 	return rv;
 }
 
+/*
+ * Parses a message that `framer` found. Payloads are taken from the offsets
+ * the framer recorded instead of being scanned again.
+ */
+int
+e_message_parser_init_framed(
+		struct EMessageParser *parser, struct Rope *message,
+		const struct EMessageFramer *framer) {
+	int rv = e_message_parser_init(parser, message);
+	if (rv < 0) {
+		return rv;
+	}
+	parser->framer = framer;
+	parser->payload = 0;
+	return 0;
+}
+
+/*
+ * Reads the message leaf by leaf, so the parser doesn't need to look up
+ * every byte in the rope.
+ */
+struct MessageScanner {
+	struct RopeNode *node;
+	const uint8_t *data;
+	size_t size;
+	size_t index;
+	size_t byte_index;
+};
+
+static void
+scanner_init(struct MessageScanner *scanner, struct RopeCursor *cursor) {
+	*scanner = (struct MessageScanner){.byte_index = cursor->byte_index};
+	scanner->node = rope_cursor_node(cursor, &scanner->index);
+	if (scanner->node != NULL) {
+		scanner->data = rope_node_value(scanner->node, &scanner->size);
+	}
+}
+
+static bool
+scanner_fill(struct MessageScanner *scanner) {
+	while (scanner->index >= scanner->size) {
+		if (scanner->node == NULL) {
+			return false;
+		}
+		scanner->node = rope_node_next(scanner->node);
+		if (scanner->node == NULL) {
+			return false;
+		}
+		scanner->data = rope_node_value(scanner->node, &scanner->size);
+		scanner->index = 0;
+	}
+	return true;
+}
+
+/*
+ * Returns the next byte or -1 at the end of the message.
+ */
+static int
+scanner_peek(struct MessageScanner *scanner) {
+	return scanner_fill(scanner) ? scanner->data[scanner->index] : -1;
+}
+
+static void
+scanner_skip(struct MessageScanner *scanner, size_t count) {
+	scanner->index += count;
+	scanner->byte_index += count;
+}
+
+/*
+ * Moves the scanner to the next `byte` with memchr() on each leaf.
+ */
+static bool
+scanner_find(struct MessageScanner *scanner, uint8_t byte) {
+	while (scanner_fill(scanner)) {
+		const uint8_t *data = &scanner->data[scanner->index];
+		const size_t size = scanner->size - scanner->index;
+		const uint8_t *found = memchr(data, byte, size);
+		if (found != NULL) {
+			scanner_skip(scanner, found - data);
+			return true;
+		}
+		scanner_skip(scanner, size);
+	}
+	return false;
+}
+
+/*
+ * Compares the following bytes with `data` without moving the scanner.
+ */
+static bool
+scanner_starts_with(
+		const struct MessageScanner *scanner, const uint8_t *data,
+		size_t size) {
+	struct MessageScanner probe = *scanner;
+	for (size_t i = 0; i < size; i++) {
+		if (scanner_peek(&probe) != data[i]) {
+			return false;
+		}
+		scanner_skip(&probe, 1);
+	}
+	return true;
+}
+
+/*
+ * Sets `tgt` to the bytes between `start` and `end` of the message.
+ */
+static int
+parser_message_range(
+		struct EMessageParser *parser, struct RopeRange *tgt, size_t start,
+		size_t end) {
+	int rv = 0;
+	rv = rope_range_init(tgt, parser->message);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_cursor_move_to(rope_range_end(tgt), ROPE_BYTE, end, 0);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_cursor_move_to(rope_range_start(tgt), ROPE_BYTE, start, 0);
+out:
+	return rv;
+}
+
 static int
 parse_terminator_message(struct EMessageParser *parser, struct RopeRange *tgt) {
 	int rv = 0;
 	size_t stopword_size;
 	uint8_t stopword[256] = "@";
-	struct RopeCursor *line = &parser->line;
+	struct MessageScanner scanner;
+	scanner_init(&scanner, &parser->line);
 
 	for (stopword_size = 1;; stopword_size++) {
-		uint_least32_t cp = rope_cursor_cp(line);
-		if (cp == ' ' || cp == '\n') {
+		const int c = scanner_peek(&scanner);
+		if (c < 0) {
+			rv = -ROPE_ERROR_OOB;
+			goto out;
+		} else if (c == ' ' || c == '\n') {
 			break;
-		}
-		if (stopword_size >= sizeof(stopword) - 2) {
+		} else if (stopword_size >= sizeof(stopword) - 2) {
 			// TODO: better error code.
 			rv = -1;
 			goto out;
 		}
-		stopword[stopword_size] = (char)cp;
-		rv = rope_cursor_move_by(line, ROPE_BYTE, 1);
-		if (rv < 0) {
-			goto out;
-		}
+		stopword[stopword_size] = (uint8_t)c;
+		scanner_skip(&scanner, 1);
 	}
 	stopword[stopword_size] = '\n';
 	stopword_size++;
-	// We know the stopword search for it.
-	
+	rv = rope_cursor_move_to(
+			&parser->line, ROPE_BYTE, scanner.byte_index, 0);
+	if (rv < 0) {
+		goto out;
+	}
+
+	// The stopword starts a line, so only line starts are compared.
 	struct RopeCursor *end = rope_range_end(&parser->post);
-	for (;;) {
-		if (rope_cursor_starts_with_data(end, stopword, stopword_size)) {
-			break;
-		}
-		rv = rope_cursor_move_by(end, ROPE_LINE, 1);
-		if (rv < 0) {
+	rope_range_collapse(&parser->post, ROPE_RIGHT);
+	scanner_init(&scanner, end);
+	while (!scanner_starts_with(&scanner, stopword, stopword_size)) {
+		if (!scanner_find(&scanner, '\n')) {
+			rv = -ROPE_ERROR_OOB;
 			goto out;
 		}
+		scanner_skip(&scanner, 1);
+	}
+	rv = rope_cursor_move_to(end, ROPE_BYTE, scanner.byte_index, 0);
+	if (rv < 0) {
+		goto out;
 	}
 	rope_range_clone(tgt, &parser->post);
 
 	rv = rope_cursor_move_by(end, ROPE_BYTE, stopword_size);
 
-
 out:
 	return rv;
 }
@@ -123,6 +260,54 @@ out:
 	return rv;
 }
 
+/*
+ * Sets `tgt` to the next payload the framer recorded and skips its field.
+ */
+static int
+parse_framed_message(struct EMessageParser *parser, struct RopeRange *tgt) {
+	int rv = 0;
+	const struct EMessageFramer *framer = parser->framer;
+	struct RopeCursor *line = &parser->line;
+	size_t next = 0;
+
+	if (parser->payload >= framer->payload_count) {
+		// TODO: better error code.
+		rv = -1;
+		goto out;
+	}
+	const struct EMessagePayload *payload =
+			&framer->payloads[parser->payload++];
+	if (payload->stopword_size > 0) {
+		// The stopword is the field without its `@` and a newline.
+		rv = rope_cursor_move_by(line, ROPE_BYTE, payload->stopword_size - 2);
+		next = payload->end + payload->stopword_size;
+	} else {
+		uint64_t byte_size = 0;
+		rv = e_parse_unsigned_dec(line, &byte_size);
+		next = payload->end + 1;
+	}
+	if (rv < 0) {
+		goto out;
+	}
+
+	rv = parser_message_range(parser, tgt, payload->start, payload->end);
+	if (rv < 0) {
+		goto out;
+	} else if (
+			payload->stopword_size == 0 &&
+			rope_cursor_cp(rope_range_end(tgt)) != '\n') {
+		// TODO: better error code.
+		rv = -1;
+		goto out;
+	}
+	rope_range_collapse(&parser->post, ROPE_RIGHT);
+	rv = rope_cursor_move_to(
+			rope_range_end(&parser->post), ROPE_BYTE, next, 0);
+
+out:
+	return rv;
+}
+
 static int
 parse_at_message(struct EMessageParser *parser, struct RopeRange *tgt) {
 	int rv = 0;
@@ -135,7 +320,9 @@ parse_at_message(struct EMessageParser *parser, struct RopeRange *tgt) {
 	}
 
 	uint_least32_t cp = rope_cursor_cp(line);
-	if (isalpha(cp)) {
+	if (parser->framer != NULL && (isalpha(cp) || isdigit(cp))) {
+		return parse_framed_message(parser, tgt);
+	} else if (isalpha(cp)) {
 		return parse_terminator_message(parser, tgt);
 	} else if (isdigit(cp)) {
 		return parse_sized_message(parser, tgt);
@@ -145,91 +332,125 @@ parse_at_message(struct EMessageParser *parser, struct RopeRange *tgt) {
 	}
 }
 
+/*
+ * Reads the next byte of a field and resolves its escape. Returns 1 with the
+ * byte in `c`, or 0 at the end of the field with the terminator in `c`.
+ */
+static int
+scanner_unescape(
+		struct MessageScanner *scanner, uint8_t quote, int *c, bool *escaped) {
+	*c = scanner_peek(scanner);
+	if (*c < 0) {
+		return -ROPE_ERROR_OOB;
+	} else if (
+			*c == '\n' || (quote != 0 && *c == quote) ||
+			(quote == 0 && *c == ' ')) {
+		return 0;
+	}
+	scanner_skip(scanner, 1);
+	if (*c != '\\') {
+		return 1;
+	}
+
+	*escaped = true;
+	*c = scanner_peek(scanner);
+	switch (*c) {
+	case -1:
+		return -ROPE_ERROR_OOB;
+	case '\n':
+		// TODO: better error code.
+		return -1;
+	case 'n':
+		*c = '\n';
+		break;
+	case 'r':
+		*c = '\r';
+		break;
+	case 't':
+		*c = '\t';
+		break;
+	// TODO: support hex and unicode escapes
+	default:
+		break;
+	}
+	scanner_skip(scanner, 1);
+	return 1;
+}
+
 static int
 parse_quoted_message(struct EMessageParser *parser, struct RopeRange *tgt) {
 	int rv = 0;
-	char terminator[] = " \n";
-	struct RopeCursor *line = &parser->line;
-
-	uint32_t cp = rope_cursor_cp(line);
+	uint8_t quote = 0;
+	struct RopeStr str = {0};
+	struct RopeCursor cursor = {0};
+	struct MessageScanner scanner;
+	scanner_init(&scanner, &parser->line);
+
+	int c = scanner_peek(&scanner);
+	if (c == '"' || c == '\'') {
+		quote = (uint8_t)c;
+		scanner_skip(&scanner, 1);
+	}
+	const struct MessageScanner start = scanner;
 
-	rope_clear(&parser->unescape_buffer);
+	bool escaped = false;
+	size_t size = 0;
+	while ((rv = scanner_unescape(&scanner, quote, &c, &escaped)) > 0) {
+		size++;
+	}
+	if (rv < 0) {
+		goto out;
+	} else if (quote != 0 && c == '\n') {
+		// TODO: better error code.
+		rv = -1;
+		goto out;
+	}
 
-	struct RopeCursor output = {0};
-	rv = rope_cursor_init(&output, &parser->unescape_buffer);
+	const size_t end_byte_index = scanner.byte_index;
+	if (quote != 0) {
+		scanner_skip(&scanner, 1);
+	}
+	rv = rope_cursor_move_to(&parser->line, ROPE_BYTE, scanner.byte_index, 0);
+	if (rv < 0) {
+		goto out;
+	}
 
-	if (cp == '"' || cp == '\'') {
-		rv = rope_cursor_move_by(line, ROPE_BYTE, 1);
-		if (rv < 0) {
-			goto out;
-		}
-		terminator[0] = cp;
-		terminator[1] = '\0';
-		cp = rope_cursor_cp(line);
+	// Without escapes the field is a range of the message.
+	if (!escaped) {
+		rv = parser_message_range(
+				parser, tgt, start.byte_index, end_byte_index);
+		goto out;
 	}
 
-	for (;;) {
-		if (rope_cursor_is_eof(line) && terminator[0] != ' ') {
-			// TODO: better error code.
-			rv = -1;
-			goto out;
-		}
-		if (cp == '\\') {
-			rv = rope_cursor_move_by(line, ROPE_BYTE, 1);
-			if (rv < 0) {
-				goto out;
-			}
-			cp = rope_cursor_cp(line);
-			if (cp == '\n') {
-				// TODO: better error code.
-				rv = -1;
-				goto out;
-			}
-			switch (cp) {
-			case 'n':
-				cp = '\n';
-				break;
-			case 'r':
-				cp = '\r';
-				break;
-			case 't':
-				cp = '\t';
-				break;
-			// TODO: support hex and unicode escapes
-			default:
-				break;
-			}
-		} else if (strchr(terminator, cp)) {
-			break;
-		} else if (cp == '\n') {
-			// TODO: better error code.
-			rv = -1;
-			goto out;
-		}
-		rv = rope_cursor_insert_cp(&output, cp, 0);
-		if (rv < 0) {
-			goto out;
-		}
-		rv = rope_cursor_move_by(line, ROPE_BYTE, 1);
-		if (rv < 0) {
-			goto out;
-		}
-		cp = rope_cursor_cp(line);
+	// Otherwise it is unescaped again, straight into a single leaf.
+	uint8_t *data = NULL;
+	rv = rope_str_alloc(&str, size, &data);
+	if (rv < 0) {
+		goto out;
 	}
-	if (terminator[0] != ' ') {
-		rv = rope_cursor_move_by(line, ROPE_BYTE, 1);
-		if (rv < 0) {
-			goto out;
-		}
+	scanner = start;
+	for (size_t i = 0; i < size; i++) {
+		// Can't fail, the field was read before.
+		scanner_unescape(&scanner, quote, &c, &escaped);
+		data[i] = (uint8_t)c;
 	}
+	rope_str_alloc_commit(&str, size);
 
-	rv = rope_to_range(&parser->unescape_buffer, tgt);
+	rope_clear(&parser->unescape_buffer);
+	rv = rope_cursor_init(&cursor, &parser->unescape_buffer);
+	if (rv < 0) {
+		goto out;
+	}
+	// The leaf is moved into the rope.
+	rv = rope_cursor_insert(&cursor, &str, 0);
 	if (rv < 0) {
 		goto out;
 	}
+	rv = rope_to_range(&parser->unescape_buffer, tgt);
 
 out:
-	rope_cursor_cleanup(&output);
+	rope_cursor_cleanup(&cursor);
+	rope_str_cleanup(&str);
 	return rv;
 }
 
@@ -291,3 +512,253 @@ e_message_parser_cleanup(struct EMessageParser *parser) {
 	rope_range_cleanup(&parser->post);
 	rope_cleanup(&parser->unescape_buffer);
 }
+
+void
+e_message_framer_init(struct EMessageFramer *framer) {
+	*framer = (struct EMessageFramer){0};
+}
+
+static int
+framer_add_payload(struct EMessageFramer *framer, uint64_t size) {
+	if (framer->payload_count == framer->payload_cap) {
+		const size_t cap = CX_MAX(4, framer->payload_cap * 2);
+		struct EMessagePayload *payloads =
+				realloc(framer->payloads, cap * sizeof(*payloads));
+		if (payloads == NULL) {
+			return -ENOMEM;
+		}
+		framer->payloads = payloads;
+		framer->payload_cap = cap;
+	}
+	framer->payloads[framer->payload_count++] = (struct EMessagePayload){
+			.size = size,
+			.stopword_index = framer->stopwords_size,
+	};
+	return 0;
+}
+
+static int
+framer_add_stopword_byte(struct EMessageFramer *framer, uint8_t byte) {
+	if (framer->stopwords_size == framer->stopwords_cap) {
+		const size_t cap = CX_MAX(64, framer->stopwords_cap * 2);
+		uint8_t *stopwords = realloc(framer->stopwords, cap);
+		if (stopwords == NULL) {
+			return -ENOMEM;
+		}
+		framer->stopwords = stopwords;
+		framer->stopwords_cap = cap;
+	}
+	framer->stopwords[framer->stopwords_size++] = byte;
+	framer->payloads[framer->payload_count - 1].stopword_size++;
+	return 0;
+}
+
+/*
+ * Starts the next payload at `offset` of the message. Returns true if there
+ * is none left and the message is complete.
+ */
+static bool
+framer_next_payload(struct EMessageFramer *framer, size_t offset) {
+	if (framer->payload == framer->payload_count) {
+		return true;
+	}
+	struct EMessagePayload *payload = &framer->payloads[framer->payload];
+	payload->start = offset;
+	framer->state = E_FRAME_PAYLOAD;
+	framer->remaining = payload->stopword_size == 0 ? payload->size + 1 : 0;
+	framer->match = 0;
+	return false;
+}
+
+/*
+ * Reads the payload bytes. Sized payloads are skipped without looking at
+ * them, terminated payloads only compare line starts with the stopword.
+ */
+static size_t
+framer_payload(
+		struct EMessageFramer *framer, const uint8_t *data, size_t size,
+		bool *done) {
+	const struct EMessagePayload *payload =
+			&framer->payloads[framer->payload];
+	*done = false;
+
+	if (payload->stopword_size == 0) {
+		const size_t chunk = CX_MIN(size, framer->remaining);
+		framer->remaining -= chunk;
+		*done = framer->remaining == 0;
+		return chunk;
+	}
+
+	const uint8_t *stopword = &framer->stopwords[payload->stopword_index];
+	size_t i = 0;
+	while (i < size && !*done) {
+		if (framer->match == SIZE_MAX) {
+			const uint8_t *newline = memchr(&data[i], '\n', size - i);
+			if (newline == NULL) {
+				return size;
+			}
+			i = newline - data + 1;
+			framer->match = 0;
+		} else if (data[i] == stopword[framer->match]) {
+			i++;
+			framer->match++;
+			*done = framer->match == payload->stopword_size;
+		} else {
+			framer->match = SIZE_MAX;
+		}
+	}
+	return i;
+}
+
+/*
+ * Follows the fields of the header line like e_message_parser_next() does
+ * and remembers the payloads announced by `@` fields.
+ */
+static int
+framer_header(struct EMessageFramer *framer, uint8_t c, bool *done) {
+	int rv = 0;
+	*done = false;
+
+	switch (framer->state) {
+	case E_FRAME_QUOTED:
+	case E_FRAME_FIELD:
+		if (c == '\n') {
+			break;
+		} else if (framer->escaped) {
+			framer->escaped = false;
+		} else if (c == '\\') {
+			framer->escaped = true;
+		} else if (framer->state == E_FRAME_QUOTED && c == framer->quote) {
+			framer->state = E_FRAME_SPACE;
+		} else if (framer->state == E_FRAME_FIELD && c == ' ') {
+			framer->state = E_FRAME_SPACE;
+		}
+		goto out;
+	case E_FRAME_AT:
+		if (isdigit(c)) {
+			framer->state = E_FRAME_SIZE;
+			rv = framer_add_payload(framer, c - '0');
+		} else if (isalpha(c)) {
+			framer->state = E_FRAME_STOPWORD;
+			rv = framer_add_payload(framer, 0);
+			if (rv < 0) {
+				goto out;
+			}
+			rv = framer_add_stopword_byte(framer, '@');
+		} else {
+			// Invalid, the parser reports it.
+			framer->state = E_FRAME_FIELD;
+			break;
+		}
+		if (rv < 0) {
+			goto out;
+		}
+		break;
+	case E_FRAME_SIZE:
+		if (isdigit(c)) {
+			struct EMessagePayload *payload =
+					&framer->payloads[framer->payload_count - 1];
+			if (payload->size > (SIZE_MAX - (c - '0')) / 10) {
+				// TODO: better error code.
+				rv = -1;
+				goto out;
+			}
+			payload->size = payload->size * 10 + (c - '0');
+			goto out;
+		}
+		framer->state = E_FRAME_SPACE;
+		break;
+	case E_FRAME_STOPWORD:
+		if (c == ' ' || c == '\n') {
+			rv = framer_add_stopword_byte(framer, '\n');
+			if (rv < 0) {
+				goto out;
+			}
+			framer->state = E_FRAME_SPACE;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (c == '\n') {
+		*done = true;
+	} else if (framer->state == E_FRAME_STOPWORD) {
+		rv = framer_add_stopword_byte(framer, c);
+	} else if (framer->state != E_FRAME_SPACE || c == ' ' || c == '\t') {
+		// Handled above.
+	} else if (c == '@') {
+		framer->state = E_FRAME_AT;
+	} else if (c == '"' || c == '\'') {
+		framer->state = E_FRAME_QUOTED;
+		framer->quote = c;
+	} else {
+		framer->state = E_FRAME_FIELD;
+		framer->escaped = c == '\\';
+	}
+
+out:
+	return rv;
+}
+
+/*
+ * Examines up to `size` bytes that follow the bytes fed before. Returns 1
+ * if a message is complete after `consumed` bytes, 0 if all bytes were
+ * consumed and the message isn't complete yet.
+ */
+int
+e_message_framer_feed(
+		struct EMessageFramer *framer, const uint8_t *data, size_t size,
+		size_t *consumed) {
+	int rv = 0;
+	bool done = false;
+	size_t i = 0;
+
+	while (i < size && !done) {
+		if (framer->state == E_FRAME_PAYLOAD) {
+			i += framer_payload(framer, &data[i], size - i, &done);
+			if (done) {
+				struct EMessagePayload *payload =
+						&framer->payloads[framer->payload++];
+				// Without the newline or the stopword behind the data.
+				payload->end = framer->size + i -
+						CX_MAX(payload->stopword_size, 1);
+				done = framer_next_payload(framer, framer->size + i);
+			}
+			continue;
+		}
+		rv = framer_header(framer, data[i], &done);
+		if (rv < 0) {
+			goto out;
+		}
+		i++;
+		if (done) {
+			done = framer_next_payload(framer, framer->size + i);
+		}
+	}
+	rv = done ? 1 : 0;
+
+out:
+	framer->size += i;
+	*consumed = i;
+	return rv;
+}
+
+/*
+ * Starts a new message after the current one is complete.
+ */
+void
+e_message_framer_reset(struct EMessageFramer *framer) {
+	framer->state = E_FRAME_SPACE;
+	framer->size = 0;
+	framer->escaped = false;
+	framer->payload_count = 0;
+	framer->stopwords_size = 0;
+	framer->payload = 0;
+}
+
+void
+e_message_framer_cleanup(struct EMessageFramer *framer) {
+	free(framer->payloads);
+	free(framer->stopwords);
+}
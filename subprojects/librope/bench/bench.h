@@ -0,0 +1,140 @@
+#ifndef ROPE_BENCH_H
+#define ROPE_BENCH_H
+
+#define _GNU_SOURCE
+
+#include <rope.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Minimal benchmark driver. Every benchmark is a function that runs its
+ * operation `bench->n` times. The driver grows `n` until a run takes at
+ * least BENCH_MIN_NS and prints one line per benchmark:
+ *
+ *   Benchmark<Name>\t<n>\t<ns> ns/op
+ *
+ * This is the format `benchstat` understands, so two runs can be compared
+ * directly. Setup that should not be measured goes between
+ * bench_stop_timer() and bench_start_timer().
+ */
+
+#define BENCH_MIN_NS (200 * 1000 * 1000ull)
+#define BENCH_MAX_N (1000 * 1000 * 1000ull)
+
+struct Bench {
+	size_t n;
+	uint64_t start;
+	uint64_t elapsed;
+	bool running;
+};
+
+typedef void (*bench_fn_t)(struct Bench *bench, void *userdata);
+
+static uint64_t
+bench_now(void) {
+	struct timespec ts = {0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void
+bench_start_timer(struct Bench *bench) {
+	if (!bench->running) {
+		bench->start = bench_now();
+		bench->running = true;
+	}
+}
+
+static inline void
+bench_stop_timer(struct Bench *bench) {
+	if (bench->running) {
+		bench->elapsed += bench_now() - bench->start;
+		bench->running = false;
+	}
+}
+
+/* xorshift64, so random positions are identical across platforms and runs */
+static inline uint64_t
+bench_rand(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+/* Appends ASCII lines to `rope` until it holds `byte_size` bytes. */
+static void
+bench_fill_rope(struct Rope *rope, size_t byte_size) {
+	static const char line[] =
+			"\tstatic int counter = 0; /* lorem ipsum dolor sit amet */\n";
+	size_t size = rope_size(rope, ROPE_BYTE);
+
+	while (size < byte_size) {
+		size_t chunk = sizeof(line) - 1;
+		if (chunk > byte_size - size) {
+			chunk = byte_size - size;
+		}
+		if (rope_append(rope, (const uint8_t *)line, chunk) < 0) {
+			abort();
+		}
+		size += chunk;
+	}
+}
+
+static bool
+bench_selected(int argc, char *argv[], const char *name) {
+	if (argc < 2) {
+		return true;
+	}
+	for (int i = 1; i < argc; i++) {
+		if (strstr(name, argv[i]) != NULL) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+bench_run(
+		int argc, char *argv[], const char *name, bench_fn_t fn,
+		void *userdata) {
+	struct Bench bench = {.n = 1};
+
+	if (!bench_selected(argc, argv, name)) {
+		return;
+	}
+
+	for (;;) {
+		bench.elapsed = 0;
+		bench.running = false;
+		bench_start_timer(&bench);
+		fn(&bench, userdata);
+		bench_stop_timer(&bench);
+
+		if (bench.elapsed >= BENCH_MIN_NS || bench.n >= BENCH_MAX_N) {
+			break;
+		}
+		/* Aim 20% past the target, but never grow by more than 100x. */
+		uint64_t next = bench.elapsed == 0
+				? bench.n * 100
+				: BENCH_MIN_NS * 12 / 10 * bench.n / bench.elapsed;
+		if (next > bench.n * 100) {
+			next = bench.n * 100;
+		} else if (next <= bench.n) {
+			next = bench.n + 1;
+		}
+		bench.n = next;
+	}
+
+	printf("Benchmark%s\t%zu\t%.2f ns/op\n", name, bench.n,
+		   (double)bench.elapsed / (double)bench.n);
+	fflush(stdout);
+}
+
+#endif /* ROPE_BENCH_H */
@@ -0,0 +1,121 @@
+#include "bench.h"
+#include <cursor_internal.h>
+
+#define BENCH_WRAP_WIDTH 80
+
+struct CursorFixture {
+	struct RopePool pool;
+	struct Rope rope;
+	struct RopeCursor cursor;
+};
+
+static void
+fixture_init(struct CursorFixture *fixture, size_t byte_size) {
+	if (rope_pool_init(&fixture->pool) < 0 ||
+		rope_init(&fixture->rope, &fixture->pool) < 0) {
+		abort();
+	}
+	bench_fill_rope(&fixture->rope, byte_size);
+	if (rope_cursor_init(&fixture->cursor, &fixture->rope) < 0) {
+		abort();
+	}
+}
+
+static void
+fixture_cleanup(struct CursorFixture *fixture) {
+	rope_cursor_cleanup(&fixture->cursor);
+	rope_cleanup(&fixture->rope);
+	rope_pool_cleanup(&fixture->pool);
+}
+
+static void
+bench_find_node(struct Bench *bench, void *userdata) {
+	struct CursorFixture *fixture = userdata;
+	const size_t size = rope_size(&fixture->rope, ROPE_CHAR);
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+	size_t node_byte_index = 0;
+	size_t local_byte_index = 0;
+
+	for (size_t i = 0; i < bench->n; i++) {
+		size_t index = bench_rand(&seed) % size;
+		struct RopeNode *node = rope_cursor_find_node(
+				&fixture->cursor, NULL, ROPE_CHAR, index, 0, &node_byte_index,
+				&local_byte_index);
+		if (node == NULL) {
+			abort();
+		}
+	}
+}
+
+static void
+bench_move_by(struct Bench *bench, enum RopeUnit unit, void *userdata) {
+	struct CursorFixture *fixture = userdata;
+	struct RopeCursor *cursor = &fixture->cursor;
+
+	rope_cursor_move_to(cursor, ROPE_BYTE, 0, 0);
+	for (size_t i = 0; i < bench->n; i++) {
+		if (rope_cursor_move_by(cursor, unit, 1) < 0) {
+			rope_cursor_move_to(cursor, ROPE_BYTE, 0, 0);
+		}
+	}
+}
+
+static void
+bench_move_by_char(struct Bench *bench, void *userdata) {
+	bench_move_by(bench, ROPE_CHAR, userdata);
+}
+
+static void
+bench_move_by_line(struct Bench *bench, void *userdata) {
+	bench_move_by(bench, ROPE_LINE, userdata);
+}
+
+static void
+bench_move_to_row(struct Bench *bench, void *userdata) {
+	struct CursorFixture *fixture = userdata;
+	const size_t rows = rope_wrap_rows(&fixture->rope, BENCH_WRAP_WIDTH);
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	for (size_t i = 0; i < bench->n; i++) {
+		const size_t row = bench_rand(&seed) % rows;
+		if (rope_cursor_move_to_row(
+					&fixture->cursor, BENCH_WRAP_WIDTH, row) < 0) {
+			abort();
+		}
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	static const struct {
+		const char *name;
+		size_t size;
+	} sizes[] = {
+			{"1KiB", 1024},
+			{"64KiB", 64 * 1024},
+			{"4MiB", 4 * 1024 * 1024},
+	};
+	char name[64] = {0};
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		struct CursorFixture fixture = {0};
+		fixture_init(&fixture, sizes[i].size);
+
+		/* Tree depth grows with the document size. */
+		snprintf(name, sizeof(name), "FindNode/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_find_node, &fixture);
+
+		snprintf(name, sizeof(name), "MoveBy/Char/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_move_by_char, &fixture);
+
+		snprintf(name, sizeof(name), "MoveBy/Line/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_move_by_line, &fixture);
+
+		snprintf(name, sizeof(name), "MoveToRow/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_move_to_row, &fixture);
+
+		fixture_cleanup(&fixture);
+	}
+
+	return 0;
+}
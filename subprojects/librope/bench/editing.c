@@ -0,0 +1,158 @@
+#include "bench.h"
+
+#define EDITING_DOCUMENT_SIZE (256 * 1024)
+#define EDITING_CURSOR_COUNT 1000
+
+struct EditingFixture {
+	struct RopePool pool;
+	struct Rope rope;
+	struct RopeCursor cursor;
+};
+
+static void
+fixture_init(struct EditingFixture *fixture, size_t byte_size) {
+	if (rope_pool_init(&fixture->pool) < 0 ||
+		rope_init(&fixture->rope, &fixture->pool) < 0) {
+		abort();
+	}
+	bench_fill_rope(&fixture->rope, byte_size);
+	if (rope_cursor_init(&fixture->cursor, &fixture->rope) < 0) {
+		abort();
+	}
+	rope_cursor_move_to(&fixture->cursor, ROPE_BYTE, byte_size / 2, 0);
+}
+
+static void
+fixture_cleanup(struct EditingFixture *fixture) {
+	rope_cursor_cleanup(&fixture->cursor);
+	rope_cleanup(&fixture->rope);
+	rope_pool_cleanup(&fixture->pool);
+}
+
+static void
+bench_insert(struct Bench *bench, void *userdata) {
+	const bool random = *(bool *)userdata;
+	struct EditingFixture fixture = {0};
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	bench_stop_timer(bench);
+	fixture_init(&fixture, EDITING_DOCUMENT_SIZE);
+	bench_start_timer(bench);
+
+	for (size_t i = 0; i < bench->n; i++) {
+		if (random) {
+			const size_t size = rope_size(&fixture.rope, ROPE_BYTE);
+			rope_cursor_move_to(
+					&fixture.cursor, ROPE_BYTE, bench_rand(&seed) % size, 0);
+		}
+		if (rope_cursor_insert_data(
+					&fixture.cursor, (const uint8_t *)"x", 1, 0) < 0) {
+			abort();
+		}
+	}
+
+	bench_stop_timer(bench);
+	fixture_cleanup(&fixture);
+	bench_start_timer(bench);
+}
+
+static void
+bench_delete(struct Bench *bench, void *userdata) {
+	const bool random = *(bool *)userdata;
+	struct EditingFixture fixture = {0};
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+	bench_stop_timer(bench);
+	fixture_init(&fixture, EDITING_DOCUMENT_SIZE + bench->n);
+	rope_cursor_move_to(&fixture.cursor, ROPE_BYTE, EDITING_DOCUMENT_SIZE, 0);
+	bench_start_timer(bench);
+
+	for (size_t i = 0; i < bench->n; i++) {
+		if (random) {
+			const size_t size = rope_size(&fixture.rope, ROPE_BYTE);
+			rope_cursor_move_to(
+					&fixture.cursor, ROPE_BYTE, bench_rand(&seed) % size, 0);
+		} else {
+			/* Backspace: step over the byte that is deleted next. */
+			rope_cursor_move_by(&fixture.cursor, ROPE_BYTE, -1);
+		}
+		if (rope_cursor_delete(&fixture.cursor, ROPE_BYTE, 1) < 0) {
+			abort();
+		}
+	}
+
+	bench_stop_timer(bench);
+	fixture_cleanup(&fixture);
+	bench_start_timer(bench);
+}
+
+static void
+bench_insert_cursors(struct Bench *bench, void *userdata) {
+	const bool batch = *(bool *)userdata;
+	struct EditingFixture fixture = {0};
+	struct RopeCursor *cursors = NULL;
+	struct RopeEdit *edits = NULL;
+
+	bench_stop_timer(bench);
+	fixture_init(&fixture, EDITING_DOCUMENT_SIZE);
+	cursors = calloc(EDITING_CURSOR_COUNT, sizeof(*cursors));
+	edits = calloc(EDITING_CURSOR_COUNT, sizeof(*edits));
+	if (cursors == NULL || edits == NULL) {
+		abort();
+	}
+	for (size_t i = 0; i < EDITING_CURSOR_COUNT; i++) {
+		const size_t index = i * (EDITING_DOCUMENT_SIZE / EDITING_CURSOR_COUNT);
+		if (rope_cursor_init(&cursors[i], &fixture.rope) < 0 ||
+			rope_cursor_move_to(&cursors[i], ROPE_BYTE, index, 0) < 0) {
+			abort();
+		}
+	}
+	bench_start_timer(bench);
+
+	/* One keystroke at every cursor. */
+	for (size_t i = 0; i < bench->n; i++) {
+		for (size_t j = 0; j < EDITING_CURSOR_COUNT; j++) {
+			if (batch) {
+				edits[j].byte_index = cursors[j].byte_index;
+				edits[j].data = (const uint8_t *)"x";
+				edits[j].byte_size = 1;
+			} else if (rope_cursor_insert_data(
+							   &cursors[j], (const uint8_t *)"x", 1, 0) < 0) {
+				abort();
+			}
+		}
+		if (batch && rope_multi_edit(
+							 &fixture.rope, edits, EDITING_CURSOR_COUNT) < 0) {
+			abort();
+		}
+	}
+
+	bench_stop_timer(bench);
+	for (size_t i = 0; i < EDITING_CURSOR_COUNT; i++) {
+		rope_cursor_cleanup(&cursors[i]);
+	}
+	free(cursors);
+	free(edits);
+	fixture_cleanup(&fixture);
+	bench_start_timer(bench);
+}
+
+int
+main(int argc, char *argv[]) {
+	bool random = false;
+	bench_run(argc, argv, "Insert/Sequential", bench_insert, &random);
+	bench_run(argc, argv, "Delete/Sequential", bench_delete, &random);
+
+	random = true;
+	bench_run(argc, argv, "Insert/Random", bench_insert, &random);
+	bench_run(argc, argv, "Delete/Random", bench_delete, &random);
+
+	bool batch = false;
+	bench_run(
+			argc, argv, "Insert/Cursors/Single", bench_insert_cursors, &batch);
+	batch = true;
+	bench_run(
+			argc, argv, "Insert/Cursors/Batch", bench_insert_cursors, &batch);
+
+	return 0;
+}
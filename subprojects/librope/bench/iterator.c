@@ -0,0 +1,117 @@
+#include "bench.h"
+
+struct RangeFixture {
+	struct RopePool pool;
+	struct Rope rope;
+	struct RopeRange range;
+};
+
+static void
+fixture_init(struct RangeFixture *fixture, size_t byte_size) {
+	if (rope_pool_init(&fixture->pool) < 0 ||
+		rope_init(&fixture->rope, &fixture->pool) < 0) {
+		abort();
+	}
+	bench_fill_rope(&fixture->rope, byte_size);
+	if (rope_range_init(&fixture->range, &fixture->rope) < 0) {
+		abort();
+	}
+	rope_cursor_move_to(rope_range_end(&fixture->range), ROPE_BYTE, byte_size, 0);
+}
+
+static void
+fixture_cleanup(struct RangeFixture *fixture) {
+	rope_range_cleanup(&fixture->range);
+	rope_cleanup(&fixture->rope);
+	rope_pool_cleanup(&fixture->pool);
+}
+
+static void
+bench_iterator_next(struct Bench *bench, void *userdata) {
+	struct RangeFixture *fixture = userdata;
+	struct RopeIterator iter = {0};
+	struct RopeStr str = {0};
+	size_t byte_size = 0;
+
+	for (size_t i = 0; i < bench->n; i++) {
+		if (rope_iterator_init(&iter, &fixture->range, 0) < 0) {
+			abort();
+		}
+		while (rope_iterator_next(&iter, &str)) {
+			byte_size += rope_str_size(&str, ROPE_BYTE);
+		}
+		rope_iterator_cleanup(&iter);
+	}
+
+	if (byte_size != bench->n * rope_size(&fixture->rope, ROPE_BYTE)) {
+		abort();
+	}
+}
+
+static void
+bench_range_to_cstr(struct Bench *bench, void *userdata) {
+	struct RangeFixture *fixture = userdata;
+
+	for (size_t i = 0; i < bench->n; i++) {
+		char *str = rope_range_to_cstr(&fixture->range, 0);
+		if (str == NULL) {
+			abort();
+		}
+		free(str);
+	}
+}
+
+static void
+bench_range_copy_to(struct Bench *bench, void *userdata) {
+	struct RangeFixture *fixture = userdata;
+	struct Rope target = {0};
+	struct RopeCursor cursor = {0};
+
+	for (size_t i = 0; i < bench->n; i++) {
+		bench_stop_timer(bench);
+		if (rope_init(&target, &fixture->pool) < 0 ||
+			rope_cursor_init(&cursor, &target) < 0) {
+			abort();
+		}
+		bench_start_timer(bench);
+
+		if (rope_range_copy_to(&fixture->range, &cursor, 0) < 0) {
+			abort();
+		}
+
+		bench_stop_timer(bench);
+		rope_cursor_cleanup(&cursor);
+		rope_cleanup(&target);
+		bench_start_timer(bench);
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	static const struct {
+		const char *name;
+		size_t size;
+	} sizes[] = {
+			{"64KiB", 64 * 1024},
+			{"4MiB", 4 * 1024 * 1024},
+	};
+	char name[64] = {0};
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		struct RangeFixture fixture = {0};
+		fixture_init(&fixture, sizes[i].size);
+
+		snprintf(name, sizeof(name), "IteratorNext/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_iterator_next, &fixture);
+
+		snprintf(name, sizeof(name), "RangeToCstr/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_range_to_cstr, &fixture);
+
+		snprintf(name, sizeof(name), "RangeCopyTo/%s", sizes[i].name);
+		bench_run(argc, argv, name, bench_range_copy_to, &fixture);
+
+		fixture_cleanup(&fixture);
+	}
+
+	return 0;
+}
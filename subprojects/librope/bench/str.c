@@ -0,0 +1,56 @@
+#include "bench.h"
+#include <rope_str.h>
+#include <stdlib.h>
+
+/* Roughly one leaf worth of data, so the heap path is measured. */
+#define STR_BENCH_SIZE 1000
+
+struct StrInput {
+	uint8_t data[STR_BENCH_SIZE];
+	size_t size;
+};
+
+static void
+fill(struct StrInput *input, const char *pattern) {
+	const size_t pattern_size = strlen(pattern);
+	input->size = 0;
+	while (input->size + pattern_size <= sizeof(input->data)) {
+		memcpy(&input->data[input->size], pattern, pattern_size);
+		input->size += pattern_size;
+	}
+}
+
+static void
+bench_str_init(struct Bench *bench, void *userdata) {
+	struct StrInput *input = userdata;
+	struct RopeStr str = {0};
+
+	for (size_t i = 0; i < bench->n; i++) {
+		if (rope_str_init(&str, input->data, input->size) < 0) {
+			abort();
+		}
+		rope_str_cleanup(&str);
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	struct StrInput input = {0};
+
+	fill(&input, "The quick brown fox\n");
+	bench_run(argc, argv, "StrInit/ASCII", bench_str_init, &input);
+
+	/* 日本語のテキスト */
+	fill(&input, "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86"
+				 "\xe3\x82\xad\xe3\x82\xb9\xe3\x83\x88\n");
+	bench_run(argc, argv, "StrInit/CJK", bench_str_init, &input);
+
+	/* 👍🏽, 👨‍👩‍👧 and 🇩🇪: modifiers, ZWJ sequences and flags */
+	fill(&input, "\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd"
+				 "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d"
+				 "\xf0\x9f\x91\xa7"
+				 "\xf0\x9f\x87\xa9\xf0\x9f\x87\xaa\n");
+	bench_run(argc, argv, "StrInit/Emoji", bench_str_init, &input);
+
+	return 0;
+}
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
+
 #include "rope_deser.h"
 #include <ctype.h>
 #include <inttypes.h>
 #include <rope.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define ROPE_DESER_TYPE_SIZE 1
 #define ROPE_DESER_RANGE_COUNT 3
@@ -82,6 +87,54 @@ print_rv_check(int rv, bool print) {
 	}
 }
 
+// Snapshots of the resulting rope must restore to the same content.
+static int
+deser_check_snapshot(struct Rope *rope) {
+	int rv = 0;
+	struct Rope restored = {0};
+	char *expected = NULL;
+	char *actual = NULL;
+	int fd = memfd_create("snapshot", MFD_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+
+	rv = rope_init(&restored, rope->pool);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_serialize(rope, fd);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_deserialize_fd(&restored, fd);
+	if (rv < 0) {
+		goto out;
+	}
+
+	expected = rope_to_str(rope, 0);
+	actual = rope_to_str(&restored, 0);
+	if (expected == NULL || actual == NULL) {
+		rv = -1;
+		goto out;
+	}
+	if (strcmp(expected, actual) != 0) {
+		abort();
+	}
+	for (enum RopeUnit unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+		if (rope_size(rope, unit) != rope_size(&restored, unit)) {
+			abort();
+		}
+	}
+
+out:
+	free(expected);
+	free(actual);
+	rope_cleanup(&restored);
+	close(fd);
+	return rv;
+}
+
 int
 rope_deserialize(const uint8_t *data, size_t length, bool print) {
 	int rv = 0;
@@ -202,6 +255,9 @@ rope_deserialize(const uint8_t *data, size_t length, bool print) {
 		}
 	}
 
+	if (rv >= 0) {
+		rv = deser_check_snapshot(&rope);
+	}
 out:
 	for (int i = 0; i < ROPE_DESER_RANGE_COUNT; i++) {
 		rope_range_cleanup(&ranges[i]);
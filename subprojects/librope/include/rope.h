@@ -12,6 +12,7 @@
 
 struct Rope;
 struct RopeRange;
+struct RopeMarkers;
 
 /**********************************
  * pool.c
@@ -19,6 +20,9 @@ struct RopeRange;
 
 struct RopePool {
 	struct CxPreallocPool pool;
+	size_t node_count;
+	size_t peak_node_count;
+	struct RopeStrCache str_cache;
 };
 
 int rope_pool_init(struct RopePool *pool);
@@ -36,8 +40,14 @@ void rope_pool_cleanup(struct RopePool *pool);
 struct Rope {
 	struct RopeNode *root;
 	struct RopeCursor *last_cursor;
+	struct RopeMarkers *markers;
 	struct RopePool *pool;
 	size_t chores_counter;
+	// Cells taken by a tab, used for display columns. Change it with
+	// rope_set_tab_width().
+	size_t tab_width;
+	// Soft wrap and word summaries of the branches.
+	struct RopeSummaries summaries;
 };
 
 int rope_init(struct Rope *rope, struct RopePool *pool);
@@ -50,6 +60,10 @@ int rope_append_str(struct Rope *rope, const char *str);
 
 size_t rope_size(struct Rope *rope, enum RopeUnit unit);
 
+void rope_set_tab_width(struct Rope *rope, size_t tab_width);
+
+size_t rope_wrap_rows(struct Rope *rope, size_t width);
+
 int rope_insert(
 		struct Rope *rope, enum RopeUnit unit, size_t index,
 		const uint8_t *data, size_t byte_size);
@@ -101,10 +115,27 @@ int rope_cursor_move_to(
 int rope_cursor_insert(
 		struct RopeCursor *cursor, struct RopeStr *str, uint64_t tags);
 
+int rope_cursor_insert_node(struct RopeCursor *cursor, struct RopeNode *node);
+
 int rope_cursor_insert_data(
 		struct RopeCursor *cursor, const uint8_t *data, size_t byte_size,
 		uint64_t tags);
 
+/*
+ * An edit deletes `delete_size` bytes at `byte_index` and inserts `data` at
+ * the same position afterwards.
+ */
+struct RopeEdit {
+	size_t byte_index;
+	size_t delete_size;
+	const uint8_t *data;
+	size_t byte_size;
+	uint64_t tags;
+};
+
+int rope_multi_edit(
+		struct Rope *rope, const struct RopeEdit *edits, size_t count);
+
 int rope_cursor_move_by(
 		struct RopeCursor *cursor, enum RopeUnit unit, off_t offset);
 
@@ -129,6 +160,19 @@ bool rope_cursor_is_eof(struct RopeCursor *cursor);
 size_t
 rope_cursor_index(struct RopeCursor *cursor, enum RopeUnit unit, uint64_t tags);
 
+size_t rope_cursor_column(struct RopeCursor *cursor);
+
+int rope_cursor_move_to_column(struct RopeCursor *cursor, size_t column);
+
+int rope_cursor_row(struct RopeCursor *cursor, size_t width, size_t *row);
+
+int
+rope_cursor_move_to_row(struct RopeCursor *cursor, size_t width, size_t row);
+
+size_t rope_cursor_word(struct RopeCursor *cursor);
+
+int rope_cursor_move_words(struct RopeCursor *cursor, off_t count);
+
 bool rope_cursor_starts_with_data(
 		struct RopeCursor *cursor, const uint8_t *prefix, size_t prefix_size);
 
@@ -215,4 +259,179 @@ bool rope_iterator_next(struct RopeIterator *iter, struct RopeStr *str);
 
 void rope_iterator_cleanup(struct RopeIterator *iter);
 
+/**********************************
+ * history.c
+ */
+
+enum RopeHistoryOpType {
+	ROPE_HISTORY_INSERT,
+	ROPE_HISTORY_DELETE,
+};
+
+struct RopeHistoryOp {
+	enum RopeHistoryOpType type;
+	size_t index;
+	size_t size;
+};
+
+struct RopeHistoryLog {
+	struct RopeHistoryOp *ops;
+	size_t count;
+	size_t capacity;
+};
+
+/*
+ * An edit deletes `delete_count` units at `index` and inserts `data` at the
+ * same position afterwards.
+ */
+struct RopeHistoryEdit {
+	size_t index;
+	size_t delete_count;
+	const uint8_t *data;
+	size_t byte_size;
+};
+
+struct RopeHistory {
+	struct Rope *rope;
+	enum RopeUnit unit;
+	struct RopeHistoryLog log;
+	size_t first_revision;
+};
+
+int rope_history_init(
+		struct RopeHistory *history, struct Rope *rope, enum RopeUnit unit);
+
+size_t rope_history_revision(const struct RopeHistory *history);
+
+int rope_history_apply(
+		struct RopeHistory *history, size_t revision,
+		const struct RopeHistoryEdit *edits, size_t count);
+
+void rope_history_trim(struct RopeHistory *history, size_t revision);
+
+void rope_history_cleanup(struct RopeHistory *history);
+
+/**********************************
+ * marker.c
+ */
+
+/*
+ * An interval of bytes that follows edits of the rope. The fields are owned
+ * by the marker set, except for `value` which is free for the caller, e.g.
+ * for diagnostic or highlight ids.
+ */
+struct RopeMarker {
+	struct RopeMarker *children[2];
+	struct RopeMarker *parent;
+	size_t start;
+	size_t end;
+	size_t max_end;
+	off_t delta;
+	uint32_t priority;
+	uint64_t value;
+};
+
+struct RopeMarkers {
+	struct Rope *rope;
+	struct RopeMarkers *next;
+	struct RopeMarker *root;
+	uint64_t seed;
+};
+
+typedef void (*rope_marker_callback_t)(
+		struct RopeMarker *marker, size_t start, size_t end, void *userdata);
+
+int rope_markers_init(struct RopeMarkers *markers, struct Rope *rope);
+
+int rope_markers_add(
+		struct RopeMarkers *markers, struct RopeMarker *marker, size_t start,
+		size_t end);
+
+void
+rope_markers_remove(struct RopeMarkers *markers, struct RopeMarker *marker);
+
+void rope_markers_query(
+		struct RopeMarkers *markers, size_t from, size_t to,
+		rope_marker_callback_t callback, void *userdata);
+
+void rope_markers_clear(struct RopeMarkers *markers);
+
+void rope_markers_cleanup(struct RopeMarkers *markers);
+
+size_t rope_marker_start(const struct RopeMarker *marker);
+
+size_t rope_marker_end(const struct RopeMarker *marker);
+
+void rope_markers_damaged(
+		struct Rope *rope, size_t byte_index, size_t delete_size,
+		size_t insert_size);
+
+/**********************************
+ * serialize.c
+ */
+
+int rope_serialize(struct Rope *rope, int fd);
+
+int rope_deserialize_fd(struct Rope *rope, int fd);
+
+int rope_deserialize_file(struct Rope *rope, const char *path);
+
+/**********************************
+ * paged.c
+ */
+
+int rope_map_fd(struct Rope *rope, int fd);
+
+int rope_map_file(struct Rope *rope, const char *path);
+
+/**********************************
+ * diff.c
+ */
+
+typedef int (*rope_diff_callback_t)(
+		const struct RopeEdit *edit, void *userdata);
+
+int rope_diff(
+		struct Rope *rope, struct Rope *other, rope_diff_callback_t callback,
+		void *userdata);
+
+int rope_diff_apply(struct Rope *rope, struct Rope *other);
+
+int rope_reload_fd(struct Rope *rope, int fd);
+
+int rope_reload_file(struct Rope *rope, const char *path);
+
+/**********************************
+ * stats.c
+ */
+
+#define ROPE_STATS_BUCKETS 12
+
+/*
+ * Memory statistics of a rope. The byte counts are the bytes of the leaves
+ * by storage type. `shared_bytes` are bytes of leaves whose heap is also
+ * referenced by other leaves or ropes, `compressed_size` is the memory the
+ * compressed leaves take. `leaf_histogram[i]` counts the leaves of less than
+ * `16 << i` bytes that don't fit into a smaller bucket, the last bucket
+ * counts all larger leaves.
+ */
+struct RopeStats {
+	size_t depth;
+	size_t branch_count;
+	size_t leaf_count;
+	size_t leaf_histogram[ROPE_STATS_BUCKETS];
+	size_t byte_count;
+	size_t inline_bytes;
+	size_t heap_bytes;
+	size_t wrapped_bytes;
+	size_t mapped_bytes;
+	size_t compressed_bytes;
+	size_t compressed_size;
+	size_t shared_bytes;
+	size_t slow_count;
+	size_t cursor_count;
+};
+
+void rope_stats(struct Rope *rope, struct RopeStats *stats);
+
 #endif
@@ -25,8 +25,12 @@
 
 #define ROPE_NODE_COMPACT_THRESHOLD 10
 
+#define ROPE_NODE_COLD_LEAF_SIZE (4 * 1024)
+
 #define ROPE_CHORE_RUN_INTERVAL 8192
 
+#define ROPE_TAB_WIDTH 8
+
 enum RopeDirection {
 	ROPE_LEFT,
 	ROPE_RIGHT,
@@ -38,6 +42,9 @@ enum RopeUnit {
 	ROPE_CP,
 	ROPE_LINE,
 	ROPE_UTF16,
+	// Terminal cells. Tabs and other control characters take no cells.
+	ROPE_COLUMN,
+	ROPE_TAB,
 	ROPE_UNIT_COUNT,
 };
 
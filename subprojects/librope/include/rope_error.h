@@ -9,6 +9,7 @@ enum RopeError {
 	ROPE_ERROR_OOM,
 	ROPE_ERROR_INVALID_TYPE,
 	ROPE_ERROR_OOB,
+	ROPE_ERROR_INVALID_FORMAT,
 };
 
 #endif /* ROPE_ERROR_H */
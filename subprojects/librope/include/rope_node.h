@@ -18,6 +18,10 @@ struct RopePool;
  */
 
 #define ROPE_NODE_TYPE_MASK (~(UINT64_MAX >> 1))
+#define ROPE_NODE_DEPTH_MASK ((UINT64_C(1) << 8) - 1)
+#define ROPE_NODE_HEAT_SHIFT 8
+#define ROPE_NODE_HEAT_MASK (((UINT64_C(1) << 32) - 1) << ROPE_NODE_HEAT_SHIFT)
+#define ROPE_NODE_SUMMARY (UINT64_C(1) << 40)
 enum RopeNodeType {
 	ROPE_NODE_LEAF,
 	ROPE_NODE_BRANCH,
@@ -25,6 +29,26 @@ enum RopeNodeType {
 
 typedef enum RopeNodeType rope_node_type_t;
 
+/*
+ * Soft wrap summary of a subtree: the cells before the first and after the
+ * last newline, and the screen rows of the complete lines in between.
+ */
+struct RopeWrap {
+	size_t head;
+	size_t tail;
+	size_t rows;
+};
+
+/*
+ * Word summary of a subtree: the number of word starts and the classes of
+ * the first and last codepoint.
+ */
+struct RopeWords {
+	size_t starts;
+	uint8_t head;
+	uint8_t tail;
+};
+
 struct RopeBranch {
 	struct RopeNode *children[2];
 	struct RopeDim dim;
@@ -34,7 +58,9 @@ struct RopeNode {
 	/*
 	 * High bit: type (leaf/branch);
 	 * Low 63 bits:
-	 * - For branch nodes: depth in the tree
+	 * - For branch nodes: depth in the tree (bits 0 - 7), the number of
+	 *   edits below this node since the last chores run (bits 8 - 39) and
+	 *   whether its entry in `struct RopeSummaries` is current (bit 40)
 	 * - For leaf nodes: tags
 	 */
 	uint64_t bits;
@@ -101,6 +127,8 @@ rope_node_type(const struct RopeNode *node) ROPE_NO_UNUSED;
 
 ROPE_NO_UNUSED size_t rope_node_depth(const struct RopeNode *node);
 
+ROPE_NO_UNUSED size_t rope_node_heat(const struct RopeNode *node);
+
 ROPE_NO_UNUSED const uint8_t *
 rope_node_value(const struct RopeNode *node, size_t *size);
 
@@ -139,10 +167,17 @@ rope_node_chores(struct RopeNode *node, struct RopePool *pool);
 
 void rope_node_balance_up(struct RopeNode *node);
 void rope_node_balance_up2(struct RopeNode *node);
+void rope_node_rebalance_up(struct RopeNode *node);
+
+void rope_node_touch(struct RopeNode *node);
 
 ROPE_NO_UNUSED int
 rope_node_compact(struct RopeNode *node, struct RopePool *pool);
 
+ROPE_NO_UNUSED int rope_node_build(
+		struct RopeNode **root, struct RopeNode **leaves, size_t count,
+		struct RopePool *pool);
+
 /**********************************
  * node/insert.c
  */
@@ -151,6 +186,13 @@ int rope_node_insert(
 		struct RopeNode *node, struct RopeStr *str, uint64_t tags,
 		struct RopePool *pool, enum RopeDirection which);
 
+ROPE_NO_UNUSED int rope_node_insert_tree(
+		struct RopeNode *target, struct RopeNode *node, struct RopePool *pool,
+		enum RopeDirection which);
+
+ROPE_NO_UNUSED int
+rope_node_stitch_next(struct RopeNode *node, struct RopePool *pool);
+
 ROPE_NO_UNUSED int rope_node_insert_left(
 		struct RopeNode *node, const uint8_t *data, size_t byte_size,
 		uint64_t tags, struct RopePool *pool);
@@ -167,6 +209,73 @@ ROPE_NO_UNUSED int rope_node_insert_heap_right(
 		struct RopeNode *node, uint8_t *data, size_t byte_size, uint64_t tags,
 		struct RopePool *pool);
 
+/**********************************
+ * node/summary.c
+ */
+
+/*
+ * Cached summaries of a branch. `wrap` is valid for `wrap_width` cells,
+ * zero if not cached, and `words` if `has_words` is set.
+ */
+struct RopeSummary {
+	const struct RopeNode *node;
+	struct RopeWrap wrap;
+	size_t wrap_width;
+	struct RopeWords words;
+	bool has_words;
+};
+
+struct RopeSummaries {
+	struct RopeSummary *entries;
+	size_t count;
+	size_t cap;
+};
+
+struct RopeSummary *
+rope_node_summary(struct RopeNode *node, struct RopeSummaries *summaries);
+
+const struct RopeSummary *rope_summaries_find(
+		const struct RopeSummaries *summaries, const struct RopeNode *node);
+
+void rope_summaries_wrap_invalidate(struct RopeSummaries *summaries);
+
+void rope_summaries_cleanup(struct RopeSummaries *summaries);
+
+/**********************************
+ * node/word.c
+ */
+
+void rope_node_words(
+		struct RopeNode *node, struct RopeSummaries *summaries,
+		struct RopeWords *words);
+
+ROPE_NO_UNUSED size_t rope_node_byte_to_word(
+		struct RopeNode *node, struct RopeSummaries *summaries,
+		size_t byte_index);
+
+ROPE_NO_UNUSED size_t rope_node_word_to_byte(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t index);
+
+/**********************************
+ * node/wrap.c
+ */
+
+void rope_node_wrap(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t width,
+		size_t tab_width, struct RopeWrap *wrap);
+
+ROPE_NO_UNUSED size_t rope_node_wrap_rows(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t width,
+		size_t tab_width);
+
+ROPE_NO_UNUSED size_t rope_node_line_to_row(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t line,
+		size_t width, size_t tab_width);
+
+ROPE_NO_UNUSED size_t rope_node_row_to_line(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t row,
+		size_t width, size_t tab_width, size_t *first_row);
+
 /**********************************
  * inline node functions
  */
@@ -14,11 +14,60 @@
  * str.c
  */
 
+#define ROPE_STR_HEAP_MAPPED ((uint32_t)1 << 31)
+#define ROPE_STR_HEAP_COUNT_MASK (ROPE_STR_HEAP_MAPPED - 1)
+
 struct RopeStrHeap {
 	uint32_t ref_count;
 	// uint8_t data[];
 };
 
+/*
+ * Header of a memory mapping that is shared by multiple strings. The
+ * mapping is unmapped once the last string referencing it is released.
+ */
+struct RopeStrMapping {
+	struct RopeStrHeap heap;
+	uint32_t reserved;
+	uint64_t size;
+};
+
+/*
+ * Header of a heap string whose data is compressed with rope_lz_compress().
+ * Compressed strings have their data pointer set to NULL and are read
+ * through the cache of the pool that compressed them.
+ */
+struct RopeStrCompressed {
+	struct RopeStrHeap heap;
+	uint32_t size;
+	struct RopeStrCache *cache;
+	// uint8_t data[];
+};
+
+#define ROPE_STR_CACHE_SLOTS 4
+
+/*
+ * Decompressed data of the compressed strings that were read last. A miss
+ * reuses the least recently read slot, so the data returned for a compressed
+ * string stays valid while fewer than ROPE_STR_CACHE_SLOTS other compressed
+ * strings are read. Compressed strings are cold leaves, so every slot fits
+ * ROPE_NODE_COLD_LEAF_SIZE bytes and reads never allocate.
+ */
+struct RopeStrCache {
+	const struct RopeStrCompressed *keys[ROPE_STR_CACHE_SLOTS];
+	uint64_t used[ROPE_STR_CACHE_SLOTS];
+	uint64_t clock;
+	uint8_t data[ROPE_STR_CACHE_SLOTS][ROPE_NODE_COLD_LEAF_SIZE];
+};
+
+enum RopeStrType {
+	ROPE_STR_TYPE_INLINE,
+	ROPE_STR_TYPE_WRAPPED,
+	ROPE_STR_TYPE_HEAP,
+	ROPE_STR_TYPE_MAPPED,
+	ROPE_STR_TYPE_COMPRESSED,
+};
+
 struct RopeStr {
 	/*
 	 * Normal strings:
@@ -41,12 +90,23 @@ struct RopeStr {
 	 *
 	 */
 	uint64_t dim;
+	/*
+	 * Terminal cells and tabs of normal strings. They don't fit into `dim`.
+	 */
+	uint16_t columns;
+	uint16_t tabs;
 	// struct RopeStrDimensions dimensions;
 	union {
 		uint8_t inplace[ROPE_STR_INLINE_SIZE];
 		struct {
 			uint8_t *data;
 			struct RopeStrHeap *str;
+			/*
+			 * Dimensions of slow strings, valid if the cached byte count
+			 * matches the string size.
+			 */
+			uint32_t slow_dim[ROPE_UNIT_COUNT];
+			uint32_t slow_last_char_size;
 		} heap;
 	} data;
 };
@@ -56,6 +116,20 @@ rope_str_init(struct RopeStr *str, const uint8_t *data, size_t byte_size);
 
 void rope_str_wrap(struct RopeStr *str, uint8_t *data, size_t byte_size);
 
+void rope_str_measure(
+		const uint8_t *data, size_t byte_size, struct RopeDim *dim,
+		size_t *last_char_size);
+
+ROPE_NO_UNUSED int rope_str_dim(
+		const struct RopeStr *str, struct RopeDim *dim,
+		size_t *last_char_size);
+
+void rope_str_init_measured(
+		struct RopeStr *str, struct RopeStrHeap *heap, const uint8_t *data,
+		const struct RopeDim *dim, size_t last_char_size);
+
+void rope_str_heap_release(struct RopeStrHeap *heap);
+
 ROPE_NO_UNUSED int
 rope_str_alloc(struct RopeStr *str, size_t byte_size, uint8_t **data_ptr);
 
@@ -94,6 +168,12 @@ rope_str_size(const struct RopeStr *str, enum RopeUnit unit);
 ROPE_NO_UNUSED size_t rope_str_unit_to_byte(
 		const struct RopeStr *str, enum RopeUnit unit, size_t index);
 
+ROPE_NO_UNUSED size_t rope_str_column_to_byte(
+		const struct RopeStr *str, size_t column, size_t tab_width);
+
+size_t rope_str_line_columns(
+		const struct RopeStr *str, size_t *byte_index, size_t tab_width);
+
 ROPE_NO_UNUSED size_t rope_str_last_char_index(const struct RopeStr *str);
 
 ROPE_NO_UNUSED size_t rope_str_unit_from_byte(
@@ -104,6 +184,20 @@ rope_str_is_end(const struct RopeStr *str, enum RopeUnit unit, size_t index);
 
 void rope_str_cleanup(struct RopeStr *str);
 
+ROPE_NO_UNUSED int
+rope_str_compress(struct RopeStr *str, struct RopeStrCache *cache);
+
+ROPE_NO_UNUSED bool rope_str_is_compressed(const struct RopeStr *str);
+
+ROPE_NO_UNUSED enum RopeStrType rope_str_type(const struct RopeStr *str);
+
+ROPE_NO_UNUSED bool rope_str_is_shared(const struct RopeStr *str);
+
+ROPE_NO_UNUSED bool rope_str_is_slow(const struct RopeStr *str);
+
+ROPE_NO_UNUSED bool
+rope_str_is_same(const struct RopeStr *a, const struct RopeStr *b);
+
 ROPE_NO_UNUSED int
 rope_str_clone(struct RopeStr *dest, const struct RopeStr *src);
 
@@ -115,6 +209,16 @@ ROPE_NO_UNUSED int rope_str_stitch(
 		struct RopeStr *seam, struct RopeStr *left, size_t left_index,
 		struct RopeStr *right, size_t right_index);
 
+/**********************************
+ * lz.c
+ */
+
+ROPE_NO_UNUSED size_t rope_lz_compress(
+		const uint8_t *data, size_t size, uint8_t *target, size_t capacity);
+
+ROPE_NO_UNUSED int rope_lz_decompress(
+		const uint8_t *data, size_t size, uint8_t *target, size_t target_size);
+
 /**********************************
  * str_iter.c
  */
@@ -18,6 +18,8 @@ struct RopeNode *rope_cursor_find_node(
 		size_t index, uint64_t tags, size_t *node_byte_index,
 		size_t *local_byte_index);
 
+size_t cursor_line_to_byte(struct Rope *rope, size_t line);
+
 size_t rope_node_byte_to_index(
 		struct RopeNode *node, size_t byte_idx, enum RopeUnit unit,
 		uint64_t tags);
@@ -5,45 +5,132 @@
 #include <rope.h>
 #include <rope_common.h>
 #include <rope_node.h>
+#include <stdlib.h>
 #include <string.h>
 
+static int
+edit_insert(
+		struct RopeCursor *cursor, size_t byte_index, struct RopeStr *str,
+		uint64_t tags) {
+	int rv = 0;
+	struct Rope *rope = cursor->rope;
+	struct RopeNode *left = NULL;
+	struct RopeNode *right = NULL;
+
+	size_t insert_at_byte = 0;
+	struct RopeNode *insert_at = rope_cursor_find_node(
+			cursor, NULL, ROPE_BYTE, byte_index, 0, NULL, &insert_at_byte);
+	rope_node_touch(insert_at);
+
+	rv = rope_node_split(
+			insert_at, rope->pool, insert_at_byte, ROPE_BYTE, &left, &right);
+	if (rv < 0) {
+		goto out;
+	}
+
+	if (left) {
+		rv = rope_node_insert(left, str, tags, rope->pool, ROPE_RIGHT);
+	} else {
+		rv = rope_node_insert(right, str, tags, rope->pool, ROPE_LEFT);
+	}
+out:
+	return rv;
+}
+
 int
 rope_cursor_insert(
 		struct RopeCursor *cursor, struct RopeStr *str, uint64_t tags) {
 	int rv = 0;
 	struct Rope *rope = cursor->rope;
-	struct RopeNode *left = NULL;
-	struct RopeNode *right = NULL;
 
 	size_t byte_size = rope_str_size(str, ROPE_BYTE);
 	if (byte_size == 0) {
 		return 0;
 	}
 
+	rv = edit_insert(cursor, cursor->byte_index, str, tags);
+	if (rv < 0) {
+		goto out;
+	}
+
+	rope_markers_damaged(rope, cursor->byte_index, 0, byte_size);
+	cursor_bubble_up(cursor);
+	cursor_damaged(cursor, 0, (off_t)byte_size);
+
+	rv = rope_chores(rope);
+out:
+	return rv;
+}
+
+/*
+ * Merges the leaves around `byte_index` if a grapheme cluster spans it.
+ */
+static int
+stitch_seam(struct RopeCursor *cursor, size_t byte_index) {
+	size_t local_byte_index = 0;
+	if (byte_index == 0) {
+		return 0;
+	}
+	struct RopeNode *node = rope_cursor_find_node(
+			cursor, NULL, ROPE_BYTE, byte_index - 1, 0, NULL,
+			&local_byte_index);
+	return rope_node_stitch_next(node, cursor->rope->pool);
+}
+
+int
+rope_cursor_insert_node(struct RopeCursor *cursor, struct RopeNode *node) {
+	int rv = 0;
+	struct Rope *rope = cursor->rope;
+	struct RopeNode *left = NULL;
+	struct RopeNode *right = NULL;
+
+	size_t byte_size = rope_node_size(node, ROPE_BYTE);
+	if (byte_size == 0) {
+		goto out;
+	}
+
 	size_t cursor_byte_index = cursor->byte_index;
 
 	size_t insert_at_byte = 0;
 	struct RopeNode *insert_at = rope_cursor_find_node(
 			cursor, NULL, ROPE_BYTE, cursor_byte_index, 0, NULL,
 			&insert_at_byte);
+	rope_node_touch(insert_at);
 
 	rv = rope_node_split(
 			insert_at, rope->pool, insert_at_byte, ROPE_BYTE, &left, &right);
+	if (rv < 0) {
+		goto out;
+	}
 
 	if (left) {
-		rv = rope_node_insert(left, str, tags, rope->pool, ROPE_RIGHT);
+		rv = rope_node_insert_tree(left, node, rope->pool, ROPE_RIGHT);
 	} else {
-		rv = rope_node_insert(right, str, tags, rope->pool, ROPE_LEFT);
+		rv = rope_node_insert_tree(right, node, rope->pool, ROPE_LEFT);
 	}
 	if (rv < 0) {
 		goto out;
 	}
+	node = NULL;
 
+	// Merging leaves keeps byte offsets intact, so the seams are looked up
+	// by position after each other.
+	rv = stitch_seam(cursor, cursor_byte_index + byte_size);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = stitch_seam(cursor, cursor_byte_index);
+	if (rv < 0) {
+		goto out;
+	}
+
+	rope_markers_damaged(rope, cursor_byte_index, 0, byte_size);
 	cursor_bubble_up(cursor);
 	cursor_damaged(cursor, 0, (off_t)byte_size);
 
 	rv = rope_chores(rope);
 out:
+	rope_node_free(node, rope->pool);
 	return rv;
 }
 
@@ -66,19 +153,19 @@ rope_cursor_insert_str(
 			cursor, (const uint8_t *)str, strlen(str), tags);
 }
 
-int
-rope_cursor_delete(
-		struct RopeCursor *cursor, enum RopeUnit unit, size_t count) {
+static int
+edit_delete(
+		struct RopeCursor *cursor, size_t byte_index, enum RopeUnit unit,
+		size_t count, size_t *bytes_deleted) {
 	int rv = 0;
 
-	size_t cursor_byte_index = cursor->byte_index;
 	size_t local_byte_index = 0;
 	struct Rope *rope = cursor->rope;
 	struct RopeNode *node = rope_cursor_find_node(
-			cursor, NULL, ROPE_BYTE, cursor_byte_index, 0, NULL,
-			&local_byte_index);
+			cursor, NULL, ROPE_BYTE, byte_index, 0, NULL, &local_byte_index);
+	rope_node_touch(node);
 	size_t remaining = count;
-	size_t bytes_deleted = 0;
+	*bytes_deleted = 0;
 
 	if (remaining == 0) {
 		return 0;
@@ -103,7 +190,7 @@ rope_cursor_delete(
 			break;
 		}
 		remaining -= node_size;
-		bytes_deleted += rope_node_size(node, ROPE_BYTE);
+		*bytes_deleted += rope_node_size(node, ROPE_BYTE);
 		node = rope_node_delete_and_next(node, rope->pool);
 	}
 
@@ -118,10 +205,31 @@ rope_cursor_delete(
 			}
 			local_byte_index -= rope_node_size(node, ROPE_BYTE);
 		}
-		bytes_deleted += local_byte_index;
+		*bytes_deleted += local_byte_index;
 		remaining = 0;
 	}
 	assert(remaining == 0);
+out:
+	return rv;
+}
+
+int
+rope_cursor_delete(
+		struct RopeCursor *cursor, enum RopeUnit unit, size_t count) {
+	int rv = 0;
+	struct Rope *rope = cursor->rope;
+	size_t bytes_deleted = 0;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	rv = edit_delete(cursor, cursor->byte_index, unit, count, &bytes_deleted);
+	if (rv < 0) {
+		goto out;
+	}
+
+	rope_markers_damaged(rope, cursor->byte_index, bytes_deleted, 0);
 	cursor_bubble_up(cursor);
 	cursor_damaged(cursor, cursor->byte_index, -(off_t)bytes_deleted);
 
@@ -130,6 +238,148 @@ out:
 	return rv;
 }
 
+static int
+edit_cmp(const void *a, const void *b) {
+	const struct RopeEdit *edit_a = *(const struct RopeEdit *const *)a;
+	const struct RopeEdit *edit_b = *(const struct RopeEdit *const *)b;
+
+	if (edit_a->byte_index != edit_b->byte_index) {
+		return edit_a->byte_index < edit_b->byte_index ? -1 : 1;
+	}
+	// Keep the order of edits at the same position.
+	return edit_a < edit_b ? -1 : edit_a > edit_b;
+}
+
+/*
+ * Moves every cursor behind the edits in `sorted` in one sweep. The cursor
+ * list is ordered by descending byte index, so it is walked along with the
+ * edits from the back. Markers are moved edit by edit, also from the back so
+ * the positions of the remaining edits stay valid.
+ */
+static void
+multi_edit_damaged(
+		struct Rope *rope, const struct RopeEdit **sorted, size_t count) {
+	for (size_t i = count; i > 0; i--) {
+		rope_markers_damaged(
+				rope, sorted[i - 1]->byte_index, sorted[i - 1]->delete_size,
+				sorted[i - 1]->byte_size);
+	}
+
+	off_t offset = 0;
+	for (size_t i = 0; i < count; i++) {
+		offset += (off_t)sorted[i]->byte_size - (off_t)sorted[i]->delete_size;
+	}
+
+	size_t i = count;
+	for (struct RopeCursor *c = rope->last_cursor; c && i > 0; c = c->prev) {
+		while (i > 0 && sorted[i - 1]->byte_index > c->byte_index) {
+			i--;
+			offset -= (off_t)sorted[i]->byte_size -
+					(off_t)sorted[i]->delete_size;
+		}
+		if (i == 0) {
+			break;
+		}
+
+		const struct RopeEdit *edit = sorted[i - 1];
+		if (c->byte_index < edit->byte_index + edit->delete_size) {
+			// Cursors in deleted text end up behind the inserted text.
+			const off_t before =
+					offset - (off_t)edit->byte_size + (off_t)edit->delete_size;
+			c->byte_index = edit->byte_index + before + edit->byte_size;
+		} else {
+			c->byte_index += offset;
+		}
+		c->callback(c->rope, c, c->userdata);
+	}
+}
+
+/*
+ * Applies a batch of edits, e.g. one keystroke at many cursors. Positions
+ * refer to the rope before the batch and edits must not overlap. Only the
+ * bookkeeping is batched: the edits are applied one by one from the back,
+ * each with its own lookup, while cursors are moved in a single sweep and
+ * chores run once. A cursor at an edit ends up behind the inserted text. If
+ * an edit fails, the edits behind it stay applied and cursors and markers
+ * follow them.
+ */
+int
+rope_multi_edit(
+		struct Rope *rope, const struct RopeEdit *edits, size_t count) {
+	int rv = 0;
+	const size_t rope_byte_size = rope_size(rope, ROPE_BYTE);
+	const struct RopeEdit **sorted = NULL;
+	// Only used to look up nodes, it is never attached to the rope.
+	struct RopeCursor finder = {.rope = rope};
+	struct RopeEdit partial = {0};
+	size_t applied = count;
+
+	if (count == 0) {
+		goto out;
+	}
+
+	sorted = calloc(count, sizeof(*sorted));
+	if (sorted == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (size_t i = 0; i < count; i++) {
+		sorted[i] = &edits[i];
+	}
+	qsort(sorted, count, sizeof(*sorted), edit_cmp);
+
+	size_t end = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (sorted[i]->byte_index < end ||
+			sorted[i]->delete_size > rope_byte_size - sorted[i]->byte_index) {
+			rv = -ROPE_ERROR_OOB;
+			goto out;
+		}
+		end = sorted[i]->byte_index + sorted[i]->delete_size;
+	}
+
+	// Apply from the back so the positions of the remaining edits stay
+	// valid.
+	for (; applied > 0; applied--) {
+		const struct RopeEdit *edit = sorted[applied - 1];
+		size_t bytes_deleted = 0;
+		if (edit->delete_size > 0) {
+			rv = edit_delete(
+					&finder, edit->byte_index, ROPE_BYTE, edit->delete_size,
+					&bytes_deleted);
+		}
+		if (rv >= 0 && edit->byte_size > 0) {
+			struct RopeStr str = {0};
+			rv = rope_str_init(&str, edit->data, edit->byte_size);
+			if (rv >= 0) {
+				rv = edit_insert(&finder, edit->byte_index, &str, edit->tags);
+			}
+			rope_str_cleanup(&str);
+		}
+		if (rv < 0 && bytes_deleted > 0) {
+			// The edit changed the rope before it failed, so cursors and
+			// markers have to follow the deleted bytes.
+			partial = (struct RopeEdit){
+					.byte_index = edit->byte_index,
+					.delete_size = bytes_deleted,
+			};
+			sorted[--applied] = &partial;
+		}
+		if (rv < 0) {
+			goto out;
+		}
+	}
+
+	rv = rope_chores(rope);
+out:
+	if (sorted != NULL) {
+		// On failure only the edits from `applied` on changed the rope.
+		multi_edit_damaged(rope, &sorted[applied], count - applied);
+	}
+	free(sorted);
+	return rv;
+}
+
 int
 rope_cursor_insert_cp(struct RopeCursor *cursor, uint32_t cp, uint64_t tags) {
 	uint8_t buffer[4];
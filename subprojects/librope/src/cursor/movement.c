@@ -9,6 +9,17 @@ rope_cursor_move_to(
 		uint64_t tags) {
 	size_t node_byte_index = 0;
 	size_t local_byte_index = 0;
+	if (unit == ROPE_LINE && tags == 0) {
+		// rope_cursor_find_node() ends up in the first leaf that has a newline
+		// behind the line start, which misses the start if the line spans
+		// leaves.
+		if (index > rope_size(cursor->rope, ROPE_LINE)) {
+			return -ROPE_ERROR_OOB;
+		}
+		cursor->byte_index = cursor_line_to_byte(cursor->rope, index);
+		cursor_update(cursor);
+		return 0;
+	}
 	struct RopeNode *node = rope_cursor_find_node(
 			cursor, NULL, unit, index, tags, &node_byte_index,
 			&local_byte_index);
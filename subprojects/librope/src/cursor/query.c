@@ -90,7 +90,7 @@ rope_node_byte_to_index(
 			return prefix;
 		}
 	} else {
-		do {
+		while (ROPE_NODE_IS_BRANCH(node)) {
 			struct RopeNode *left = rope_node_left(node);
 			const size_t left_byte_size = rope_node_size(left, ROPE_BYTE);
 
@@ -101,16 +101,214 @@ rope_node_byte_to_index(
 				byte_index -= left_byte_size;
 				node = rope_node_right(node);
 			}
-		} while (ROPE_NODE_IS_BRANCH(node));
+		}
 	}
 
 	return prefix + rope_str_unit_from_byte(&node->data.leaf, unit, byte_index);
 }
 
+/*
+ * Display columns from the start of the rope to `byte_index`, with tabs
+ * taking `tab_width` cells.
+ */
+static size_t
+byte_to_columns(struct Rope *rope, size_t byte_index) {
+	return rope_node_byte_to_index(rope->root, byte_index, ROPE_COLUMN, 0) +
+			rope->tab_width *
+			rope_node_byte_to_index(rope->root, byte_index, ROPE_TAB, 0);
+}
+
+static size_t
+node_columns(const struct RopeNode *node, size_t tab_width) {
+	return rope_node_size(node, ROPE_COLUMN) +
+			tab_width * rope_node_size(node, ROPE_TAB);
+}
+
+static size_t
+columns_to_byte(struct Rope *rope, size_t column) {
+	struct RopeNode *node = rope->root;
+	size_t byte_index = 0;
+
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		const size_t left_columns = node_columns(left, rope->tab_width);
+		if (column < left_columns) {
+			node = left;
+		} else {
+			column -= left_columns;
+			byte_index += rope_node_size(left, ROPE_BYTE);
+			node = rope_node_right(node);
+		}
+	}
+	return byte_index +
+			rope_str_column_to_byte(&node->data.leaf, column, rope->tab_width);
+}
+
+/*
+ * Returns the byte index right after the `line`th newline. Unlike
+ * rope_cursor_find_node(), this stays in the leaf that holds the newline.
+ */
+size_t
+cursor_line_to_byte(struct Rope *rope, size_t line) {
+	struct RopeNode *node = rope->root;
+	size_t byte_index = 0;
+
+	if (line == 0) {
+		return 0;
+	}
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		const size_t left_lines = rope_node_size(left, ROPE_LINE);
+		if (line <= left_lines) {
+			node = left;
+		} else {
+			line -= left_lines;
+			byte_index += rope_node_size(left, ROPE_BYTE);
+			node = rope_node_right(node);
+		}
+	}
+	return byte_index +
+			rope_str_unit_to_byte(&node->data.leaf, ROPE_LINE, line);
+}
+
 /*
  * Cursor query functions
  */
 
+/*
+ * Returns the display column of the cursor within its line. Tabs take
+ * `rope->tab_width` cells each, which matches tab stops for indentation.
+ */
+size_t
+rope_cursor_column(struct RopeCursor *cursor) {
+	struct Rope *rope = cursor->rope;
+	const size_t line = rope_cursor_index(cursor, ROPE_LINE, 0);
+	const size_t line_start = cursor_line_to_byte(rope, line);
+
+	return byte_to_columns(rope, cursor->byte_index) -
+			byte_to_columns(rope, line_start);
+}
+
+/*
+ * Returns the byte index of `column` within `line`, or the end of the line
+ * if the line is shorter.
+ */
+static size_t
+line_column_to_byte(struct Rope *rope, size_t line, size_t column) {
+	const size_t line_start = cursor_line_to_byte(rope, line);
+	size_t line_end = rope_size(rope, ROPE_BYTE);
+	if (line < rope_size(rope, ROPE_LINE)) {
+		line_end = cursor_line_to_byte(rope, line + 1) - 1;
+	}
+
+	const size_t target = byte_to_columns(rope, line_start) + column;
+	if (target < byte_to_columns(rope, line_end)) {
+		return columns_to_byte(rope, target);
+	}
+	return line_end;
+}
+
+/*
+ * Moves the cursor to a display column within its line. Columns past the
+ * end of the line move the cursor in front of the newline.
+ */
+int
+rope_cursor_move_to_column(struct RopeCursor *cursor, size_t column) {
+	struct Rope *rope = cursor->rope;
+	const size_t line = rope_cursor_index(cursor, ROPE_LINE, 0);
+	const size_t byte_index = line_column_to_byte(rope, line, column);
+	return rope_cursor_move_to(cursor, ROPE_BYTE, byte_index, 0);
+}
+
+/*
+ * Stores the screen row of the cursor in `row` when lines are soft wrapped
+ * after `width` cells.
+ */
+int
+rope_cursor_row(struct RopeCursor *cursor, size_t width, size_t *row) {
+	struct Rope *rope = cursor->rope;
+	if (width == 0) {
+		return -ROPE_ERROR_OOB;
+	}
+	const size_t line = rope_cursor_index(cursor, ROPE_LINE, 0);
+	const size_t first_row = rope_node_line_to_row(
+			rope->root, &rope->summaries, line, width, rope->tab_width);
+	size_t end_row = rope_wrap_rows(rope, width);
+	if (line < rope_size(rope, ROPE_LINE)) {
+		end_row = rope_node_line_to_row(
+				rope->root, &rope->summaries, line + 1, width,
+				rope->tab_width);
+	}
+
+	// A cursor behind the last cell of a full row stays on that row.
+	*row = first_row + rope_cursor_column(cursor) / width;
+	*row = CX_MIN(*row, end_row - 1);
+	return 0;
+}
+
+/*
+ * Moves the cursor to the start of a screen row when lines are soft wrapped
+ * after `width` cells.
+ */
+int
+rope_cursor_move_to_row(
+		struct RopeCursor *cursor, size_t width, size_t row) {
+	struct Rope *rope = cursor->rope;
+	if (width == 0 || row >= rope_wrap_rows(rope, width)) {
+		return -ROPE_ERROR_OOB;
+	}
+
+	size_t first_row = 0;
+	const size_t line = rope_node_row_to_line(
+			rope->root, &rope->summaries, row, width, rope->tab_width,
+			&first_row);
+	size_t byte_index = cursor_line_to_byte(rope, line);
+	// `row` exists, so the line is wider than the offset.
+	if (row > first_row) {
+		const size_t column = byte_to_columns(rope, byte_index) +
+				(row - first_row) * width;
+		byte_index = columns_to_byte(rope, column);
+	}
+	return rope_cursor_move_to(cursor, ROPE_BYTE, byte_index, 0);
+}
+
+/*
+ * Returns the number of words that start in front of the cursor.
+ */
+size_t
+rope_cursor_word(struct RopeCursor *cursor) {
+	struct Rope *rope = cursor->rope;
+	return rope_node_byte_to_word(
+			rope->root, &rope->summaries, cursor->byte_index);
+}
+
+/*
+ * Moves the cursor to the start of the `count`th next word, or for a
+ * negative `count` to the start of the current or a previous word. The
+ * cursor stops at the start and the end of the rope.
+ */
+int
+rope_cursor_move_words(struct RopeCursor *cursor, off_t count) {
+	struct RopeNode *root = cursor->rope->root;
+	struct RopeSummaries *summaries = &cursor->rope->summaries;
+	size_t byte_index = 0;
+
+	if (count > 0) {
+		// Includes the word that starts under the cursor.
+		const size_t word = rope_node_byte_to_word(
+				root, summaries, cursor->byte_index + 1);
+		byte_index = rope_node_word_to_byte(root, summaries, word + count - 1);
+	} else if (count < 0) {
+		const size_t word = rope_cursor_word(cursor);
+		if (word >= (size_t)-count) {
+			byte_index = rope_node_word_to_byte(root, summaries, word + count);
+		}
+	} else {
+		return 0;
+	}
+	return rope_cursor_move_to(cursor, ROPE_BYTE, byte_index, 0);
+}
+
 size_t
 rope_cursor_index(
 		struct RopeCursor *cursor, enum RopeUnit unit, uint64_t tags) {
@@ -0,0 +1,589 @@
+#define _GNU_SOURCE
+#include <cextras/macro.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <rope.h>
+#include <rope_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Diffs run in two passes. The common prefix and suffix are skipped first.
+ * Leaves that point to the same bytes of the same heap, e.g. after
+ * rope_range_copy_to(), are skipped without reading them, other leaves are
+ * compared byte by byte. The window in between is copied out of both ropes
+ * and diffed line by line with the Myers algorithm. If the window needs more
+ * than ROPE_DIFF_MAX_COST line edits, it is replaced as a whole instead.
+ */
+
+#define ROPE_DIFF_MAX_COST 1024
+
+struct DiffLine {
+	size_t offset;
+	size_t size;
+	uint64_t hash;
+};
+
+struct DiffWindow {
+	uint8_t *data;
+	size_t size;
+	struct DiffLine *lines;
+	size_t line_count;
+};
+
+struct Diff {
+	size_t offset;
+	struct DiffWindow a;
+	struct DiffWindow b;
+	struct RopeEdit *edits;
+	size_t edit_count;
+	size_t edit_capacity;
+};
+
+struct DiffHunk {
+	size_t a_start;
+	size_t a_end;
+	size_t b_start;
+	size_t b_end;
+};
+
+static size_t
+diff_prefix(struct Rope *a, struct Rope *b) {
+	struct RopeNode *node_a = rope_node_first(a->root);
+	struct RopeNode *node_b = rope_node_first(b->root);
+	size_t offset_a = 0;
+	size_t offset_b = 0;
+	size_t prefix = 0;
+
+	while (node_a != NULL && node_b != NULL) {
+		if (offset_a == 0 && offset_b == 0 &&
+			rope_str_is_same(&node_a->data.leaf, &node_b->data.leaf)) {
+			prefix += rope_node_size(node_a, ROPE_BYTE);
+			node_a = rope_node_next(node_a);
+			node_b = rope_node_next(node_b);
+			continue;
+		}
+
+		size_t size_a = 0;
+		size_t size_b = 0;
+		const uint8_t *data_a = rope_node_value(node_a, &size_a);
+		const uint8_t *data_b = rope_node_value(node_b, &size_b);
+		const size_t size = CX_MIN(size_a - offset_a, size_b - offset_b);
+		size_t i = 0;
+		if (memcmp(&data_a[offset_a], &data_b[offset_b], size) == 0) {
+			i = size;
+		}
+		while (i < size && data_a[offset_a + i] == data_b[offset_b + i]) {
+			i++;
+		}
+		prefix += i;
+		if (i < size) {
+			break;
+		}
+
+		offset_a += size;
+		offset_b += size;
+		if (offset_a == size_a) {
+			node_a = rope_node_next(node_a);
+			offset_a = 0;
+		}
+		if (offset_b == size_b) {
+			node_b = rope_node_next(node_b);
+			offset_b = 0;
+		}
+	}
+	return prefix;
+}
+
+/*
+ * Returns the common suffix, but no more than `limit` bytes so it doesn't
+ * overlap with the common prefix.
+ */
+static size_t
+diff_suffix(struct Rope *a, struct Rope *b, size_t limit) {
+	struct RopeNode *node_a = rope_node_last(a->root);
+	struct RopeNode *node_b = rope_node_last(b->root);
+	size_t end_a = 0;
+	size_t end_b = 0;
+	size_t suffix = 0;
+
+	while (node_a != NULL && node_b != NULL && suffix < limit) {
+		const size_t leaf_size = rope_node_size(node_a, ROPE_BYTE);
+		if (end_a == 0 && end_b == 0 && leaf_size <= limit - suffix &&
+			rope_str_is_same(&node_a->data.leaf, &node_b->data.leaf)) {
+			suffix += leaf_size;
+			node_a = rope_node_prev(node_a);
+			node_b = rope_node_prev(node_b);
+			continue;
+		}
+
+		size_t size_a = 0;
+		size_t size_b = 0;
+		const uint8_t *data_a = rope_node_value(node_a, &size_a);
+		const uint8_t *data_b = rope_node_value(node_b, &size_b);
+		const size_t size = CX_MIN(
+				CX_MIN(size_a - end_a, size_b - end_b), limit - suffix);
+		const uint8_t *last_a = &data_a[size_a - end_a - 1];
+		const uint8_t *last_b = &data_b[size_b - end_b - 1];
+		size_t i = 0;
+		if (memcmp(last_a + 1 - size, last_b + 1 - size, size) == 0) {
+			i = size;
+		}
+		while (i < size && *(last_a - i) == *(last_b - i)) {
+			i++;
+		}
+		suffix += i;
+		if (i < size) {
+			break;
+		}
+
+		end_a += size;
+		end_b += size;
+		if (end_a == size_a) {
+			node_a = rope_node_prev(node_a);
+			end_a = 0;
+		}
+		if (end_b == size_b) {
+			node_b = rope_node_prev(node_b);
+			end_b = 0;
+		}
+	}
+	return suffix;
+}
+
+/*
+ * Returns the leaf that contains `*byte_index` and makes the index relative
+ * to it.
+ */
+static struct RopeNode *
+diff_find(struct Rope *rope, size_t *byte_index) {
+	struct RopeNode *node = rope->root;
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		const size_t left_size = rope_node_size(left, ROPE_BYTE);
+		if (*byte_index < left_size) {
+			node = left;
+		} else {
+			node = rope_node_right(node);
+			*byte_index -= left_size;
+		}
+	}
+	return node;
+}
+
+/*
+ * Returns the start of the line that contains `byte_index`.
+ */
+static size_t
+diff_line_start(struct Rope *rope, size_t byte_index) {
+	size_t local_index = byte_index;
+	struct RopeNode *node = diff_find(rope, &local_index);
+	for (; node != NULL; node = rope_node_prev(node)) {
+		const uint8_t *data = rope_node_value(node, NULL);
+		const uint8_t *newline = memrchr(data, '\n', local_index);
+		if (newline != NULL) {
+			return byte_index - local_index + (newline - data) + 1;
+		}
+		byte_index -= local_index;
+		local_index = rope_node_prev(node) == NULL
+				? 0
+				: rope_node_size(rope_node_prev(node), ROPE_BYTE);
+	}
+	return 0;
+}
+
+/*
+ * Returns the end of the line that contains `byte_index`, behind its
+ * newline.
+ */
+static size_t
+diff_line_end(struct Rope *rope, size_t byte_index) {
+	size_t local_index = byte_index;
+	struct RopeNode *node = diff_find(rope, &local_index);
+	for (; node != NULL; node = rope_node_next(node)) {
+		size_t size = 0;
+		const uint8_t *data = rope_node_value(node, &size);
+		const uint8_t *newline =
+				memchr(&data[local_index], '\n', size - local_index);
+		if (newline != NULL) {
+			return byte_index + (newline - &data[local_index]) + 1;
+		}
+		byte_index += size - local_index;
+		local_index = 0;
+	}
+	return byte_index;
+}
+
+static uint64_t
+diff_hash(const uint8_t *data, size_t size) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/*
+ * Copies `size` bytes at `byte_index` out of `rope` and splits them into
+ * lines.
+ */
+static int
+diff_window_init(
+		struct DiffWindow *window, struct Rope *rope, size_t byte_index,
+		size_t size) {
+	int rv = 0;
+	window->size = size;
+	window->data = malloc(CX_MAX(size, 1));
+	if (window->data == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+
+	struct RopeNode *node = diff_find(rope, &byte_index);
+	for (size_t copied = 0; copied < size; node = rope_node_next(node)) {
+		size_t leaf_size = 0;
+		const uint8_t *data = rope_node_value(node, &leaf_size);
+		if (data == NULL) {
+			rv = -ROPE_ERROR_OOM;
+			goto out;
+		}
+		const size_t chunk = CX_MIN(leaf_size - byte_index, size - copied);
+		memcpy(&window->data[copied], &data[byte_index], chunk);
+		copied += chunk;
+		byte_index = 0;
+	}
+
+	size_t line_count = 0;
+	for (size_t i = 0; i < size; i++) {
+		line_count += window->data[i] == '\n';
+	}
+	line_count += 1;
+	window->lines = calloc(line_count, sizeof(struct DiffLine));
+	if (window->lines == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (size_t offset = 0; offset < size;) {
+		const uint8_t *newline =
+				memchr(&window->data[offset], '\n', size - offset);
+		const size_t end = newline ? (size_t)(newline - window->data) + 1
+								   : size;
+		struct DiffLine *line = &window->lines[window->line_count++];
+		line->offset = offset;
+		line->size = end - offset;
+		line->hash = diff_hash(&window->data[offset], line->size);
+		offset = end;
+	}
+out:
+	return rv;
+}
+
+static bool
+diff_line_equals(const struct Diff *diff, size_t x, size_t y) {
+	const struct DiffLine *a = &diff->a.lines[x];
+	const struct DiffLine *b = &diff->b.lines[y];
+	return a->hash == b->hash && a->size == b->size &&
+			memcmp(&diff->a.data[a->offset], &diff->b.data[b->offset],
+				   a->size) == 0;
+}
+
+static size_t
+diff_line_offset(const struct DiffWindow *window, size_t line) {
+	if (line == window->line_count) {
+		return window->size;
+	}
+	return window->lines[line].offset;
+}
+
+/*
+ * Adds the edit for a hunk of lines. Lines that only differ in a few bytes
+ * are trimmed to the bytes that actually changed.
+ */
+static int
+diff_add_hunk(struct Diff *diff, const struct DiffHunk *hunk) {
+	size_t a_start = diff_line_offset(&diff->a, hunk->a_start);
+	size_t a_end = diff_line_offset(&diff->a, hunk->a_end);
+	size_t b_start = diff_line_offset(&diff->b, hunk->b_start);
+	size_t b_end = diff_line_offset(&diff->b, hunk->b_end);
+
+	while (a_start < a_end && b_start < b_end &&
+		   diff->a.data[a_start] == diff->b.data[b_start]) {
+		a_start++;
+		b_start++;
+	}
+	while (a_start < a_end && b_start < b_end &&
+		   diff->a.data[a_end - 1] == diff->b.data[b_end - 1]) {
+		a_end--;
+		b_end--;
+	}
+	if (a_start == a_end && b_start == b_end) {
+		return 0;
+	}
+
+	if (diff->edit_count == diff->edit_capacity) {
+		const size_t capacity = CX_MAX(diff->edit_capacity * 2, 16);
+		struct RopeEdit *edits =
+				reallocarray(diff->edits, capacity, sizeof(*edits));
+		if (edits == NULL) {
+			return -ROPE_ERROR_OOM;
+		}
+		diff->edits = edits;
+		diff->edit_capacity = capacity;
+	}
+	diff->edits[diff->edit_count++] = (struct RopeEdit){
+			.byte_index = diff->offset + a_start,
+			.delete_size = a_end - a_start,
+			.data = &diff->b.data[b_start],
+			.byte_size = b_end - b_start,
+	};
+	return 0;
+}
+
+/*
+ * Walks the Myers trace back from the end and collects the hunks in
+ * reverse order. The trace holds V of every step d at offset d * d,
+ * indexed by k + d.
+ */
+static size_t
+diff_backtrack(
+		const struct Diff *diff, const size_t *trace, size_t cost,
+		struct DiffHunk *hunks) {
+	size_t x = diff->a.line_count;
+	size_t y = diff->b.line_count;
+	size_t hunk_count = 0;
+	bool in_hunk = false;
+
+	for (size_t d = cost; d > 0; d--) {
+		const size_t *v = &trace[(d - 1) * (d - 1) + (d - 1)];
+		const ptrdiff_t k = (ptrdiff_t)x - (ptrdiff_t)y;
+		size_t prev_x, prev_y, mid_x, mid_y;
+		if (k == -(ptrdiff_t)d || (k != (ptrdiff_t)d && v[k - 1] < v[k + 1])) {
+			prev_x = mid_x = v[k + 1];
+			prev_y = prev_x - (k + 1);
+			mid_y = prev_y + 1;
+		} else {
+			prev_x = v[k - 1];
+			prev_y = prev_x - (k - 1);
+			mid_x = prev_x + 1;
+			mid_y = prev_y;
+		}
+
+		if (x != mid_x) {
+			// Lines in between are equal.
+			in_hunk = false;
+		}
+		if (!in_hunk) {
+			hunks[hunk_count++] = (struct DiffHunk){
+					.a_end = mid_x,
+					.b_end = mid_y,
+			};
+			in_hunk = true;
+		}
+		hunks[hunk_count - 1].a_start = prev_x;
+		hunks[hunk_count - 1].b_start = prev_y;
+		x = prev_x;
+		y = prev_y;
+	}
+	return hunk_count;
+}
+
+/*
+ * Returns the number of line edits that turn the lines of `a` into the
+ * lines of `b`, or SIZE_MAX if it is larger than ROPE_DIFF_MAX_COST.
+ */
+static size_t
+diff_myers(const struct Diff *diff, size_t **trace_ptr) {
+	const size_t n = diff->a.line_count;
+	const size_t m = diff->b.line_count;
+	size_t *trace = NULL;
+
+	for (size_t d = 0; d <= ROPE_DIFF_MAX_COST; d++) {
+		size_t *new_trace =
+				reallocarray(trace, (d + 1) * (d + 1), sizeof(size_t));
+		if (new_trace == NULL) {
+			break;
+		}
+		trace = new_trace;
+		*trace_ptr = trace;
+
+		size_t *v = &trace[d * d + d];
+		const size_t *prev = d == 0 ? NULL : &v[-(ptrdiff_t)(2 * d)];
+		for (ptrdiff_t k = -(ptrdiff_t)d; k <= (ptrdiff_t)d; k += 2) {
+			size_t x = 0;
+			if (d == 0) {
+				x = 0;
+			} else if (
+					k == -(ptrdiff_t)d ||
+					(k != (ptrdiff_t)d && prev[k - 1] < prev[k + 1])) {
+				x = prev[k + 1];
+			} else {
+				x = prev[k - 1] + 1;
+			}
+			size_t y = x - k;
+			while (x < n && y < m && diff_line_equals(diff, x, y)) {
+				x++;
+				y++;
+			}
+			v[k] = x;
+			if (x >= n && y >= m) {
+				return d;
+			}
+		}
+	}
+	return SIZE_MAX;
+}
+
+static void
+diff_cleanup(struct Diff *diff) {
+	free(diff->a.data);
+	free(diff->a.lines);
+	free(diff->b.data);
+	free(diff->b.lines);
+	free(diff->edits);
+}
+
+/*
+ * Computes the edits that turn `a` into `b`. The inserted data of the edits
+ * points into `diff` and lives until diff_cleanup().
+ */
+static int
+diff_run(struct Diff *diff, struct Rope *a, struct Rope *b) {
+	int rv = 0;
+	size_t *trace = NULL;
+	struct DiffHunk *hunks = NULL;
+	const size_t size_a = rope_size(a, ROPE_BYTE);
+	const size_t size_b = rope_size(b, ROPE_BYTE);
+
+	memset(diff, 0, sizeof(*diff));
+	const size_t prefix = diff_prefix(a, b);
+	const size_t suffix =
+			diff_suffix(a, b, CX_MIN(size_a, size_b) - prefix);
+	if (prefix + suffix == size_a && size_a == size_b) {
+		goto out;
+	}
+
+	// Diff whole lines, the hunks are trimmed to the changed bytes later.
+	const size_t start = diff_line_start(a, prefix);
+	const size_t end = size_a - diff_line_end(a, size_a - suffix);
+	diff->offset = start;
+	rv = diff_window_init(&diff->a, a, start, size_a - start - end);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = diff_window_init(&diff->b, b, start, size_b - start - end);
+	if (rv < 0) {
+		goto out;
+	}
+
+	const size_t cost = diff_myers(diff, &trace);
+	if (cost == SIZE_MAX) {
+		const struct DiffHunk hunk = {
+				.a_end = diff->a.line_count,
+				.b_end = diff->b.line_count,
+		};
+		rv = diff_add_hunk(diff, &hunk);
+		goto out;
+	}
+
+	hunks = calloc(CX_MAX(cost, 1), sizeof(struct DiffHunk));
+	if (hunks == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (size_t i = diff_backtrack(diff, trace, cost, hunks); i > 0; i--) {
+		rv = diff_add_hunk(diff, &hunks[i - 1]);
+		if (rv < 0) {
+			goto out;
+		}
+	}
+out:
+	free(hunks);
+	free(trace);
+	return rv;
+}
+
+/*
+ * Calls `callback` with the edits that turn `rope` into `other`, ordered by
+ * their position. All positions refer to `rope` before any edit, so the
+ * edits can be applied at once with rope_multi_edit(). The data of an edit
+ * is only valid during the callback. A callback that returns a negative
+ * value stops the diff and the value is returned.
+ */
+int
+rope_diff(
+		struct Rope *rope, struct Rope *other, rope_diff_callback_t callback,
+		void *userdata) {
+	int rv = 0;
+	struct Diff diff = {0};
+
+	rv = diff_run(&diff, rope, other);
+	if (rv < 0) {
+		goto out;
+	}
+	for (size_t i = 0; i < diff.edit_count; i++) {
+		rv = callback(&diff.edits[i], userdata);
+		if (rv < 0) {
+			goto out;
+		}
+	}
+out:
+	diff_cleanup(&diff);
+	return rv;
+}
+
+/*
+ * Changes `rope` to the content of `other` with a single rope_multi_edit(),
+ * so cursors and markers in unchanged text stay where they are.
+ */
+int
+rope_diff_apply(struct Rope *rope, struct Rope *other) {
+	int rv = 0;
+	struct Diff diff = {0};
+
+	rv = diff_run(&diff, rope, other);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_multi_edit(rope, diff.edits, diff.edit_count);
+out:
+	diff_cleanup(&diff);
+	return rv;
+}
+
+/*
+ * Reloads `rope` from the file behind `fd`. The file is mapped like with
+ * rope_map_fd() and only the changed bytes are copied into `rope`.
+ */
+int
+rope_reload_fd(struct Rope *rope, int fd) {
+	int rv = 0;
+	struct Rope other = {0};
+
+	rv = rope_init(&other, rope->pool);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_map_fd(&other, fd);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_diff_apply(rope, &other);
+out:
+	rope_cleanup(&other);
+	return rv;
+}
+
+int
+rope_reload_file(struct Rope *rope, const char *path) {
+	int rv = 0;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -errno;
+	}
+	rv = rope_reload_fd(rope, fd);
+	close(fd);
+	return rv;
+}
@@ -0,0 +1,374 @@
+#include <assert.h>
+#include <rope.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Server side operational transformation. Every edit applied through a
+ * history is recorded as a sequence of primitive insert and delete
+ * operations, one per revision. An edit that was made against an older
+ * revision is transformed against the operations applied since, so writers
+ * can keep editing while their view of the document lags behind.
+ *
+ * Positions are counted in `history->unit`. Transformation is exact for
+ * units that add up when strings are concatenated (bytes, codepoints, UTF-16
+ * code units). Grapheme clusters may merge across edit boundaries, so
+ * ROPE_CHAR positions can drift in rare cases.
+ */
+
+static int
+log_reserve(struct RopeHistoryLog *log, size_t count) {
+	if (log->count + count <= log->capacity) {
+		return 0;
+	}
+	size_t capacity = log->capacity ? log->capacity * 2 : 16;
+	while (capacity < log->count + count) {
+		capacity *= 2;
+	}
+	struct RopeHistoryOp *ops = realloc(log->ops, capacity * sizeof(*ops));
+	if (ops == NULL) {
+		return -ROPE_ERROR_OOM;
+	}
+	log->ops = ops;
+	log->capacity = capacity;
+	return 0;
+}
+
+static int
+log_push(struct RopeHistoryLog *log, const struct RopeHistoryOp *op) {
+	int rv = log_reserve(log, 1);
+	if (rv < 0) {
+		return rv;
+	}
+	log->ops[log->count++] = *op;
+	return 0;
+}
+
+/*
+ * Replaces the operation at `index` with `count` operations.
+ */
+static int
+log_splice(
+		struct RopeHistoryLog *log, size_t index,
+		const struct RopeHistoryOp *ops, size_t count) {
+	if (count > 1) {
+		int rv = log_reserve(log, count - 1);
+		if (rv < 0) {
+			return rv;
+		}
+	}
+	memmove(&log->ops[index + count], &log->ops[index + 1],
+			(log->count - index - 1) * sizeof(*ops));
+	memcpy(&log->ops[index], ops, count * sizeof(*ops));
+	log->count = log->count + count - 1;
+	return 0;
+}
+
+static void
+log_cleanup(struct RopeHistoryLog *log) {
+	free(log->ops);
+	memset(log, 0, sizeof(*log));
+}
+
+static size_t
+position_after_delete(size_t index, const struct RopeHistoryOp *delete) {
+	if (index >= delete->index + delete->size) {
+		return index - delete->size;
+	} else if (index > delete->index) {
+		return delete->index;
+	} else {
+		return index;
+	}
+}
+
+static size_t
+delete_after_insert(
+		const struct RopeHistoryOp *delete, const struct RopeHistoryOp *insert,
+		struct RopeHistoryOp out[2]) {
+	out[0] = *delete;
+	if (insert->index <= delete->index) {
+		out[0].index += insert->size;
+		return 1;
+	} else if (insert->index >= delete->index + delete->size) {
+		return 1;
+	}
+	// The insert landed inside the deleted range. Keep it by deleting around
+	// it.
+	const size_t head = insert->index - delete->index;
+	out[0].size = head;
+	out[1].type = ROPE_HISTORY_DELETE;
+	out[1].index = delete->index + insert->size;
+	out[1].size = delete->size - head;
+	return 2;
+}
+
+static size_t
+insert_after_delete(
+		const struct RopeHistoryOp *insert, const struct RopeHistoryOp *delete,
+		struct RopeHistoryOp out[2]) {
+	out[0] = *insert;
+	out[0].index = position_after_delete(insert->index, delete);
+	return 1;
+}
+
+static size_t
+delete_after_delete(
+		const struct RopeHistoryOp *op, const struct RopeHistoryOp *delete,
+		struct RopeHistoryOp out[2]) {
+	const size_t start = position_after_delete(op->index, delete);
+	const size_t end = position_after_delete(op->index + op->size, delete);
+	if (start == end) {
+		return 0;
+	}
+	out[0].type = ROPE_HISTORY_DELETE;
+	out[0].index = start;
+	out[0].size = end - start;
+	return 1;
+}
+
+/*
+ * Transforms the concurrent operations `a` and `b` that start from the same
+ * state: `a_out` applies after `b` and `b_out` applies after `a`. Inserts at
+ * the same position place `a` behind `b`.
+ */
+static void
+transform_pair(
+		const struct RopeHistoryOp *a, const struct RopeHistoryOp *b,
+		struct RopeHistoryOp a_out[2], size_t *a_count,
+		struct RopeHistoryOp b_out[2], size_t *b_count) {
+	if (a->type == ROPE_HISTORY_INSERT && b->type == ROPE_HISTORY_INSERT) {
+		a_out[0] = *a;
+		b_out[0] = *b;
+		if (a->index < b->index) {
+			b_out[0].index += a->size;
+		} else {
+			a_out[0].index += b->size;
+		}
+		*a_count = *b_count = 1;
+	} else if (a->type == ROPE_HISTORY_INSERT) {
+		*a_count = insert_after_delete(a, b, a_out);
+		*b_count = delete_after_insert(b, a, b_out);
+	} else if (b->type == ROPE_HISTORY_INSERT) {
+		*a_count = delete_after_insert(a, b, a_out);
+		*b_count = insert_after_delete(b, a, b_out);
+	} else {
+		*a_count = delete_after_delete(a, b, a_out);
+		*b_count = delete_after_delete(b, a, b_out);
+	}
+}
+
+/*
+ * Transforms `op` against the operations in `concurrent`. On return `out`
+ * holds `op` as it applies after `concurrent`, and `concurrent` is
+ * rewritten to apply after `out`.
+ */
+static int
+transform(
+		struct RopeHistoryLog *out, struct RopeHistoryLog *scratch,
+		const struct RopeHistoryOp *op, struct RopeHistoryLog *concurrent) {
+	int rv = 0;
+	out->count = 0;
+	rv = log_push(out, op);
+	if (rv < 0) {
+		goto out;
+	}
+
+	for (size_t i = 0; i < concurrent->count && out->count > 0;) {
+		struct RopeHistoryOp b[2] = {concurrent->ops[i]};
+		size_t b_count = 1;
+
+		scratch->count = 0;
+		for (size_t j = 0; j < out->count; j++) {
+			struct RopeHistoryOp a_pieces[2];
+			size_t a_count = 0;
+			if (b_count == 0) {
+				a_pieces[a_count++] = out->ops[j];
+			} else {
+				// Only a single insert can split a delete, and inserts
+				// never split, so `b` has at most two pieces here.
+				assert(b_count == 1 || out->count == 1);
+				struct RopeHistoryOp b_in = b[0];
+				transform_pair(
+						&out->ops[j], &b_in, a_pieces, &a_count, b, &b_count);
+			}
+			for (size_t k = 0; k < a_count; k++) {
+				rv = log_push(scratch, &a_pieces[k]);
+				if (rv < 0) {
+					goto out;
+				}
+			}
+		}
+
+		if (b_count == 0) {
+			memmove(&concurrent->ops[i], &concurrent->ops[i + 1],
+					(concurrent->count - i - 1) * sizeof(*b));
+			concurrent->count--;
+		} else {
+			rv = log_splice(concurrent, i, b, b_count);
+			if (rv < 0) {
+				goto out;
+			}
+			i += b_count;
+		}
+
+		struct RopeHistoryLog tmp = *out;
+		*out = *scratch;
+		*scratch = tmp;
+	}
+
+out:
+	return rv;
+}
+
+static int
+history_apply_op(
+		struct RopeHistory *history, struct RopeHistoryLog *concurrent,
+		struct RopeHistoryLog *ops, struct RopeHistoryLog *scratch,
+		const struct RopeHistoryOp *op, const uint8_t *data,
+		size_t byte_size) {
+	int rv = 0;
+	struct Rope *rope = history->rope;
+
+	rv = transform(ops, scratch, op, concurrent);
+	if (rv < 0) {
+		goto out;
+	}
+
+	rv = log_reserve(&history->log, ops->count);
+	if (rv < 0) {
+		goto out;
+	}
+	for (size_t i = 0; i < ops->count; i++) {
+		const struct RopeHistoryOp *piece = &ops->ops[i];
+		if (piece->type == ROPE_HISTORY_INSERT) {
+			rv = rope_insert(
+					rope, history->unit, piece->index, data, byte_size);
+		} else {
+			rv = rope_delete(rope, history->unit, piece->index, piece->size);
+		}
+		if (rv < 0) {
+			goto out;
+		}
+		history->log.ops[history->log.count++] = *piece;
+	}
+out:
+	return rv;
+}
+
+static int
+insert_size(
+		enum RopeUnit unit, const uint8_t *data, size_t byte_size,
+		size_t *size) {
+	struct RopeStr str = {0};
+	if (unit == ROPE_BYTE) {
+		*size = byte_size;
+		return 0;
+	}
+	int rv = rope_str_init(&str, data, byte_size);
+	if (rv < 0) {
+		return rv;
+	}
+	*size = rope_str_size(&str, unit);
+	rope_str_cleanup(&str);
+	return 0;
+}
+
+int
+rope_history_init(
+		struct RopeHistory *history, struct Rope *rope, enum RopeUnit unit) {
+	memset(history, 0, sizeof(*history));
+	history->rope = rope;
+	history->unit = unit;
+	return 0;
+}
+
+size_t
+rope_history_revision(const struct RopeHistory *history) {
+	return history->first_revision + history->log.count;
+}
+
+int
+rope_history_apply(
+		struct RopeHistory *history, size_t revision,
+		const struct RopeHistoryEdit *edits, size_t count) {
+	int rv = 0;
+	struct RopeHistoryLog concurrent = {0};
+	struct RopeHistoryLog ops = {0};
+	struct RopeHistoryLog scratch = {0};
+
+	if (revision < history->first_revision ||
+		revision > rope_history_revision(history)) {
+		rv = -ROPE_ERROR_OOB;
+		goto out;
+	}
+
+	for (size_t i = revision - history->first_revision;
+		 i < history->log.count; i++) {
+		rv = log_push(&concurrent, &history->log.ops[i]);
+		if (rv < 0) {
+			goto out;
+		}
+	}
+
+	// Edits are sequential: each one is based on the state left by the
+	// previous one, so `concurrent` is carried along.
+	for (size_t i = 0; i < count; i++) {
+		const struct RopeHistoryEdit *edit = &edits[i];
+		if (edit->delete_count > 0) {
+			struct RopeHistoryOp op = {
+					.type = ROPE_HISTORY_DELETE,
+					.index = edit->index,
+					.size = edit->delete_count,
+			};
+			rv = history_apply_op(
+					history, &concurrent, &ops, &scratch, &op, NULL, 0);
+			if (rv < 0) {
+				goto out;
+			}
+		}
+		if (edit->byte_size > 0) {
+			struct RopeHistoryOp op = {
+					.type = ROPE_HISTORY_INSERT,
+					.index = edit->index,
+			};
+			rv = insert_size(
+					history->unit, edit->data, edit->byte_size, &op.size);
+			if (rv < 0) {
+				goto out;
+			}
+			rv = history_apply_op(
+					history, &concurrent, &ops, &scratch, &op, edit->data,
+					edit->byte_size);
+			if (rv < 0) {
+				goto out;
+			}
+		}
+	}
+
+out:
+	log_cleanup(&concurrent);
+	log_cleanup(&ops);
+	log_cleanup(&scratch);
+	return rv;
+}
+
+void
+rope_history_trim(struct RopeHistory *history, size_t revision) {
+	if (revision <= history->first_revision) {
+		return;
+	}
+	size_t count = revision - history->first_revision;
+	if (count > history->log.count) {
+		count = history->log.count;
+	}
+	memmove(history->log.ops, &history->log.ops[count],
+			(history->log.count - count) * sizeof(*history->log.ops));
+	history->log.count -= count;
+	history->first_revision += count;
+}
+
+void
+rope_history_cleanup(struct RopeHistory *history) {
+	log_cleanup(&history->log);
+	memset(history, 0, sizeof(*history));
+}
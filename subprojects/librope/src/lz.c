@@ -0,0 +1,207 @@
+#include <cextras/macro.h>
+#include <rope_error.h>
+#include <rope_str.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * A small LZ77 codec in the spirit of LZ4 for compressing cold leaves.
+ *
+ * A block is a list of sequences. Each sequence starts with a token whose
+ * high nibble is the literal count and whose low nibble is the match length
+ * minus ROPE_LZ_MIN_MATCH. A nibble of 15 is followed by extension bytes
+ * that are added to it until a byte is not 255. The literals follow, then
+ * the match offset as 16 bit little endian. The last sequence only has
+ * literals and ends the block.
+ */
+
+#define ROPE_LZ_HASH_BITS 12
+#define ROPE_LZ_MIN_MATCH 4
+#define ROPE_LZ_MAX_OFFSET UINT16_MAX
+
+struct LzWriter {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+};
+
+static uint32_t
+lz_read32(const uint8_t *data) {
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static size_t
+lz_hash(uint32_t value) {
+	return (value * UINT32_C(2654435761)) >> (32 - ROPE_LZ_HASH_BITS);
+}
+
+static void
+lz_put(struct LzWriter *writer, const uint8_t *data, size_t size) {
+	if (size <= writer->capacity - CX_MIN(writer->size, writer->capacity)) {
+		memcpy(&writer->data[writer->size], data, size);
+	}
+	writer->size += size;
+}
+
+static void
+lz_put_length(struct LzWriter *writer, size_t length) {
+	static const uint8_t full = UINT8_MAX;
+	for (; length >= UINT8_MAX; length -= UINT8_MAX) {
+		lz_put(writer, &full, 1);
+	}
+	const uint8_t rest = length;
+	lz_put(writer, &rest, 1);
+}
+
+static void
+lz_put_sequence(
+		struct LzWriter *writer, const uint8_t *literals, size_t literal_count,
+		size_t offset, size_t match_length) {
+	const size_t match_code =
+			match_length == 0 ? 0 : match_length - ROPE_LZ_MIN_MATCH;
+	const uint8_t token =
+			CX_MIN(literal_count, 15) << 4 | CX_MIN(match_code, 15);
+
+	lz_put(writer, &token, 1);
+	if (literal_count >= 15) {
+		lz_put_length(writer, literal_count - 15);
+	}
+	lz_put(writer, literals, literal_count);
+	if (match_length == 0) {
+		return;
+	}
+
+	const uint8_t offset_bytes[] = {offset & 0xFF, offset >> 8};
+	lz_put(writer, offset_bytes, sizeof(offset_bytes));
+	if (match_code >= 15) {
+		lz_put_length(writer, match_code - 15);
+	}
+}
+
+/*
+ * Compresses `size` bytes of `data` into `target`. Returns the compressed
+ * size, or 0 if it doesn't fit into `capacity` bytes.
+ */
+size_t
+rope_lz_compress(
+		const uint8_t *data, size_t size, uint8_t *target, size_t capacity) {
+	// Positions are stored plus one, so zero marks an empty slot.
+	uint32_t table[1 << ROPE_LZ_HASH_BITS] = {0};
+	struct LzWriter writer = {.data = target, .capacity = capacity};
+	size_t anchor = 0;
+	size_t pos = 0;
+
+	if (size >= UINT32_MAX) {
+		return 0;
+	}
+
+	while (size - pos >= ROPE_LZ_MIN_MATCH && writer.size <= capacity) {
+		const uint32_t value = lz_read32(&data[pos]);
+		const size_t hash = lz_hash(value);
+		const size_t candidate = table[hash];
+		table[hash] = pos + 1;
+		if (candidate == 0 || pos + 1 - candidate > ROPE_LZ_MAX_OFFSET ||
+			lz_read32(&data[candidate - 1]) != value) {
+			pos++;
+			continue;
+		}
+
+		const uint8_t *match = &data[candidate - 1];
+		size_t length = ROPE_LZ_MIN_MATCH;
+		while (pos + length < size && match[length] == data[pos + length]) {
+			length++;
+		}
+		lz_put_sequence(
+				&writer, &data[anchor], pos - anchor, &data[pos] - match,
+				length);
+		pos += length;
+		anchor = pos;
+	}
+	lz_put_sequence(&writer, &data[anchor], size - anchor, 0, 0);
+
+	return writer.size <= capacity ? writer.size : 0;
+}
+
+static int
+lz_get_length(
+		const uint8_t *data, size_t size, size_t *pos, size_t *length) {
+	if (*length != 15) {
+		return 0;
+	}
+	for (;;) {
+		if (*pos >= size) {
+			return -ROPE_ERROR_INVALID_FORMAT;
+		}
+		const uint8_t byte = data[(*pos)++];
+		*length += byte;
+		if (byte != UINT8_MAX) {
+			return 0;
+		}
+	}
+}
+
+/*
+ * Decompresses a block into exactly `target_size` bytes of `target`.
+ */
+int
+rope_lz_decompress(
+		const uint8_t *data, size_t size, uint8_t *target, size_t target_size) {
+	int rv = 0;
+	size_t pos = 0;
+	size_t target_pos = 0;
+
+	for (;;) {
+		if (pos >= size) {
+			// The block ends without a sequence that only has literals.
+			rv = -ROPE_ERROR_INVALID_FORMAT;
+			goto out;
+		}
+		const uint8_t token = data[pos++];
+		size_t literal_count = token >> 4;
+		rv = lz_get_length(data, size, &pos, &literal_count);
+		if (rv < 0) {
+			goto out;
+		} else if (literal_count > size - pos ||
+				   literal_count > target_size - target_pos) {
+			rv = -ROPE_ERROR_INVALID_FORMAT;
+			goto out;
+		}
+		memcpy(&target[target_pos], &data[pos], literal_count);
+		pos += literal_count;
+		target_pos += literal_count;
+		if (pos == size) {
+			break;
+		}
+
+		if (size - pos < 2) {
+			rv = -ROPE_ERROR_INVALID_FORMAT;
+			goto out;
+		}
+		const size_t offset = data[pos] | (size_t)data[pos + 1] << 8;
+		pos += 2;
+		size_t length = token & 0xF;
+		rv = lz_get_length(data, size, &pos, &length);
+		if (rv < 0) {
+			goto out;
+		}
+		length += ROPE_LZ_MIN_MATCH;
+		if (offset == 0 || offset > target_pos ||
+			length > target_size - target_pos) {
+			rv = -ROPE_ERROR_INVALID_FORMAT;
+			goto out;
+		}
+		// Matches may overlap with the bytes they produce.
+		for (size_t i = 0; i < length; i++) {
+			target[target_pos + i] = target[target_pos - offset + i];
+		}
+		target_pos += length;
+	}
+
+	if (target_pos != target_size) {
+		rv = -ROPE_ERROR_INVALID_FORMAT;
+	}
+out:
+	return rv;
+}
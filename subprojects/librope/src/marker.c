@@ -0,0 +1,356 @@
+#include <rope.h>
+#include <string.h>
+
+/*
+ * Markers are kept in a treap ordered by their start. Every marker knows the
+ * largest end in its subtree for interval queries, and a pending `delta`
+ * that still has to be added to all positions of its subtree. An edit
+ * splits the treap around the edited bytes, shifts everything behind them
+ * by updating a single `delta` and only visits the markers that overlap the
+ * edit.
+ *
+ * Starts move behind text inserted at their position, ends stay in front of
+ * it, so markers don't grow when text is typed at their boundaries.
+ */
+
+static void
+marker_set_child(
+		struct RopeMarker *marker, enum RopeDirection which,
+		struct RopeMarker *child) {
+	marker->children[which] = child;
+	if (child != NULL) {
+		child->parent = marker;
+	}
+}
+
+static void
+marker_update(struct RopeMarker *marker) {
+	size_t max_end = marker->end;
+	for (int which = ROPE_LEFT; which <= ROPE_RIGHT; which++) {
+		const struct RopeMarker *child = marker->children[which];
+		if (child != NULL && child->max_end + child->delta > max_end) {
+			max_end = child->max_end + child->delta;
+		}
+	}
+	marker->max_end = max_end;
+}
+
+static void
+marker_push(struct RopeMarker *marker) {
+	const off_t delta = marker->delta;
+	if (delta == 0) {
+		return;
+	}
+	marker->start += delta;
+	marker->end += delta;
+	marker->max_end += delta;
+	for (int which = ROPE_LEFT; which <= ROPE_RIGHT; which++) {
+		if (marker->children[which] != NULL) {
+			marker->children[which]->delta += delta;
+		}
+	}
+	marker->delta = 0;
+}
+
+static void
+marker_push_path(struct RopeMarker *marker) {
+	if (marker->parent != NULL) {
+		marker_push_path(marker->parent);
+	}
+	marker_push(marker);
+}
+
+static off_t
+marker_offset(const struct RopeMarker *marker) {
+	off_t offset = 0;
+	for (; marker != NULL; marker = marker->parent) {
+		offset += marker->delta;
+	}
+	return offset;
+}
+
+/*
+ * Splits the treap into the markers that start before `byte_index` and the
+ * rest.
+ */
+static void
+markers_split(
+		struct RopeMarker *marker, size_t byte_index, struct RopeMarker **left,
+		struct RopeMarker **right) {
+	struct RopeMarker *split_left = NULL;
+	struct RopeMarker *split_right = NULL;
+	if (marker == NULL) {
+		*left = *right = NULL;
+		return;
+	}
+
+	marker_push(marker);
+	if (marker->start < byte_index) {
+		markers_split(
+				marker->children[ROPE_RIGHT], byte_index, &split_left,
+				&split_right);
+		marker_set_child(marker, ROPE_RIGHT, split_left);
+		*left = marker;
+		*right = split_right;
+	} else {
+		markers_split(
+				marker->children[ROPE_LEFT], byte_index, &split_left,
+				&split_right);
+		marker_set_child(marker, ROPE_LEFT, split_right);
+		*left = split_left;
+		*right = marker;
+	}
+	marker_update(marker);
+}
+
+/*
+ * Joins two treaps. All markers in `left` must start before or at the
+ * markers in `right`.
+ */
+static struct RopeMarker *
+markers_merge(struct RopeMarker *left, struct RopeMarker *right) {
+	if (left == NULL) {
+		return right;
+	} else if (right == NULL) {
+		return left;
+	}
+
+	if (left->priority > right->priority) {
+		marker_push(left);
+		marker_set_child(
+				left, ROPE_RIGHT,
+				markers_merge(left->children[ROPE_RIGHT], right));
+		marker_update(left);
+		return left;
+	} else {
+		marker_push(right);
+		marker_set_child(
+				right, ROPE_LEFT,
+				markers_merge(left, right->children[ROPE_LEFT]));
+		marker_update(right);
+		return right;
+	}
+}
+
+static void
+markers_set_root(struct RopeMarkers *markers, struct RopeMarker *root) {
+	markers->root = root;
+	if (root != NULL) {
+		root->parent = NULL;
+	}
+}
+
+/*
+ * Moves the ends of markers that start in front of the edit.
+ */
+static void
+markers_damage_ends(
+		struct RopeMarker *marker, size_t byte_index, size_t delete_size,
+		size_t insert_size) {
+	if (marker == NULL || marker->max_end + marker->delta <= byte_index) {
+		return;
+	}
+
+	marker_push(marker);
+	if (marker->end <= byte_index) {
+		// In front of the edit
+	} else if (marker->end >= byte_index + delete_size) {
+		marker->end = marker->end - delete_size + insert_size;
+	} else {
+		marker->end = byte_index;
+	}
+	for (int which = ROPE_LEFT; which <= ROPE_RIGHT; which++) {
+		markers_damage_ends(
+				marker->children[which], byte_index, delete_size, insert_size);
+	}
+	marker_update(marker);
+}
+
+/*
+ * Moves markers that start in the deleted bytes behind the inserted text.
+ */
+static void
+markers_damage_deleted(
+		struct RopeMarker *marker, size_t byte_index, size_t delete_size,
+		size_t insert_size) {
+	if (marker == NULL) {
+		return;
+	}
+
+	marker_push(marker);
+	marker->start = byte_index + insert_size;
+	if (marker->end >= byte_index + delete_size) {
+		marker->end = marker->end - delete_size + insert_size;
+	} else {
+		marker->end = marker->start;
+	}
+	for (int which = ROPE_LEFT; which <= ROPE_RIGHT; which++) {
+		markers_damage_deleted(
+				marker->children[which], byte_index, delete_size, insert_size);
+	}
+	marker_update(marker);
+}
+
+static void
+markers_damaged(
+		struct RopeMarkers *markers, size_t byte_index, size_t delete_size,
+		size_t insert_size) {
+	struct RopeMarker *front = NULL;
+	struct RopeMarker *deleted = NULL;
+	struct RopeMarker *back = NULL;
+
+	markers_split(markers->root, byte_index, &front, &back);
+	markers_split(back, byte_index + delete_size, &deleted, &back);
+
+	markers_damage_ends(front, byte_index, delete_size, insert_size);
+	markers_damage_deleted(deleted, byte_index, delete_size, insert_size);
+	if (back != NULL) {
+		back->delta += (off_t)insert_size - (off_t)delete_size;
+	}
+
+	markers_set_root(
+			markers, markers_merge(markers_merge(front, deleted), back));
+}
+
+static void
+markers_query(
+		struct RopeMarker *marker, off_t offset, size_t from, size_t to,
+		rope_marker_callback_t callback, void *userdata) {
+	if (marker == NULL) {
+		return;
+	}
+	offset += marker->delta;
+	if (marker->max_end + offset < from) {
+		return;
+	}
+
+	markers_query(
+			marker->children[ROPE_LEFT], offset, from, to, callback, userdata);
+
+	const size_t start = marker->start + offset;
+	const size_t end = marker->end + offset;
+	if (start >= to) {
+		return;
+	}
+	if (end > from || (start == end && start >= from)) {
+		callback(marker, start, end, userdata);
+	}
+
+	markers_query(
+			marker->children[ROPE_RIGHT], offset, from, to, callback, userdata);
+}
+
+int
+rope_markers_init(struct RopeMarkers *markers, struct Rope *rope) {
+	memset(markers, 0, sizeof(*markers));
+	markers->rope = rope;
+	markers->seed = 0x9e3779b97f4a7c15ull;
+	markers->next = rope->markers;
+	rope->markers = markers;
+	return 0;
+}
+
+/*
+ * Adds `marker` for the bytes from `start` to `end`. Empty markers are
+ * allowed and behave like a cursor.
+ */
+int
+rope_markers_add(
+		struct RopeMarkers *markers, struct RopeMarker *marker, size_t start,
+		size_t end) {
+	struct RopeMarker *left = NULL;
+	struct RopeMarker *right = NULL;
+	if (start > end || end > rope_size(markers->rope, ROPE_BYTE)) {
+		return -ROPE_ERROR_OOB;
+	}
+
+	// xorshift64
+	uint64_t seed = markers->seed;
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	markers->seed = seed;
+
+	memset(marker->children, 0, sizeof(marker->children));
+	marker->start = start;
+	marker->end = end;
+	marker->max_end = end;
+	marker->delta = 0;
+	marker->priority = (uint32_t)(seed >> 32);
+
+	markers_split(markers->root, start, &left, &right);
+	markers_set_root(
+			markers, markers_merge(markers_merge(left, marker), right));
+	return 0;
+}
+
+void
+rope_markers_remove(struct RopeMarkers *markers, struct RopeMarker *marker) {
+	marker_push_path(marker);
+
+	struct RopeMarker *parent = marker->parent;
+	struct RopeMarker *merged = markers_merge(
+			marker->children[ROPE_LEFT], marker->children[ROPE_RIGHT]);
+	if (parent == NULL) {
+		markers_set_root(markers, merged);
+	} else {
+		const enum RopeDirection which =
+				parent->children[ROPE_LEFT] == marker ? ROPE_LEFT : ROPE_RIGHT;
+		marker_set_child(parent, which, merged);
+		for (; parent != NULL; parent = parent->parent) {
+			marker_update(parent);
+		}
+	}
+
+	memset(marker->children, 0, sizeof(marker->children));
+	marker->parent = NULL;
+}
+
+/*
+ * Calls `callback` in order of their start for all markers that overlap the
+ * bytes from `from` to `to`. Empty markers overlap if they are inside. The
+ * callback must not change the marker set.
+ */
+void
+rope_markers_query(
+		struct RopeMarkers *markers, size_t from, size_t to,
+		rope_marker_callback_t callback, void *userdata) {
+	markers_query(markers->root, 0, from, to, callback, userdata);
+}
+
+void
+rope_markers_clear(struct RopeMarkers *markers) {
+	markers->root = NULL;
+}
+
+void
+rope_markers_cleanup(struct RopeMarkers *markers) {
+	struct RopeMarkers **ptr = &markers->rope->markers;
+	for (; *ptr != markers; ptr = &(*ptr)->next) {
+	}
+	*ptr = markers->next;
+	memset(markers, 0, sizeof(*markers));
+}
+
+size_t
+rope_marker_start(const struct RopeMarker *marker) {
+	return marker->start + marker_offset(marker);
+}
+
+size_t
+rope_marker_end(const struct RopeMarker *marker) {
+	return marker->end + marker_offset(marker);
+}
+
+/*
+ * Moves the markers of all sets attached to `rope` after `delete_size` bytes
+ * at `byte_index` were replaced by `insert_size` bytes.
+ */
+void
+rope_markers_damaged(
+		struct Rope *rope, size_t byte_index, size_t delete_size,
+		size_t insert_size) {
+	for (struct RopeMarkers *m = rope->markers; m != NULL; m = m->next) {
+		markers_damaged(m, byte_index, delete_size, insert_size);
+	}
+}
@@ -14,7 +14,16 @@ rope_node_size(const struct RopeNode *node, enum RopeUnit unit) {
 size_t
 rope_node_depth(const struct RopeNode *node) {
 	if (ROPE_NODE_IS_BRANCH(node)) {
-		return node->bits & ~ROPE_NODE_TYPE_MASK;
+		return node->bits & ROPE_NODE_DEPTH_MASK;
+	} else {
+		return 0;
+	}
+}
+
+size_t
+rope_node_heat(const struct RopeNode *node) {
+	if (ROPE_NODE_IS_BRANCH(node)) {
+		return (node->bits & ROPE_NODE_HEAT_MASK) >> ROPE_NODE_HEAT_SHIFT;
 	} else {
 		return 0;
 	}
@@ -34,13 +34,13 @@ node_insert_unbalanced(
 		struct RopeNode *target, struct RopeNode *node, struct RopePool *pool,
 		enum RopeDirection which) {
 	assert(ROPE_NODE_IS_LEAF(target));
-	assert(ROPE_NODE_IS_LEAF(node));
 
 	int rv = 0;
 	struct RopeNode *new_node = NULL;
 
 	new_node = rope_node_new(pool);
 	if (new_node == NULL) {
+		rv = -ROPE_ERROR_OOM;
 		goto out;
 	}
 
@@ -52,12 +52,12 @@ node_insert_unbalanced(
 	children[which] = node;
 	children[!which] = new_node;
 	rope_node_update_children(target);
-	
-	// Immediately set depth to 1 (both children are leaves with depth 0)
-	// This ensures the node can be safely used in rotations
+
+	// Immediately set the depth so the node can be safely used in rotations.
+	// `node` is at least as deep as the leaf `new_node`.
 	target->bits &= ROPE_NODE_TYPE_MASK;
-	target->bits |= 1;  // depth = 1
-	
+	target->bits |= rope_node_depth(node) + 1;
+
 	new_node = NULL;
 
 out:
@@ -181,6 +181,38 @@ out:
 	return rv;
 }
 
+/*
+ * Splices the tree `node` in next to the leaf `target`. Grapheme clusters
+ * spanning the seams are not stitched, see rope_node_stitch_next.
+ */
+int
+rope_node_insert_tree(
+		struct RopeNode *target, struct RopeNode *node, struct RopePool *pool,
+		enum RopeDirection which) {
+	int rv = 0;
+	if (rope_node_size(target, ROPE_BYTE) == 0) {
+		rope_node_cleanup(target);
+		rope_node_move(target, node);
+		rope_node_update_children(target);
+		rope_pool_recycle(pool, node);
+		rope_node_rebalance_up(target);
+		goto out;
+	}
+
+	rv = node_insert_unbalanced(target, node, pool, which);
+	if (rv < 0) {
+		goto out;
+	}
+	rope_node_rebalance_up(node);
+out:
+	return rv;
+}
+
+int
+rope_node_stitch_next(struct RopeNode *node, struct RopePool *pool) {
+	return merge_next_char_bytes(node, pool);
+}
+
 int
 rope_node_insert_right(
 		struct RopeNode *node, const uint8_t *data, size_t byte_size,
@@ -4,6 +4,7 @@
 #include <rope_node.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void
@@ -14,12 +15,21 @@ node_set_parent(struct RopeNode *node, struct RopeNode *parent) {
 static void
 node_set_depth(struct RopeNode *node, size_t depth) {
 	assert(ROPE_NODE_IS_BRANCH(node));
-	assert(depth <= ROPE_NODE_TYPE_MASK);
+	assert(depth <= ROPE_NODE_DEPTH_MASK);
 
-	node->bits &= ROPE_NODE_TYPE_MASK;
+	node->bits &= ~ROPE_NODE_DEPTH_MASK;
 	node->bits |= depth;
 }
 
+static void
+node_set_heat(struct RopeNode *node, size_t heat) {
+	assert(ROPE_NODE_IS_BRANCH(node));
+
+	heat = CX_MIN(heat, ROPE_NODE_HEAT_MASK >> ROPE_NODE_HEAT_SHIFT);
+	node->bits &= ~ROPE_NODE_HEAT_MASK;
+	node->bits |= (uint64_t)heat << ROPE_NODE_HEAT_SHIFT;
+}
+
 static void
 node_update_depth(struct RopeNode *node) {
 	if (!ROPE_NODE_IS_BRANCH(node)) {
@@ -48,6 +58,7 @@ node_update_sizes(struct RopeNode *node) {
 		dim->dim[unit] =
 				rope_node_size(left, unit) + rope_node_size(right, unit);
 	}
+	node->bits &= ~ROPE_NODE_SUMMARY;
 }
 
 void
@@ -76,6 +87,10 @@ rope_node_move(struct RopeNode *target, struct RopeNode *node) {
 	struct RopeNode *node_parent = rope_node_parent(node);
 	memcpy(target, node, sizeof(struct RopeNode));
 	memset(node, 0, sizeof(struct RopeNode));
+	// Summaries are keyed by the node pointer.
+	if (ROPE_NODE_IS_BRANCH(target)) {
+		target->bits &= ~ROPE_NODE_SUMMARY;
+	}
 	node_set_parent(target, target_parent);
 	node_set_parent(node, node_parent);
 }
@@ -382,46 +397,289 @@ rope_node_balance_up2(struct RopeNode *node) {
 	}
 }
 
-int
-rope_node_chores(struct RopeNode *node, struct RopePool *pool) {
+static void
+node_rebalance(struct RopeNode *node) {
+	for (;;) {
+		struct RopeNode *left = rope_node_left(node);
+		struct RopeNode *right = rope_node_right(node);
+		size_t left_depth = rope_node_depth(left);
+		size_t right_depth = rope_node_depth(right);
+
+		if (left_depth > right_depth + 1) {
+			size_t ll_depth = rope_node_depth(rope_node_left(left));
+			size_t lr_depth = rope_node_depth(rope_node_right(left));
+			if (lr_depth > ll_depth) {
+				rope_node_rotate(left, ROPE_LEFT);
+			}
+			rope_node_rotate(node, ROPE_RIGHT);
+			node_rebalance(rope_node_right(node));
+		} else if (right_depth > left_depth + 1) {
+			size_t rl_depth = rope_node_depth(rope_node_left(right));
+			size_t rr_depth = rope_node_depth(rope_node_right(right));
+			if (rl_depth > rr_depth) {
+				rope_node_rotate(right, ROPE_RIGHT);
+			}
+			rope_node_rotate(node, ROPE_LEFT);
+			node_rebalance(rope_node_left(node));
+		} else {
+			break;
+		}
+	}
+	node_update_depth(node);
+	node_update_sizes(node);
+}
+
+/*
+ * Unlike rope_node_balance_up, this function copes with subtrees whose depth
+ * changed by more than one level, e.g. after a subtree has been compacted
+ * into a single leaf.
+ */
+void
+rope_node_rebalance_up(struct RopeNode *node) {
+	while ((node = rope_node_parent(node))) {
+		node_rebalance(node);
+	}
+}
+
+void
+rope_node_touch(struct RopeNode *node) {
+	while ((node = rope_node_parent(node))) {
+		node_set_heat(node, rope_node_heat(node) + 1);
+	}
+}
+
+static bool
+node_has_uniform_tags(struct RopeNode *node) {
+	struct RopeNode *leaf = rope_node_first(node);
+	struct RopeNode *last = rope_node_last(node);
+	const uint64_t tags = rope_node_tags(leaf);
+
+	while (leaf != last) {
+		leaf = rope_node_next(leaf);
+		if (rope_node_tags(leaf) != tags) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Replaces the subtree `node` with a single leaf. The ancestors of `node`
+ * are left unbalanced. Returns 1 if the subtree was compacted.
+ */
+static int
+node_compact_subtree(
+		struct RopeNode *node, struct RopePool *pool, size_t max_size) {
 	int rv = 0;
 	if (ROPE_NODE_IS_LEAF(node)) {
 		return 0;
 	}
 
-	const size_t depth = rope_node_depth(node);
-	const size_t byte_size = rope_node_size(node, ROPE_BYTE);
-	// TODO: the threshould should be (1 << depth) * ROPE_NODE_COMPACT_THRESHOLD
-	if (depth << ROPE_NODE_COMPACT_THRESHOLD < byte_size) {
+	size_t byte_size = rope_node_size(node, ROPE_BYTE);
+	if (byte_size > max_size) {
+		return 0;
+	}
+
+	uint8_t *target;
+	struct RopeStr new_value;
+	rv = rope_str_alloc(&new_value, byte_size, &target);
+	if (rv < 0) {
 		goto out;
 	}
 
-	if (byte_size <= ROPE_STR_FAST_SIZE) {
-		rv = rope_node_compact(node, pool);
+	uint64_t tags = 0;
+	struct RopeNode *leaf = rope_node_first(node);
+	struct RopeNode *last = rope_node_last(node);
+	for (;; leaf = rope_node_next(leaf)) {
+		const uint8_t *data = rope_node_value(leaf, &byte_size);
+		memcpy(target, data, byte_size);
+		target += byte_size;
+		tags |= rope_node_tags(leaf);
+		if (leaf == last) {
+			break;
+		}
+	}
+	rope_str_alloc_commit(&new_value, SIZE_MAX);
+
+	rope_node_free(rope_node_left(node), pool);
+	rope_node_free(rope_node_right(node), pool);
+	node->bits = 0;
+	rope_node_set_type(node, ROPE_NODE_LEAF);
+	rope_str_move(&node->data.leaf, &new_value);
+	rope_node_add_tags(node, tags);
+	rv = 1;
+
+out:
+	return rv;
+}
+
+static int
+node_compact(struct RopeNode *node, struct RopePool *pool, size_t max_size) {
+	int rv = node_compact_subtree(node, pool, max_size);
+	if (rv > 0) {
+		rope_node_rebalance_up(node);
+		rv = 0;
+	}
+	return rv;
+}
+
+static int
+node_compress(struct RopeNode *node, struct RopePool *pool) {
+	if (!ROPE_NODE_IS_LEAF(node)) {
+		return 0;
+	}
+	return rope_str_compress(&node->data.leaf, &pool->str_cache);
+}
+
+/*
+ * Runs the chores of the subtree `node` without rebalancing its ancestors,
+ * so the subtrees that are yet to be visited keep their place. Branches
+ * whose subtree changed are rebalanced once their children are done. Sets
+ * `changed` if the depth of the subtree may have changed.
+ */
+static int
+node_chores(struct RopeNode *node, struct RopePool *pool, bool *changed) {
+	int rv = 0;
+	bool children_changed = false;
+	if (ROPE_NODE_IS_LEAF(node)) {
+		return 0;
+	}
+
+	const size_t heat = rope_node_heat(node);
+	const size_t depth = rope_node_depth(node);
+	const size_t byte_size = rope_node_size(node, ROPE_BYTE);
+	node_set_heat(node, heat / 2);
+
+	if (heat == 0 && byte_size <= ROPE_NODE_COLD_LEAF_SIZE &&
+		node_has_uniform_tags(node)) {
+		rv = node_compact_subtree(node, pool, ROPE_NODE_COLD_LEAF_SIZE);
 		if (rv < 0) {
 			goto out;
 		}
-	} else {
-		struct RopeNode *left = rope_node_left(node);
-		struct RopeNode *right = rope_node_right(node);
-		rv = rope_node_chores(left, pool);
+		*changed |= rv > 0;
+		rv = node_compress(node, pool);
+		goto out;
+	}
+
+	// TODO: the threshould should be (1 << depth) * ROPE_NODE_COMPACT_THRESHOLD
+	if (depth << ROPE_NODE_COMPACT_THRESHOLD >= byte_size &&
+		byte_size <= ROPE_STR_FAST_SIZE && node_has_uniform_tags(node)) {
+		rv = node_compact_subtree(node, pool, ROPE_STR_FAST_SIZE);
+		*changed |= rv > 0;
+		rv = CX_MIN(rv, 0);
+		goto out;
+	}
+
+	struct RopeNode *left = rope_node_left(node);
+	struct RopeNode *right = rope_node_right(node);
+	if (heat == 0) {
+		rv = node_compress(left, pool);
 		if (rv < 0) {
 			goto out;
 		}
-		rv = rope_node_chores(right, pool);
+		rv = node_compress(right, pool);
 		if (rv < 0) {
 			goto out;
 		}
 	}
+	rv = node_chores(left, pool, &children_changed);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = node_chores(right, pool, &children_changed);
+	if (rv < 0) {
+		goto out;
+	}
 
 out:
+	if (children_changed) {
+		// Rotations only move subtrees that are done already.
+		node_rebalance(node);
+		*changed = true;
+	}
 	return rv;
 }
 
+/*
+ * Chores adapt the leaf size to the editing pattern: Subtrees that have not
+ * seen edits since the last run are coarsened into leaves of up to
+ * ROPE_NODE_COLD_LEAF_SIZE bytes, while edited subtrees are only compacted
+ * if they fragmented into many tiny leaves. The edit counters decay on each
+ * run, so regions that stop being edited eventually turn cold.
+ *
+ * Leaves of cold subtrees are compressed. Reading them decompresses them
+ * into the small cache of the pool.
+ */
+int
+rope_node_chores(struct RopeNode *node, struct RopePool *pool) {
+	bool changed = false;
+	return node_chores(node, pool, &changed);
+}
+
 int
 rope_node_compact(struct RopeNode *node, struct RopePool *pool) {
-	// No compacting for now
-	(void)node;
-	(void)pool;
-	return 0;
+	return node_compact(node, pool, ROPE_STR_FAST_SIZE);
+}
+
+static struct RopeNode *
+node_build(
+		struct RopeNode **leaves, size_t count, struct RopeNode ***branches) {
+	if (count == 1) {
+		return leaves[0];
+	}
+
+	const size_t left_count = count / 2;
+	struct RopeNode *node = *(*branches)++;
+	struct RopeNode **children = node->data.branch.children;
+	children[ROPE_LEFT] = node_build(leaves, left_count, branches);
+	children[ROPE_RIGHT] =
+			node_build(&leaves[left_count], count - left_count, branches);
+
+	rope_node_set_type(node, ROPE_NODE_BRANCH);
+	rope_node_update_children(node);
+	node_update_depth(node);
+	node_update_sizes(node);
+	return node;
+}
+
+/*
+ * Builds a balanced tree from a sequence of leaves. On failure the leaves
+ * are left untouched.
+ */
+int
+rope_node_build(
+		struct RopeNode **root, struct RopeNode **leaves, size_t count,
+		struct RopePool *pool) {
+	int rv = 0;
+	size_t branch_count = 0;
+	struct RopeNode **branches = NULL;
+
+	if (count == 0) {
+		*root = rope_node_new(pool);
+		return *root == NULL ? -ROPE_ERROR_OOM : 0;
+	}
+
+	branches = calloc(count, sizeof(struct RopeNode *));
+	if (branches == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (; branch_count < count - 1; branch_count++) {
+		branches[branch_count] = rope_node_new(pool);
+		if (branches[branch_count] == NULL) {
+			rv = -ROPE_ERROR_OOM;
+			goto out;
+		}
+	}
+
+	struct RopeNode **next_branch = branches;
+	*root = node_build(leaves, count, &next_branch);
+	(*root)->parent = NULL;
+	branch_count = 0;
+out:
+	for (size_t i = 0; i < branch_count; i++) {
+		rope_pool_recycle(pool, branches[i]);
+	}
+	free(branches);
+	return rv;
 }
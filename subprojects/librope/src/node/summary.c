@@ -0,0 +1,116 @@
+#include <rope_error.h>
+#include <rope_node.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Summary table. Branches keep their soft wrap and word summaries in an open
+ * addressing table of the rope that is keyed by the node pointer, so plain
+ * ropes keep small nodes. ROPE_NODE_SUMMARY in the node bits marks the
+ * entry as current and is cleared whenever the sizes of the branch change,
+ * so entries of changed or recycled nodes are reset on their next lookup.
+ *
+ * Entries are never removed one by one. Recycled nodes are reused by the
+ * pool, so the table doesn't outgrow the peak node count.
+ */
+
+#define SUMMARIES_MIN_CAP 64
+
+static size_t
+summaries_slot(
+		const struct RopeSummaries *summaries, const struct RopeNode *node) {
+	size_t hash = (uintptr_t)node / sizeof(struct RopeNode);
+	hash *= (size_t)UINT64_C(0x9E3779B97F4A7C15);
+	return hash & (summaries->cap - 1);
+}
+
+static struct RopeSummary *
+summaries_find(
+		const struct RopeSummaries *summaries, const struct RopeNode *node) {
+	size_t slot = summaries_slot(summaries, node);
+	while (summaries->entries[slot].node != NULL &&
+		   summaries->entries[slot].node != node) {
+		slot = (slot + 1) & (summaries->cap - 1);
+	}
+	return &summaries->entries[slot];
+}
+
+static int
+summaries_grow(struct RopeSummaries *summaries) {
+	int rv = 0;
+	struct RopeSummaries grown = {
+			.cap = CX_MAX(summaries->cap * 2, SUMMARIES_MIN_CAP),
+			.count = summaries->count,
+	};
+
+	grown.entries = calloc(grown.cap, sizeof(struct RopeSummary));
+	if (grown.entries == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (size_t i = 0; i < summaries->cap; i++) {
+		const struct RopeSummary *entry = &summaries->entries[i];
+		if (entry->node != NULL) {
+			*summaries_find(&grown, entry->node) = *entry;
+		}
+	}
+	free(summaries->entries);
+	*summaries = grown;
+
+out:
+	return rv;
+}
+
+/*
+ * Returns the current summary entry of the branch `node`, or NULL if
+ * `summaries` is NULL or the entry can't be allocated.
+ */
+struct RopeSummary *
+rope_node_summary(struct RopeNode *node, struct RopeSummaries *summaries) {
+	if (summaries == NULL) {
+		return NULL;
+	}
+	if (summaries->count * 4 >= summaries->cap * 3 &&
+		summaries_grow(summaries) < 0) {
+		return NULL;
+	}
+
+	struct RopeSummary *entry = summaries_find(summaries, node);
+	if (entry->node == NULL) {
+		summaries->count++;
+	} else if (node->bits & ROPE_NODE_SUMMARY) {
+		return entry;
+	}
+	*entry = (struct RopeSummary){.node = node};
+	node->bits |= ROPE_NODE_SUMMARY;
+	return entry;
+}
+
+/*
+ * Returns the summary entry of `node` without validating it.
+ */
+const struct RopeSummary *
+rope_summaries_find(
+		const struct RopeSummaries *summaries, const struct RopeNode *node) {
+	if (summaries->cap == 0) {
+		return NULL;
+	}
+	const struct RopeSummary *entry = summaries_find(summaries, node);
+	return entry->node == NULL ? NULL : entry;
+}
+
+/*
+ * Drops the wrap summaries, e.g. when the tab width changes.
+ */
+void
+rope_summaries_wrap_invalidate(struct RopeSummaries *summaries) {
+	for (size_t i = 0; i < summaries->cap; i++) {
+		summaries->entries[i].wrap_width = 0;
+	}
+}
+
+void
+rope_summaries_cleanup(struct RopeSummaries *summaries) {
+	free(summaries->entries);
+	memset(summaries, 0, sizeof(struct RopeSummaries));
+}
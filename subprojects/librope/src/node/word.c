@@ -0,0 +1,224 @@
+#include "rope_node.h"
+#include <ctype.h>
+#include <grapheme.h>
+
+/*
+ * Word index. Words are the segments of UAX #29 word breaking that don't
+ * start with whitespace, so punctuation counts as a word of its own.
+ *
+ * Leaves are segmented on their own, so a word that spans two leaves shows
+ * up as a word start in both. Every summary therefore keeps the classes of
+ * its first and last codepoint, and two summaries are joined by dropping
+ * the word start of the right one if it continues the word on the left.
+ * Branches cache their summary in the summary table like the soft wrap
+ * index and the entry is reset whenever the sizes of the branch change.
+ */
+
+enum WordClass {
+	WORD_NONE,
+	WORD_SPACE,
+	WORD_ALNUM,
+	WORD_OTHER,
+};
+
+static enum WordClass
+word_class(uint_least32_t cp) {
+	switch (cp) {
+	case ' ':
+	case '\t':
+	case '\n':
+	case '\v':
+	case '\f':
+	case '\r':
+	case 0x85:
+	case 0xA0:
+	case 0x2028:
+	case 0x2029:
+	case 0x3000:
+		return WORD_SPACE;
+	}
+	if (cp >= 0x2000 && cp <= 0x200A) {
+		return WORD_SPACE;
+	} else if (cp < 0x80) {
+		return isalnum(cp) || cp == '_' ? WORD_ALNUM : WORD_OTHER;
+	} else if (
+			(cp >= 0x2E80 && cp <= 0x9FFF) || (cp >= 0xF900 && cp <= 0xFAFF) ||
+			cp >= 0x20000) {
+		// Ideographs are words of their own.
+		return WORD_OTHER;
+	}
+	return WORD_ALNUM;
+}
+
+static enum WordClass
+word_class_at(const uint8_t *data, size_t size) {
+	uint_least32_t cp = GRAPHEME_INVALID_CODEPOINT;
+	grapheme_decode_utf8((const char *)data, size, &cp);
+	return word_class(cp);
+}
+
+/*
+ * Returns the size of the segment at `pos` and whether it starts a word.
+ */
+static size_t
+word_segment(const uint8_t *data, size_t size, size_t pos, bool *is_start) {
+	*is_start = word_class_at(&data[pos], size - pos) != WORD_SPACE;
+	return grapheme_next_word_break_utf8(
+			(const char *)&data[pos], size - pos);
+}
+
+/*
+ * Leaves that fail to decompress are treated as empty.
+ */
+static const uint8_t *
+word_data(const struct RopeStr *str, size_t *size) {
+	const uint8_t *data = rope_str_data(str, size);
+	if (data == NULL) {
+		*size = 0;
+	}
+	return data;
+}
+
+static bool
+words_join(enum WordClass tail, enum WordClass head) {
+	return tail == WORD_ALNUM && head == WORD_ALNUM;
+}
+
+static void
+words_append(struct RopeWords *words, const struct RopeWords *other) {
+	if (other->head == WORD_NONE) {
+		return;
+	} else if (words->head == WORD_NONE) {
+		*words = *other;
+		return;
+	}
+	words->starts += other->starts - words_join(words->tail, other->head);
+	words->tail = other->tail;
+}
+
+static void
+words_leaf(const struct RopeStr *str, struct RopeWords *words) {
+	size_t size = 0;
+	const uint8_t *data = word_data(str, &size);
+
+	*words = (struct RopeWords){0};
+	if (size == 0) {
+		return;
+	}
+	for (size_t pos = 0; pos < size;) {
+		bool is_start = false;
+		pos += word_segment(data, size, pos, &is_start);
+		words->starts += is_start;
+	}
+
+	size_t last = size - 1;
+	while (last > 0 && size - last < 4 && (data[last] & 0xC0) == 0x80) {
+		last--;
+	}
+	words->head = word_class_at(data, size);
+	words->tail = word_class_at(&data[last], size - last);
+}
+
+void
+rope_node_words(
+		struct RopeNode *node, struct RopeSummaries *summaries,
+		struct RopeWords *words) {
+	if (ROPE_NODE_IS_LEAF(node)) {
+		words_leaf(&node->data.leaf, words);
+		return;
+	}
+	struct RopeSummary *summary = rope_node_summary(node, summaries);
+	if (summary != NULL && summary->has_words) {
+		*words = summary->words;
+		return;
+	}
+
+	struct RopeWords right_words = {0};
+	rope_node_words(rope_node_left(node), summaries, words);
+	rope_node_words(rope_node_right(node), summaries, &right_words);
+	words_append(words, &right_words);
+
+	// Growing the table in the recursion may have moved the entry.
+	summary = rope_node_summary(node, summaries);
+	if (summary != NULL) {
+		summary->words = *words;
+		summary->has_words = true;
+	}
+}
+
+/*
+ * Returns the number of words that start in front of `byte_index`.
+ */
+size_t
+rope_node_byte_to_word(
+		struct RopeNode *node, struct RopeSummaries *summaries,
+		size_t byte_index) {
+	size_t count = 0;
+
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		struct RopeNode *right = rope_node_right(node);
+		const size_t left_size = rope_node_size(left, ROPE_BYTE);
+		if (byte_index <= left_size) {
+			node = left;
+			continue;
+		}
+		struct RopeWords left_words = {0};
+		struct RopeWords right_words = {0};
+		rope_node_words(left, summaries, &left_words);
+		rope_node_words(right, summaries, &right_words);
+		count += left_words.starts;
+		// The continued word is counted again as the first one of `right`.
+		count -= words_join(left_words.tail, right_words.head);
+		byte_index -= left_size;
+		node = right;
+	}
+
+	size_t size = 0;
+	const uint8_t *data = word_data(&node->data.leaf, &size);
+	for (size_t pos = 0; pos < CX_MIN(byte_index, size);) {
+		bool is_start = false;
+		pos += word_segment(data, size, pos, &is_start);
+		count += is_start;
+	}
+	return count;
+}
+
+/*
+ * Returns the start of the word `index`, or the end of `node` if there are
+ * not that many words.
+ */
+size_t
+rope_node_word_to_byte(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t index) {
+	size_t byte_index = 0;
+
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		struct RopeNode *right = rope_node_right(node);
+		struct RopeWords left_words = {0};
+		rope_node_words(left, summaries, &left_words);
+		if (index < left_words.starts) {
+			node = left;
+			continue;
+		}
+		struct RopeWords right_words = {0};
+		rope_node_words(right, summaries, &right_words);
+		index -= left_words.starts;
+		index += words_join(left_words.tail, right_words.head);
+		byte_index += rope_node_size(left, ROPE_BYTE);
+		node = right;
+	}
+
+	size_t size = 0;
+	const uint8_t *data = word_data(&node->data.leaf, &size);
+	for (size_t pos = 0; pos < size;) {
+		bool is_start = false;
+		const size_t segment_size = word_segment(data, size, pos, &is_start);
+		if (is_start && index-- == 0) {
+			return byte_index + pos;
+		}
+		pos += segment_size;
+	}
+	return byte_index + size;
+}
@@ -0,0 +1,202 @@
+#include "rope_node.h"
+#include <assert.h>
+
+/*
+ * Soft wrap index. Every branch caches the RopeWrap summary for the last
+ * wrap width it was queried with in the summary table of the rope. The
+ * entry is reset whenever the sizes of the branch are updated, so an edit
+ * only invalidates the summaries along its path.
+ *
+ * A line takes ceil(cells / width) rows, at least one. Wide characters that
+ * straddle the wrap width are not moved to the next row.
+ */
+
+static size_t
+wrap_line_rows(size_t columns, size_t width) {
+	return columns == 0 ? 1 : (columns + width - 1) / width;
+}
+
+/*
+ * Rows of the lines that are terminated by a newline within `wrap`.
+ */
+static size_t
+wrap_complete_rows(const struct RopeWrap *wrap, size_t lines, size_t width) {
+	if (lines == 0) {
+		return 0;
+	}
+	return wrap_line_rows(wrap->head, width) + wrap->rows;
+}
+
+static void
+wrap_append(
+		struct RopeWrap *wrap, size_t lines, const struct RopeWrap *other,
+		size_t other_lines, size_t width) {
+	if (other_lines == 0) {
+		wrap->tail += other->head;
+		if (lines == 0) {
+			wrap->head = wrap->tail;
+		}
+	} else if (lines == 0) {
+		wrap->head += other->head;
+		wrap->tail = other->tail;
+		wrap->rows = other->rows;
+	} else {
+		wrap->rows += wrap_line_rows(wrap->tail + other->head, width);
+		wrap->rows += other->rows;
+		wrap->tail = other->tail;
+	}
+}
+
+static void
+wrap_append_line(
+		struct RopeWrap *wrap, size_t lines, size_t columns, size_t width) {
+	const struct RopeWrap line = {.head = columns};
+	wrap_append(wrap, lines, &line, 1, width);
+}
+
+static void
+wrap_leaf(
+		const struct RopeStr *str, size_t width, size_t tab_width,
+		struct RopeWrap *wrap) {
+	const size_t lines = rope_str_size(str, ROPE_LINE);
+	size_t byte_index = 0;
+
+	wrap->head = rope_str_line_columns(str, &byte_index, tab_width);
+	wrap->tail = wrap->head;
+	wrap->rows = 0;
+	for (size_t i = 1; i <= lines; i++) {
+		const size_t columns =
+				rope_str_line_columns(str, &byte_index, tab_width);
+		if (i < lines) {
+			wrap->rows += wrap_line_rows(columns, width);
+		} else {
+			wrap->tail = columns;
+		}
+	}
+}
+
+void
+rope_node_wrap(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t width,
+		size_t tab_width, struct RopeWrap *wrap) {
+	assert(width > 0);
+
+	if (ROPE_NODE_IS_LEAF(node)) {
+		wrap_leaf(&node->data.leaf, width, tab_width, wrap);
+		return;
+	}
+	struct RopeSummary *summary = rope_node_summary(node, summaries);
+	if (summary != NULL && summary->wrap_width == width) {
+		*wrap = summary->wrap;
+		return;
+	}
+
+	struct RopeNode *left = rope_node_left(node);
+	struct RopeNode *right = rope_node_right(node);
+	struct RopeWrap right_wrap = {0};
+	rope_node_wrap(left, summaries, width, tab_width, wrap);
+	rope_node_wrap(right, summaries, width, tab_width, &right_wrap);
+	wrap_append(
+			wrap, rope_node_size(left, ROPE_LINE), &right_wrap,
+			rope_node_size(right, ROPE_LINE), width);
+
+	// Growing the table in the recursion may have moved the entry.
+	summary = rope_node_summary(node, summaries);
+	if (summary != NULL) {
+		summary->wrap = *wrap;
+		summary->wrap_width = width;
+	}
+}
+
+size_t
+rope_node_wrap_rows(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t width,
+		size_t tab_width) {
+	struct RopeWrap wrap = {0};
+	rope_node_wrap(node, summaries, width, tab_width, &wrap);
+
+	const size_t lines = rope_node_size(node, ROPE_LINE);
+	return wrap_complete_rows(&wrap, lines, width) +
+			wrap_line_rows(wrap.tail, width);
+}
+
+/*
+ * Returns the first row of `line`.
+ */
+size_t
+rope_node_line_to_row(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t line,
+		size_t width, size_t tab_width) {
+	struct RopeWrap prefix = {0};
+	size_t prefix_lines = 0;
+
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		const size_t left_lines = rope_node_size(left, ROPE_LINE);
+		if (line <= left_lines) {
+			node = left;
+		} else {
+			struct RopeWrap wrap = {0};
+			rope_node_wrap(left, summaries, width, tab_width, &wrap);
+			wrap_append(&prefix, prefix_lines, &wrap, left_lines, width);
+			prefix_lines += left_lines;
+			line -= left_lines;
+			node = rope_node_right(node);
+		}
+	}
+
+	size_t byte_index = 0;
+	for (; line > 0; line--) {
+		const size_t columns = rope_str_line_columns(
+				&node->data.leaf, &byte_index, tab_width);
+		wrap_append_line(&prefix, prefix_lines, columns, width);
+		prefix_lines += 1;
+	}
+	return wrap_complete_rows(&prefix, prefix_lines, width);
+}
+
+/*
+ * Returns the line that contains `row`, or the last line if `row` is past
+ * the end, and stores the first row of that line in `first_row`.
+ */
+size_t
+rope_node_row_to_line(
+		struct RopeNode *node, struct RopeSummaries *summaries, size_t row,
+		size_t width, size_t tab_width, size_t *first_row) {
+	struct RopeWrap prefix = {0};
+	size_t prefix_lines = 0;
+
+	while (ROPE_NODE_IS_BRANCH(node)) {
+		struct RopeNode *left = rope_node_left(node);
+		const size_t left_lines = rope_node_size(left, ROPE_LINE);
+		const size_t lines = prefix_lines + left_lines;
+		struct RopeWrap wrap = prefix;
+		struct RopeWrap left_wrap = {0};
+		rope_node_wrap(left, summaries, width, tab_width, &left_wrap);
+		wrap_append(&wrap, prefix_lines, &left_wrap, left_lines, width);
+
+		if (wrap_complete_rows(&wrap, lines, width) > row) {
+			node = left;
+		} else {
+			prefix = wrap;
+			prefix_lines = lines;
+			node = rope_node_right(node);
+		}
+	}
+
+	const size_t lines = rope_node_size(node, ROPE_LINE);
+	size_t byte_index = 0;
+	for (size_t i = 0; i < lines; i++) {
+		const size_t columns = rope_str_line_columns(
+				&node->data.leaf, &byte_index, tab_width);
+		struct RopeWrap wrap = prefix;
+		wrap_append_line(&wrap, prefix_lines, columns, width);
+		if (wrap_complete_rows(&wrap, prefix_lines + 1, width) > row) {
+			break;
+		}
+		prefix = wrap;
+		prefix_lines += 1;
+	}
+	*first_row = wrap_complete_rows(&prefix, prefix_lines, width);
+	return prefix_lines;
+}
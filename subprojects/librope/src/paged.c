@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include <cextras/macro.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <rope.h>
+#include <rope_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Paged files:
+ *
+ * | page with struct RopeStrMapping |
+ * | file content, mapped read only  |
+ *
+ * Leaves point into the file mapping like they do for snapshots. Pages are
+ * faulted in when a leaf is read, and as they are never written to, the
+ * kernel can drop them again under memory pressure. The file must not be
+ * truncated while it is mapped.
+ *
+ * The dimensions of all leaves are counted once on load, in parallel on
+ * segments of the file. Leaves end behind a newline where possible, so line
+ * navigation never reads leaves that are not touched by the cursor. Pages
+ * are released right after they are counted, so loading a file larger than
+ * the memory doesn't push everything else out.
+ */
+
+#define ROPE_PAGED_LEAF_SIZE ((size_t)64 * 1024)
+#define ROPE_PAGED_SEGMENT_SIZE ((size_t)4 * 1024 * 1024)
+#define ROPE_PAGED_MAX_THREADS 16
+
+struct PagedLeaf {
+	size_t offset;
+	struct RopeDim dim;
+	size_t last_char_size;
+};
+
+struct PagedSegment {
+	const uint8_t *data;
+	size_t page_size;
+	size_t start;
+	size_t end;
+	struct PagedLeaf *leaves;
+	size_t leaf_count;
+	size_t leaf_capacity;
+	int rv;
+};
+
+/*
+ * Returns an offset close to `offset` that doesn't split a codepoint.
+ */
+static size_t
+paged_codepoint_start(const uint8_t *data, size_t size, size_t offset) {
+	for (size_t i = 0; i < 4 && offset < size; i++, offset++) {
+		if ((data[offset] & 0xC0) != 0x80) {
+			break;
+		}
+	}
+	return offset;
+}
+
+/*
+ * Returns the start of the segment that is closest behind `offset`.
+ * Neighbouring segments compute their shared boundary independently.
+ */
+static size_t
+paged_segment_start(const uint8_t *data, size_t size, size_t offset) {
+	const size_t window = CX_MIN(size - offset, ROPE_PAGED_LEAF_SIZE);
+	const uint8_t *newline = memchr(&data[offset], '\n', window);
+	if (newline != NULL) {
+		return newline - data + 1;
+	}
+	return paged_codepoint_start(data, size, offset);
+}
+
+static size_t
+paged_leaf_end(const uint8_t *data, size_t end, size_t offset) {
+	if (end - offset <= ROPE_PAGED_LEAF_SIZE) {
+		return end;
+	}
+	const uint8_t *newline =
+			memrchr(&data[offset], '\n', ROPE_PAGED_LEAF_SIZE);
+	if (newline != NULL) {
+		return newline - data + 1;
+	}
+	return paged_codepoint_start(data, end, offset + ROPE_PAGED_LEAF_SIZE);
+}
+
+static void
+paged_release(const struct PagedSegment *segment, size_t start, size_t end) {
+	start -= start % segment->page_size;
+	end -= end % segment->page_size;
+	if (end > start) {
+		madvise((void *)&segment->data[start], end - start, MADV_DONTNEED);
+	}
+}
+
+static void *
+paged_scan(void *arg) {
+	struct PagedSegment *segment = arg;
+	const uint8_t *data = segment->data;
+
+	for (size_t offset = segment->start; offset < segment->end;) {
+		const size_t end = paged_leaf_end(data, segment->end, offset);
+		if (segment->leaf_count == segment->leaf_capacity) {
+			const size_t capacity = CX_MAX(segment->leaf_capacity * 2, 16);
+			struct PagedLeaf *leaves =
+					reallocarray(segment->leaves, capacity, sizeof(*leaves));
+			if (leaves == NULL) {
+				segment->rv = -ROPE_ERROR_OOM;
+				break;
+			}
+			segment->leaves = leaves;
+			segment->leaf_capacity = capacity;
+		}
+
+		struct PagedLeaf *leaf = &segment->leaves[segment->leaf_count++];
+		leaf->offset = offset;
+		rope_str_measure(
+				&data[offset], end - offset, &leaf->dim, &leaf->last_char_size);
+		paged_release(segment, offset, end);
+		offset = end;
+	}
+	return NULL;
+}
+
+static size_t
+paged_segment_count(size_t size) {
+	const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t count = size / ROPE_PAGED_SEGMENT_SIZE + 1;
+	if (cpu_count > 0) {
+		count = CX_MIN(count, (size_t)cpu_count);
+	}
+	return CX_MIN(count, ROPE_PAGED_MAX_THREADS);
+}
+
+/*
+ * Counts the leaves of all segments. Segments are scanned on their own
+ * threads. If a thread can't be started, its segment is scanned on the
+ * calling thread instead.
+ */
+static int
+paged_scan_segments(struct PagedSegment *segments, size_t count) {
+	pthread_t threads[ROPE_PAGED_MAX_THREADS];
+	bool started[ROPE_PAGED_MAX_THREADS] = {0};
+
+	for (size_t i = 1; i < count; i++) {
+		const int rv =
+				pthread_create(&threads[i], NULL, paged_scan, &segments[i]);
+		started[i] = rv == 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		} else {
+			paged_scan(&segments[i]);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (segments[i].rv < 0) {
+			return segments[i].rv;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Replaces the content of `rope` with the file behind `fd`. The content is
+ * not read into memory, see the description on top of this file.
+ */
+int
+rope_map_fd(struct Rope *rope, int fd) {
+	int rv = 0;
+	struct stat st;
+	uint8_t *map = MAP_FAILED;
+	struct RopeStrMapping *mapping = NULL;
+	struct PagedSegment segments[ROPE_PAGED_MAX_THREADS] = {0};
+	size_t segment_count = 0;
+	struct RopeNode **nodes = NULL;
+	struct RopeNode *root = NULL;
+	size_t node_count = 0;
+
+	if (fstat(fd, &st) < 0) {
+		rv = -errno;
+		goto out;
+	}
+	const size_t size = st.st_size;
+	if (size == 0) {
+		rope_clear(rope);
+		goto out;
+	}
+
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t map_size = 0;
+	if (CX_ADD_OVERFLOW(size, page_size, &map_size)) {
+		rv = -ROPE_ERROR_OOB;
+		goto out;
+	}
+	map = mmap(
+			NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0);
+	if (map == MAP_FAILED) {
+		rv = -errno;
+		goto out;
+	}
+	mapping = (struct RopeStrMapping *)map;
+	mapping->heap.ref_count = ROPE_STR_HEAP_MAPPED;
+	mapping->size = map_size;
+
+	const uint8_t *data = mmap(
+			&map[page_size], size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	if (data == MAP_FAILED) {
+		rv = -errno;
+		goto out;
+	}
+	madvise((void *)data, size, MADV_SEQUENTIAL);
+
+	segment_count = paged_segment_count(size);
+	size_t start = 0;
+	for (size_t i = 0; i < segment_count; i++) {
+		size_t end = size;
+		if (i + 1 < segment_count) {
+			const size_t offset = size / segment_count * (i + 1);
+			end = paged_segment_start(data, size, offset);
+		}
+		segments[i].data = data;
+		segments[i].page_size = page_size;
+		segments[i].start = start;
+		segments[i].end = CX_MAX(start, end);
+		start = segments[i].end;
+	}
+
+	rv = paged_scan_segments(segments, segment_count);
+	madvise((void *)data, size, MADV_NORMAL);
+	if (rv < 0) {
+		goto out;
+	}
+
+	size_t leaf_count = 0;
+	for (size_t i = 0; i < segment_count; i++) {
+		leaf_count += segments[i].leaf_count;
+	}
+	nodes = calloc(leaf_count, sizeof(struct RopeNode *));
+	if (nodes == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	for (size_t i = 0; i < segment_count; i++) {
+		for (size_t j = 0; j < segments[i].leaf_count; j++) {
+			const struct PagedLeaf *leaf = &segments[i].leaves[j];
+			struct RopeNode *node = rope_node_new(rope->pool);
+			if (node == NULL) {
+				rv = -ROPE_ERROR_OOM;
+				goto out;
+			}
+			rope_str_init_measured(
+					&node->data.leaf, &mapping->heap, &data[leaf->offset],
+					&leaf->dim, leaf->last_char_size);
+			nodes[node_count++] = node;
+		}
+	}
+
+	rv = rope_node_build(&root, nodes, node_count, rope->pool);
+	if (rv < 0) {
+		goto out;
+	}
+	node_count = 0;
+
+	rope_clear(rope);
+	rope_node_free(rope->root, rope->pool);
+	rope->root = root;
+out:
+	for (size_t i = 0; i < node_count; i++) {
+		rope_node_free(nodes[i], rope->pool);
+	}
+	free(nodes);
+	for (size_t i = 0; i < segment_count; i++) {
+		free(segments[i].leaves);
+	}
+	if (mapping != NULL) {
+		rope_str_heap_release(&mapping->heap);
+	}
+	return rv;
+}
+
+int
+rope_map_file(struct Rope *rope, const char *path) {
+	int rv = 0;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -errno;
+	}
+	rv = rope_map_fd(rope, fd);
+	close(fd);
+	return rv;
+}
@@ -1,5 +1,6 @@
 #include <rope.h>
 #include <stdbool.h>
+#include <string.h>
 
 //////////////////////////////
 /// struct RopePool
@@ -7,17 +8,27 @@
 int
 rope_pool_init(struct RopePool *pool) {
 	cx_prealloc_pool_init(&pool->pool, sizeof(struct RopeNode));
+	pool->node_count = 0;
+	pool->peak_node_count = 0;
+	memset(&pool->str_cache, 0, sizeof(pool->str_cache));
 
 	return 0;
 }
 
 struct RopeNode *
 rope_pool_get(struct RopePool *pool) {
-	return cx_prealloc_pool_get(&pool->pool);
+	struct RopeNode *node = cx_prealloc_pool_get(&pool->pool);
+	if (node != NULL) {
+		pool->node_count++;
+		pool->peak_node_count =
+				CX_MAX(pool->peak_node_count, pool->node_count);
+	}
+	return node;
 }
 
 void
 rope_pool_recycle(struct RopePool *pool, struct RopeNode *node) {
+	pool->node_count--;
 	cx_prealloc_pool_recycle(&pool->pool, node);
 }
 
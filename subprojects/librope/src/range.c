@@ -174,20 +174,71 @@ out:
 	return rv;
 }
 
+/*
+ * Copies the range by cloning the covered leaves. Heap backed leaves share
+ * their buffer with the source, so the copy is spliced into `target` as one
+ * balanced subtree without touching the content.
+ */
 int
 rope_range_copy_to(
 		struct RopeRange *range, struct RopeCursor *target, uint64_t tags) {
 	int rv = 0;
+	struct RopePool *pool = target->rope->pool;
 	struct RopeIterator it = {0};
 	struct RopeStr str = {0};
+	struct RopeNode **leaves = NULL;
+	struct RopeNode *root = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+
 	rv = rope_iterator_init(&it, range, 0);
+	if (rv < 0) {
+		goto out;
+	}
 	while (rope_iterator_next(&it, &str)) {
-		rv = rope_cursor_insert(target, &str, tags);
-		if (rv < 0) {
+		if (rope_str_size(&str, ROPE_BYTE) == 0) {
+			continue;
+		}
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			struct RopeNode **new_leaves =
+					realloc(leaves, capacity * sizeof(*leaves));
+			if (new_leaves == NULL) {
+				rv = -ROPE_ERROR_OOM;
+				goto out;
+			}
+			leaves = new_leaves;
+		}
+		struct RopeNode *leaf = rope_node_new(pool);
+		if (leaf == NULL) {
+			rv = -ROPE_ERROR_OOM;
 			goto out;
 		}
+		rope_str_move(&leaf->data.leaf, &str);
+		rope_node_set_tags(leaf, tags);
+		leaves[count++] = leaf;
 	}
+
+	if (count == 0) {
+		goto out;
+	} else if (count == 1) {
+		// A single leaf may still fit inline into its neighbour.
+		rope_str_move(&str, &leaves[0]->data.leaf);
+		rv = rope_cursor_insert(target, &str, tags);
+		goto out;
+	}
+
+	rv = rope_node_build(&root, leaves, count, pool);
+	if (rv < 0) {
+		goto out;
+	}
+	count = 0;
+	rv = rope_cursor_insert_node(target, root);
 out:
+	for (size_t i = 0; i < count; i++) {
+		rope_node_free(leaves[i], pool);
+	}
+	free(leaves);
 	rope_str_cleanup(&str);
 	rope_iterator_cleanup(&it);
 	return rv;
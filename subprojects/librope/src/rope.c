@@ -7,6 +7,7 @@ rope_init(struct Rope *rope, struct RopePool *pool) {
 	int rv = 0;
 
 	rope->pool = pool;
+	rope->tab_width = ROPE_TAB_WIDTH;
 
 	rope->root = rope_pool_get(rope->pool);
 	if (rope->root == NULL) {
@@ -36,7 +37,7 @@ rope_append_str(struct Rope *rope, const char *str) {
 int
 rope_append(struct Rope *rope, const uint8_t *data, size_t byte_size) {
 	size_t root_byte_size = rope_node_size(rope->root, ROPE_BYTE);
-	return rope_insert(rope, ROPE_CHAR, root_byte_size, data, byte_size);
+	return rope_insert(rope, ROPE_BYTE, root_byte_size, data, byte_size);
 }
 
 int
@@ -92,6 +93,27 @@ rope_size(struct Rope *rope, enum RopeUnit unit) {
 	return rope_node_size(rope->root, unit);
 }
 
+void
+rope_set_tab_width(struct Rope *rope, size_t tab_width) {
+	if (rope->tab_width != tab_width) {
+		rope->tab_width = tab_width;
+		rope_summaries_wrap_invalidate(&rope->summaries);
+	}
+}
+
+/*
+ * Returns the screen rows of the rope when lines are soft wrapped after
+ * `width` cells. Nothing fits into rows of 0 cells, so there are no rows.
+ */
+size_t
+rope_wrap_rows(struct Rope *rope, size_t width) {
+	if (width == 0) {
+		return 0;
+	}
+	return rope_node_wrap_rows(
+			rope->root, &rope->summaries, width, rope->tab_width);
+}
+
 int
 rope_to_range(struct Rope *rope, struct RopeRange *range) {
 	int rv = 0;
@@ -146,11 +168,10 @@ rope_to_end_cursor(struct Rope *rope, struct RopeCursor *cursor) {
 		goto out;
 	}
 	rv = rope_cursor_move_to(cursor, ROPE_BYTE, byte_size, 0);
+out:
 	if (rv < 0) {
-		goto out;
+		rope_cursor_cleanup(cursor);
 	}
-out:
-	rope_cursor_cleanup(cursor);
 	return rv;
 }
 
@@ -160,6 +181,7 @@ rope_clear(struct Rope *rope) {
 		   rope_cursor_index(rope->last_cursor, ROPE_BYTE, 0) != 0) {
 		rope_cursor_move_to(rope->last_cursor, ROPE_BYTE, 0, 0);
 	}
+	rope_markers_damaged(rope, 0, rope_size(rope, ROPE_BYTE), 0);
 	rope_node_free(rope->root, rope->pool);
 	rope->root = rope_pool_get(rope->pool);
 }
@@ -167,4 +189,5 @@ rope_clear(struct Rope *rope) {
 void
 rope_cleanup(struct Rope *rope) {
 	rope_node_free(rope->root, rope->pool);
+	rope_summaries_cleanup(&rope->summaries);
 }
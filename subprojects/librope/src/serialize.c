@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <rope.h>
+#include <rope_error.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Snapshot format:
+ *
+ * | struct RopeSerialHeader                   |
+ * | struct RopeSerialLeaf[header.leaf_count]  |
+ * | leaf data                                 |
+ *
+ * All integers are stored in host byte order. Leaves carry all of their
+ * dimensions and tags, so a snapshot can be mapped back without running
+ * grapheme segmentation over the content again, large leaves included.
+ * Heap leaves point directly into the mapping.
+ */
+
+#define ROPE_SERIAL_MAGIC "librope"
+#define ROPE_SERIAL_VERSION 3
+#define ROPE_SERIAL_IOV_COUNT 1024
+
+struct RopeSerialHeader {
+	// Used as reference count while the snapshot is mapped.
+	struct RopeStrMapping mapping;
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t leaf_count;
+};
+
+struct RopeSerialLeaf {
+	// Indexed by enum RopeUnit, the byte size included.
+	uint64_t dim[ROPE_UNIT_COUNT];
+	uint64_t last_char_size;
+	uint64_t tags;
+	uint64_t offset;
+};
+
+static int
+serial_writev(int fd, struct iovec *iov, size_t count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, (int)count);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		for (; count > 0 && (size_t)written >= iov->iov_len; iov++, count--) {
+			written -= iov->iov_len;
+		}
+		if (count > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return 0;
+}
+
+int
+rope_serialize(struct Rope *rope, int fd) {
+	int rv = 0;
+	struct RopeSerialHeader header = {
+			.magic = ROPE_SERIAL_MAGIC,
+			.version = ROPE_SERIAL_VERSION,
+	};
+	struct RopeSerialLeaf *leaves = NULL;
+	struct iovec iov[ROPE_SERIAL_IOV_COUNT];
+	size_t iov_count = 0;
+	struct RopeNode *node;
+
+	for (node = rope_node_first(rope->root); node; node = rope_node_next(node)) {
+		if (rope_node_size(node, ROPE_BYTE) != 0) {
+			header.leaf_count++;
+		}
+	}
+
+	leaves = calloc(header.leaf_count, sizeof(struct RopeSerialLeaf));
+	if (leaves == NULL && header.leaf_count != 0) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+
+	uint64_t offset = sizeof(header) + header.leaf_count * sizeof(*leaves);
+	struct RopeSerialLeaf *leaf = leaves;
+	for (node = rope_node_first(rope->root); node; node = rope_node_next(node)) {
+		struct RopeDim dim = {0};
+		size_t last_char_size = 0;
+		if (rope_node_size(node, ROPE_BYTE) == 0) {
+			continue;
+		}
+		rv = rope_str_dim(&node->data.leaf, &dim, &last_char_size);
+		if (rv < 0) {
+			goto out;
+		}
+		for (size_t unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+			leaf->dim[unit] = dim.dim[unit];
+		}
+		leaf->last_char_size = last_char_size;
+		leaf->tags = rope_node_tags(node);
+		leaf->offset = offset;
+		offset += dim.dim[ROPE_BYTE];
+		leaf++;
+	}
+
+	iov[iov_count++] = (struct iovec){&header, sizeof(header)};
+	iov[iov_count++] = (struct iovec){
+			leaves, header.leaf_count * sizeof(struct RopeSerialLeaf)};
+	for (node = rope_node_first(rope->root); node; node = rope_node_next(node)) {
+		size_t byte_size = 0;
+		const uint8_t *data = rope_node_value(node, &byte_size);
+		if (byte_size == 0) {
+			continue;
+		}
+		if (iov_count == ROPE_SERIAL_IOV_COUNT) {
+			rv = serial_writev(fd, iov, iov_count);
+			if (rv < 0) {
+				goto out;
+			}
+			iov_count = 0;
+		}
+		iov[iov_count++] = (struct iovec){(void *)data, byte_size};
+		if (rope_str_is_compressed(&node->data.leaf)) {
+			// Reading the next compressed leaf may reuse its cache slot.
+			rv = serial_writev(fd, iov, iov_count);
+			if (rv < 0) {
+				goto out;
+			}
+			iov_count = 0;
+		}
+	}
+	rv = serial_writev(fd, iov, iov_count);
+out:
+	free(leaves);
+	return rv;
+}
+
+/*
+ * Dimensions are trusted on load, so they are checked to stay in the
+ * bounds their byte size allows. A character takes at most two cells.
+ */
+static int
+serial_check_leaf(const struct RopeSerialLeaf *leaf, size_t map_size) {
+	const uint64_t byte_size = leaf->dim[ROPE_BYTE];
+
+	if (leaf->offset > map_size || byte_size > map_size - leaf->offset) {
+		return -ROPE_ERROR_INVALID_FORMAT;
+	} else if (byte_size == 0 || byte_size > UINT32_MAX) {
+		return -ROPE_ERROR_INVALID_FORMAT;
+	} else if ((leaf->tags >> 63) != 0 || leaf->last_char_size > byte_size) {
+		return -ROPE_ERROR_INVALID_FORMAT;
+	}
+	for (size_t unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+		const uint64_t max = unit == ROPE_COLUMN ? byte_size * 2 : byte_size;
+		if (leaf->dim[unit] > max) {
+			return -ROPE_ERROR_INVALID_FORMAT;
+		}
+	}
+	return 0;
+}
+
+int
+rope_deserialize_fd(struct Rope *rope, int fd) {
+	int rv = 0;
+	struct stat st;
+	struct RopeSerialHeader *header = MAP_FAILED;
+	struct RopeNode **nodes = NULL;
+	struct RopeNode *root = NULL;
+	size_t node_count = 0;
+
+	if (fstat(fd, &st) < 0) {
+		rv = -errno;
+		goto out;
+	}
+	const size_t map_size = st.st_size;
+	if (map_size < sizeof(struct RopeSerialHeader)) {
+		rv = -ROPE_ERROR_INVALID_FORMAT;
+		goto out;
+	}
+
+	// The mapping is private and writable as the header is used to keep
+	// track of references. Pages with content are never written to.
+	header = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (header == MAP_FAILED) {
+		rv = -errno;
+		goto out;
+	}
+	header->mapping.heap.ref_count = ROPE_STR_HEAP_MAPPED;
+	header->mapping.size = map_size;
+
+	const size_t max_leaf_count = (map_size - sizeof(struct RopeSerialHeader)) /
+			sizeof(struct RopeSerialLeaf);
+	if (memcmp(header->magic, ROPE_SERIAL_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != ROPE_SERIAL_VERSION ||
+		header->leaf_count > max_leaf_count) {
+		rv = -ROPE_ERROR_INVALID_FORMAT;
+		goto out;
+	}
+
+	const uint8_t *map = (const uint8_t *)header;
+	const struct RopeSerialLeaf *leaves =
+			(const struct RopeSerialLeaf *)&header[1];
+	nodes = calloc(header->leaf_count, sizeof(struct RopeNode *));
+	if (nodes == NULL && header->leaf_count != 0) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+
+	for (; node_count < header->leaf_count; node_count++) {
+		const struct RopeSerialLeaf *leaf = &leaves[node_count];
+		rv = serial_check_leaf(leaf, map_size);
+		if (rv < 0) {
+			goto out;
+		}
+
+		struct RopeNode *node = rope_node_new(rope->pool);
+		if (node == NULL) {
+			rv = -ROPE_ERROR_OOM;
+			goto out;
+		}
+		struct RopeDim dim = {0};
+		for (size_t unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+			dim.dim[unit] = leaf->dim[unit];
+		}
+		rope_str_init_measured(
+				&node->data.leaf, &header->mapping.heap, &map[leaf->offset],
+				&dim, leaf->last_char_size);
+		rope_node_add_tags(node, leaf->tags);
+		nodes[node_count] = node;
+	}
+
+	rv = rope_node_build(&root, nodes, node_count, rope->pool);
+	if (rv < 0) {
+		goto out;
+	}
+	node_count = 0;
+
+	rope_clear(rope);
+	rope_node_free(rope->root, rope->pool);
+	rope->root = root;
+out:
+	for (size_t i = 0; i < node_count; i++) {
+		rope_node_free(nodes[i], rope->pool);
+	}
+	free(nodes);
+	if (header != MAP_FAILED) {
+		rope_str_heap_release(&header->mapping.heap);
+	}
+	return rv;
+}
+
+int
+rope_deserialize_file(struct Rope *rope, const char *path) {
+	int rv = 0;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -errno;
+	}
+	rv = rope_deserialize_fd(rope, fd);
+	close(fd);
+	return rv;
+}
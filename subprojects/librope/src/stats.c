@@ -0,0 +1,75 @@
+#include <rope.h>
+#include <string.h>
+
+/*
+ * Returns the histogram bucket of a leaf of `byte_size` bytes. Buckets
+ * double in size, starting with leaves below 16 bytes.
+ */
+static size_t
+stats_bucket(size_t byte_size) {
+	size_t bucket = 0;
+	for (byte_size >>= 4; byte_size > 0 && bucket < ROPE_STATS_BUCKETS - 1;
+		 byte_size >>= 1) {
+		bucket++;
+	}
+	return bucket;
+}
+
+static void
+stats_leaf(const struct RopeStr *str, struct RopeStats *stats) {
+	const size_t byte_size = rope_str_size(str, ROPE_BYTE);
+
+	stats->leaf_count++;
+	stats->leaf_histogram[stats_bucket(byte_size)]++;
+	stats->slow_count += rope_str_is_slow(str);
+	if (rope_str_is_shared(str)) {
+		stats->shared_bytes += byte_size;
+	}
+
+	switch (rope_str_type(str)) {
+	case ROPE_STR_TYPE_INLINE:
+		stats->inline_bytes += byte_size;
+		break;
+	case ROPE_STR_TYPE_WRAPPED:
+		stats->wrapped_bytes += byte_size;
+		break;
+	case ROPE_STR_TYPE_HEAP:
+		stats->heap_bytes += byte_size;
+		break;
+	case ROPE_STR_TYPE_MAPPED:
+		stats->mapped_bytes += byte_size;
+		break;
+	case ROPE_STR_TYPE_COMPRESSED:
+		stats->compressed_bytes += byte_size;
+		stats->compressed_size +=
+				((const struct RopeStrCompressed *)str->data.heap.str)->size;
+		break;
+	}
+}
+
+static void
+stats_node(const struct RopeNode *node, struct RopeStats *stats) {
+	if (ROPE_NODE_IS_LEAF(node)) {
+		stats_leaf(&node->data.leaf, stats);
+		return;
+	}
+	stats->branch_count++;
+	stats_node(node->data.branch.children[ROPE_LEFT], stats);
+	stats_node(node->data.branch.children[ROPE_RIGHT], stats);
+}
+
+/*
+ * Collects memory statistics of `rope`. This walks the whole tree, so it
+ * is meant for introspection, not for the hot path.
+ */
+void
+rope_stats(struct Rope *rope, struct RopeStats *stats) {
+	memset(stats, 0, sizeof(*stats));
+
+	stats->depth = rope_node_depth(rope->root);
+	stats->byte_count = rope_size(rope, ROPE_BYTE);
+	stats_node(rope->root, stats);
+	for (struct RopeCursor *c = rope->last_cursor; c != NULL; c = c->prev) {
+		stats->cursor_count++;
+	}
+}
@@ -11,11 +11,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 static void str_process(
 		struct RopeStr *str, struct RopeDim *dim, size_t *last_char_index,
 		bool fast_break, const uint8_t *data, size_t byte_size);
 static bool str_is_slow(const struct RopeStr *str);
+static bool str_has_slow_dim(const struct RopeStr *str);
 
 #define ROPE_DIM_ALL \
 	*((struct RopeDim *)memset( \
@@ -32,15 +34,24 @@ static bool str_is_slow(const struct RopeStr *str);
 		return (str->dim >> (offset)) & ROPE_STR_MASK; \
 	}
 #define GET_SET(name, upper, offset) \
-	GET_SET_EXTRA(name, offset, { \
-		struct RopeDim dim = ROPE_DIM_ALL; \
-		size_t byte_size = 0; \
-		const uint8_t *data = rope_str_data(str, &byte_size); \
-		str_process(NULL, &dim, NULL, false, data, byte_size); \
-		return dim.dim[ROPE_##upper]; \
-	})
+	GET_SET_EXTRA(name, offset, { return str_slow_size(str, ROPE_##upper); })
+
+static size_t
+str_slow_size(const struct RopeStr *str, enum RopeUnit unit) {
+	if (str_has_slow_dim(str)) {
+		return str->data.heap.slow_dim[unit];
+	}
+	struct RopeDim dim = ROPE_DIM_ALL;
+	size_t byte_size = 0;
+	const uint8_t *data = rope_str_data(str, &byte_size);
+	str_process(NULL, &dim, NULL, false, data, byte_size);
+	return dim.dim[unit];
+}
 
 GET_SET_EXTRA(last_char_size, 55, {
+	if (str_has_slow_dim(str)) {
+		return str->data.heap.slow_last_char_size;
+	}
 	size_t last_char_size = 0;
 	size_t byte_size = 0;
 	const uint8_t *data = rope_str_data(str, &byte_size);
@@ -53,6 +64,88 @@ GET_SET(codepoints, CP, 22)
 GET_SET(lines, LINE, 33)
 GET_SET(utf16_cps, UTF16, 44)
 
+static size_t
+str_columns(const struct RopeStr *str) {
+	if (str_is_slow(str)) {
+		return str_slow_size(str, ROPE_COLUMN);
+	}
+	return str->columns;
+}
+
+static size_t
+str_tabs(const struct RopeStr *str) {
+	if (str_is_slow(str)) {
+		return str_slow_size(str, ROPE_TAB);
+	}
+	return str->tabs;
+}
+
+/*
+ * Codepoints that take two terminal cells, East Asian Wide and Fullwidth.
+ */
+static const struct {
+	uint32_t first;
+	uint32_t last;
+} str_wide_ranges[] = {
+		{0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},
+		{0x23E9, 0x23EC},   {0x23F0, 0x23F0},   {0x23F3, 0x23F3},
+		{0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},
+		{0x267F, 0x267F},   {0x2693, 0x2693},   {0x26A1, 0x26A1},
+		{0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+		{0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},
+		{0x26F2, 0x26F3},   {0x26F5, 0x26F5},   {0x26FA, 0x26FA},
+		{0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},
+		{0x2728, 0x2728},   {0x274C, 0x274C},   {0x274E, 0x274E},
+		{0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+		{0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},
+		{0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x2E80, 0x303E},
+		{0x3041, 0x33FF},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},
+		{0xA000, 0xA4CF},   {0xA960, 0xA97F},   {0xAC00, 0xD7A3},
+		{0xF900, 0xFAFF},   {0xFE10, 0xFE19},   {0xFE30, 0xFE6F},
+		{0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},   {0x16FE0, 0x16FE4},
+		{0x17000, 0x18CFF}, {0x1AFF0, 0x1B2FF}, {0x1F004, 0x1F004},
+		{0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+		{0x1F200, 0x1F202}, {0x1F210, 0x1F23B}, {0x1F240, 0x1F248},
+		{0x1F250, 0x1F251}, {0x1F260, 0x1F265}, {0x1F300, 0x1F320},
+		{0x1F32D, 0x1F335}, {0x1F337, 0x1F37C}, {0x1F37E, 0x1F393},
+		{0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3}, {0x1F3E0, 0x1F3F0},
+		{0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E}, {0x1F440, 0x1F440},
+		{0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E},
+		{0x1F550, 0x1F567}, {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596},
+		{0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5},
+		{0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7},
+		{0x1F6DC, 0x1F6DF}, {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC},
+		{0x1F7E0, 0x1F7EB}, {0x1F7F0, 0x1F7F0}, {0x1F90C, 0x1F93A},
+		{0x1F93C, 0x1F945}, {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAFF},
+		{0x20000, 0x2FFFD}, {0x30000, 0x3FFFD},
+};
+
+/*
+ * Cells taken by a grapheme cluster starting with `cp`.
+ */
+static size_t
+str_cp_columns(uint_least32_t cp) {
+	if (cp < 0x20 || (cp >= 0x7F && cp < 0xA0)) {
+		return 0;
+	} else if (cp < str_wide_ranges[0].first) {
+		return 1;
+	}
+
+	size_t low = 0;
+	size_t high = sizeof(str_wide_ranges) / sizeof(str_wide_ranges[0]);
+	while (low < high) {
+		const size_t mid = low + (high - low) / 2;
+		if (cp > str_wide_ranges[mid].last) {
+			low = mid + 1;
+		} else if (cp < str_wide_ranges[mid].first) {
+			high = mid;
+		} else {
+			return 2;
+		}
+	}
+	return 1;
+}
+
 static struct RopeDim
 str_unit_to_limits(enum RopeUnit unit, size_t index) {
 	struct RopeDim limits = ROPE_DIM_ALL;
@@ -70,25 +163,114 @@ str_is_wrapped(const struct RopeStr *str) {
 	return !str_is_inline(str) && str->data.heap.str == NULL;
 }
 
+static bool
+str_is_compressed(const struct RopeStr *str) {
+	return !str_is_inline(str) && str->data.heap.data == NULL;
+}
+
 static bool
 str_is_slow(const struct RopeStr *str) {
 	return (str->dim & ~ROPE_STR_SLOW_MASK) == ~ROPE_STR_SLOW_MASK;
 }
 
+// Slow strings are always larger than ROPE_STR_INLINE_SIZE, so the heap
+// variant is active and the spare space can hold their dimensions.
+static bool
+str_has_slow_dim(const struct RopeStr *str) {
+	const size_t byte_size = str->dim & ROPE_STR_SLOW_MASK;
+	return byte_size <= UINT32_MAX &&
+			str->data.heap.slow_dim[ROPE_BYTE] == byte_size;
+}
+
 static uint8_t *
 str_heap_data(struct RopeStrHeap *heap) {
 	return (uint8_t *)&heap[1];
 }
 
+static void
+str_cache_drop(const struct RopeStrCompressed *compressed) {
+	struct RopeStrCache *cache = compressed->cache;
+	for (size_t i = 0; i < ROPE_STR_CACHE_SLOTS; i++) {
+		if (cache->keys[i] == compressed) {
+			cache->keys[i] = NULL;
+			cache->used[i] = 0;
+		}
+	}
+}
+
+/*
+ * Returns the data of the compressed string `str` from the cache. A miss
+ * decompresses it into the least recently read slot.
+ */
+static const uint8_t *
+str_compressed_data(const struct RopeStr *str) {
+	const struct RopeStrCompressed *compressed =
+			(const struct RopeStrCompressed *)str->data.heap.str;
+	struct RopeStrCache *cache = compressed->cache;
+	size_t slot = 0;
+
+	for (size_t i = 0; i < ROPE_STR_CACHE_SLOTS; i++) {
+		if (cache->keys[i] == compressed) {
+			slot = i;
+			goto out;
+		} else if (cache->used[i] < cache->used[slot]) {
+			slot = i;
+		}
+	}
+	int rv = rope_lz_decompress(
+			(const uint8_t *)&compressed[1], compressed->size,
+			cache->data[slot], str_bytes(str));
+	assert(rv == 0);
+	cache->keys[slot] = compressed;
+out:
+	cache->used[slot] = ++cache->clock;
+	return cache->data[slot];
+}
+
 static void
 str_heap_release(struct RopeStrHeap *heap_str, uint8_t *data) {
 	if (heap_str == NULL) {
 		free(data);
-	} else if (heap_str->ref_count-- == 0) {
+	} else if ((heap_str->ref_count & ROPE_STR_HEAP_COUNT_MASK) != 0) {
+		heap_str->ref_count--;
+	} else if (heap_str->ref_count & ROPE_STR_HEAP_MAPPED) {
+		struct RopeStrMapping *mapping = (struct RopeStrMapping *)heap_str;
+		munmap(mapping, mapping->size);
+	} else if (data == NULL) {
+		// Only compressed strings have no data pointer.
+		str_cache_drop((struct RopeStrCompressed *)heap_str);
+		free(heap_str);
+	} else {
 		free(heap_str);
 	}
 }
 
+/*
+ * Replaces the compressed data of `str` with a private decompressed copy
+ * before it is changed. The copy stays until chores compress the string
+ * again.
+ */
+static int
+str_decompress(struct RopeStr *str) {
+	int rv = 0;
+	const size_t byte_size = str_bytes(str);
+	const uint8_t *data = str_compressed_data(str);
+
+	struct RopeStrHeap *heap = malloc(sizeof(struct RopeStrHeap) + byte_size);
+	if (heap == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	heap->ref_count = 0;
+	memcpy(str_heap_data(heap), data, byte_size);
+
+	str_heap_release(str->data.heap.str, NULL);
+	str->data.heap.str = heap;
+	str->data.heap.data = str_heap_data(heap);
+out:
+	return rv;
+}
+
 static void
 str_retain(const struct RopeStr *str) {
 	if (!str_is_inline(str)) {
@@ -105,7 +287,7 @@ str_try_inline(struct RopeStr *str, size_t byte_size) {
 		old_byte_size > ROPE_STR_INLINE_SIZE) {
 		struct RopeStrHeap *heap_str = str->data.heap.str;
 		uint8_t *heap_data = str->data.heap.data;
-		memcpy(str->data.inplace, heap_data, byte_size);
+		memcpy(str->data.inplace, data, byte_size);
 		str_heap_release(heap_str, heap_data);
 		data = str->data.inplace;
 	}
@@ -127,6 +309,30 @@ str_process_limit(const struct RopeDim *result, const struct RopeDim *limit) {
 	return false;
 }
 
+static void
+str_store_dim(
+		struct RopeStr *str, const struct RopeDim *dim, size_t last_char_size,
+		size_t byte_size) {
+	if (byte_size > ROPE_STR_FAST_SIZE || last_char_size >= 512) {
+		str->dim = ~ROPE_STR_SLOW_MASK | byte_size;
+		if (dim->dim[ROPE_BYTE] == byte_size && byte_size <= UINT32_MAX) {
+			for (size_t unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+				str->data.heap.slow_dim[unit] = dim->dim[unit];
+			}
+			str->data.heap.slow_last_char_size = last_char_size;
+		}
+	} else {
+		str_set_bytes(str, dim->dim[ROPE_BYTE]);
+		str_set_chars(str, dim->dim[ROPE_CHAR]);
+		str_set_codepoints(str, dim->dim[ROPE_CP]);
+		str_set_lines(str, dim->dim[ROPE_LINE]);
+		str_set_utf16_cps(str, dim->dim[ROPE_UTF16]);
+		str_set_last_char_size(str, last_char_size);
+		str->columns = dim->dim[ROPE_COLUMN];
+		str->tabs = dim->dim[ROPE_TAB];
+	}
+}
+
 static void
 str_process(
 		struct RopeStr *str, struct RopeDim *dim, size_t *last_char_size,
@@ -157,6 +363,7 @@ str_process(
 				last_char_start = pos;
 			}
 			result.dim[ROPE_CHAR] += 1;
+			result.dim[ROPE_COLUMN] += str_cp_columns(cp);
 		}
 
 		pos += cp_size;
@@ -168,6 +375,7 @@ str_process(
 		} else {
 			result.dim[ROPE_UTF16] += cp >= 0x10000 ? 2 : 1;
 			result.dim[ROPE_LINE] += cp == '\n' ? 1 : 0;
+			result.dim[ROPE_TAB] += cp == '\t' ? 1 : 0;
 		}
 		last_cp = cp;
 	}
@@ -184,16 +392,7 @@ str_process(
 		*last_char_size = last_char_byte_size;
 	}
 	if (str != NULL) {
-		if (byte_size > ROPE_STR_FAST_SIZE || last_char_byte_size >= 512) {
-			str->dim = ~ROPE_STR_SLOW_MASK | byte_size;
-		} else {
-			str_set_bytes(str, result.dim[ROPE_BYTE]);
-			str_set_chars(str, result.dim[ROPE_CHAR]);
-			str_set_codepoints(str, result.dim[ROPE_CP]);
-			str_set_lines(str, result.dim[ROPE_LINE]);
-			str_set_utf16_cps(str, result.dim[ROPE_UTF16]);
-			str_set_last_char_size(str, last_char_byte_size);
-		}
+		str_store_dim(str, &result, last_char_byte_size, byte_size);
 	}
 }
 
@@ -221,6 +420,65 @@ rope_str_wrap(struct RopeStr *str, uint8_t *data, size_t byte_size) {
 	str_try_inline(str, byte_size);
 }
 
+/*
+ * Counts the dimensions of `data` without touching any string, so it can
+ * run on several threads at once.
+ */
+void
+rope_str_measure(
+		const uint8_t *data, size_t byte_size, struct RopeDim *dim,
+		size_t *last_char_size) {
+	*dim = ROPE_DIM_ALL;
+	str_process(NULL, dim, last_char_size, false, data, byte_size);
+}
+
+/*
+ * Returns the dimensions of `str` like rope_str_measure() does. Only slow
+ * strings without cached dimensions are scanned.
+ */
+int
+rope_str_dim(
+		const struct RopeStr *str, struct RopeDim *dim,
+		size_t *last_char_size) {
+	if (str_is_slow(str) && !str_has_slow_dim(str)) {
+		size_t byte_size = 0;
+		const uint8_t *data = rope_str_data(str, &byte_size);
+		rope_str_measure(data, byte_size, dim, last_char_size);
+		return 0;
+	}
+	for (size_t unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+		dim->dim[unit] = rope_str_size(str, unit);
+	}
+	*last_char_size = str_last_char_size(str);
+	return 0;
+}
+
+/*
+ * Initializes a string with data that lives in a shared mapping, using the
+ * dimensions that rope_str_measure() returned for it.
+ */
+void
+rope_str_init_measured(
+		struct RopeStr *str, struct RopeStrHeap *heap, const uint8_t *data,
+		const struct RopeDim *dim, size_t last_char_size) {
+	const size_t byte_size = dim->dim[ROPE_BYTE];
+	memset(str, 0, sizeof(struct RopeStr));
+	str_store_dim(str, dim, last_char_size, byte_size);
+
+	if (byte_size <= ROPE_STR_INLINE_SIZE) {
+		memcpy(str->data.inplace, data, byte_size);
+	} else {
+		str->data.heap.str = heap;
+		str->data.heap.data = (uint8_t *)data;
+		str_retain(str);
+	}
+}
+
+void
+rope_str_heap_release(struct RopeStrHeap *heap) {
+	str_heap_release(heap, NULL);
+}
+
 int
 rope_str_alloc(struct RopeStr *str, size_t byte_size, uint8_t **buffer) {
 	int rv = 0;
@@ -282,6 +540,10 @@ rope_str_clone_trim(
 	if (rv != 0) {
 		goto out;
 	}
+	if (offset == 0 && size >= rope_str_size(src, unit)) {
+		// The clone covers the whole string and keeps its dimensions.
+		return 0;
+	}
 	rv = rope_str_trim(str, unit, offset, size);
 	if (rv != 0) {
 		goto out;
@@ -301,6 +563,12 @@ rope_str_trim(
 	} else {
 		byte_end = rope_str_unit_to_byte(str, unit, offset + size);
 	}
+	if (str_is_compressed(str)) {
+		int rv = str_decompress(str);
+		if (rv < 0) {
+			return rv;
+		}
+	}
 	const size_t byte_offset = rope_str_unit_to_byte(str, unit, offset);
 	const size_t byte_size = byte_end - byte_offset;
 
@@ -433,6 +701,13 @@ rope_str_split(
 		struct RopeStr *str, struct RopeStr *new_str, enum RopeUnit unit,
 		size_t index) {
 	int rv = 0;
+	if (str_is_compressed(str)) {
+		// Decompress once instead of in both halves.
+		rv = str_decompress(str);
+		if (rv < 0) {
+			goto out;
+		}
+	}
 	if (index == rope_str_size(str, unit)) {
 		rv = rope_str_init(new_str, (const uint8_t *)"", 0);
 		if (rv < 0) {
@@ -470,6 +745,10 @@ out:
 	return rv;
 }
 
+/*
+ * Returns the data of `str`. Compressed strings are read from the cache of
+ * their pool, see struct RopeStrCache for how long their data stays valid.
+ */
 const uint8_t *
 rope_str_data(const struct RopeStr *str, size_t *byte_count) {
 	if (byte_count != NULL) {
@@ -477,9 +756,10 @@ rope_str_data(const struct RopeStr *str, size_t *byte_count) {
 	}
 	if (str_is_inline(str)) {
 		return str->data.inplace;
-	} else {
-		return str->data.heap.data;
+	} else if (str_is_compressed(str)) {
+		return str_compressed_data(str);
 	}
+	return str->data.heap.data;
 }
 
 void
@@ -493,6 +773,105 @@ rope_str_cleanup(struct RopeStr *str) {
 	memset(str, 0, sizeof(struct RopeStr));
 }
 
+/*
+ * Compresses the data of a heap string of up to ROPE_NODE_COLD_LEAF_SIZE
+ * bytes if that saves at least a quarter of its size. A shared heap is freed
+ * once all strings that point into it are compressed. Mapped strings are
+ * left alone, the kernel can already drop their pages. The dimensions are
+ * kept, so the data is only decompressed into `cache` when it is read. The
+ * string must be released before `cache`.
+ */
+int
+rope_str_compress(struct RopeStr *str, struct RopeStrCache *cache) {
+	int rv = 0;
+	if (str_is_inline(str) || str_is_wrapped(str) || str_is_compressed(str) ||
+		str->data.heap.str->ref_count & ROPE_STR_HEAP_MAPPED) {
+		goto out;
+	}
+
+	size_t byte_size = 0;
+	const uint8_t *data = rope_str_data(str, &byte_size);
+	if (byte_size > ROPE_NODE_COLD_LEAF_SIZE) {
+		goto out;
+	}
+	const size_t capacity = byte_size - byte_size / 4;
+	struct RopeStrCompressed *compressed =
+			malloc(sizeof(struct RopeStrCompressed) + capacity);
+	if (compressed == NULL) {
+		rv = -ROPE_ERROR_OOM;
+		goto out;
+	}
+	const size_t size = rope_lz_compress(
+			data, byte_size, (uint8_t *)&compressed[1], capacity);
+	if (size == 0) {
+		free(compressed);
+		goto out;
+	}
+	struct RopeStrCompressed *shrunk =
+			realloc(compressed, sizeof(struct RopeStrCompressed) + size);
+	if (shrunk != NULL) {
+		compressed = shrunk;
+	}
+	compressed->heap.ref_count = 0;
+	compressed->size = size;
+	compressed->cache = cache;
+
+	str_heap_release(str->data.heap.str, str->data.heap.data);
+	str->data.heap.str = &compressed->heap;
+	str->data.heap.data = NULL;
+out:
+	return rv;
+}
+
+/*
+ * Returns true if both strings are known to hold the same bytes without
+ * reading their data, i.e. they point to the same bytes of the same heap.
+ */
+bool
+rope_str_is_same(const struct RopeStr *a, const struct RopeStr *b) {
+	if (str_bytes(a) != str_bytes(b)) {
+		return false;
+	} else if (str_is_inline(a)) {
+		return memcmp(a->data.inplace, b->data.inplace, str_bytes(a)) == 0;
+	} else {
+		return a->data.heap.str == b->data.heap.str &&
+				a->data.heap.data == b->data.heap.data;
+	}
+}
+
+bool
+rope_str_is_compressed(const struct RopeStr *str) {
+	return str_is_compressed(str);
+}
+
+enum RopeStrType
+rope_str_type(const struct RopeStr *str) {
+	if (str_is_inline(str)) {
+		return ROPE_STR_TYPE_INLINE;
+	} else if (str_is_wrapped(str)) {
+		return ROPE_STR_TYPE_WRAPPED;
+	} else if (str_is_compressed(str)) {
+		return ROPE_STR_TYPE_COMPRESSED;
+	} else if (str->data.heap.str->ref_count & ROPE_STR_HEAP_MAPPED) {
+		return ROPE_STR_TYPE_MAPPED;
+	}
+	return ROPE_STR_TYPE_HEAP;
+}
+
+/*
+ * Returns true if other strings reference the same heap.
+ */
+bool
+rope_str_is_shared(const struct RopeStr *str) {
+	return !str_is_inline(str) && str->data.heap.str != NULL &&
+			(str->data.heap.str->ref_count & ROPE_STR_HEAP_COUNT_MASK) != 0;
+}
+
+bool
+rope_str_is_slow(const struct RopeStr *str) {
+	return str_is_slow(str);
+}
+
 size_t
 rope_str_size(const struct RopeStr *str, enum RopeUnit unit) {
 	switch (unit) {
@@ -506,6 +885,10 @@ rope_str_size(const struct RopeStr *str, enum RopeUnit unit) {
 		return str_lines(str);
 	case ROPE_UTF16:
 		return str_utf16_cps(str);
+	case ROPE_COLUMN:
+		return str_columns(str);
+	case ROPE_TAB:
+		return str_tabs(str);
 	default:
 		ROPE_UNREACHABLE();
 	}
@@ -526,6 +909,72 @@ rope_str_unit_to_byte(
 	return limits.dim[ROPE_BYTE];
 }
 
+/*
+ * Returns the byte index of the first grapheme cluster that would end past
+ * `column`, counting tabs as `tab_width` cells.
+ */
+size_t
+rope_str_column_to_byte(
+		const struct RopeStr *str, size_t column, size_t tab_width) {
+	size_t byte_size = 0;
+	const uint8_t *data = rope_str_data(str, &byte_size);
+	uint_least16_t state = 0;
+	uint_least32_t last_cp = GRAPHEME_INVALID_CODEPOINT;
+	size_t columns = 0;
+	size_t pos = 0;
+
+	while (pos < byte_size) {
+		uint_least32_t cp;
+		size_t cp_size = grapheme_decode_utf8(
+				(const char *)&data[pos], byte_size - pos, &cp);
+
+		if (grapheme_is_character_break(last_cp, cp, &state)) {
+			const size_t width = cp == '\t' ? tab_width : str_cp_columns(cp);
+			if (columns + width > column) {
+				break;
+			}
+			columns += width;
+		}
+
+		pos += cp_size;
+		last_cp = cp;
+	}
+
+	return CX_MIN(byte_size, pos);
+}
+
+/*
+ * Returns the cells from `*byte_index` up to the next newline, counting tabs
+ * as `tab_width` cells, and moves `*byte_index` past that newline. Stops at
+ * the end of the string if there is no newline.
+ */
+size_t
+rope_str_line_columns(
+		const struct RopeStr *str, size_t *byte_index, size_t tab_width) {
+	size_t byte_size = 0;
+	const uint8_t *data = rope_str_data(str, &byte_size);
+	uint_least16_t state = 0;
+	uint_least32_t last_cp = GRAPHEME_INVALID_CODEPOINT;
+	size_t columns = 0;
+	size_t pos = *byte_index;
+
+	while (pos < byte_size) {
+		uint_least32_t cp;
+		size_t cp_size = grapheme_decode_utf8(
+				(const char *)&data[pos], byte_size - pos, &cp);
+		pos += cp_size;
+		if (cp == '\n') {
+			break;
+		} else if (grapheme_is_character_break(last_cp, cp, &state)) {
+			columns += cp == '\t' ? tab_width : str_cp_columns(cp);
+		}
+		last_cp = cp;
+	}
+
+	*byte_index = CX_MIN(byte_size, pos);
+	return columns;
+}
+
 size_t
 rope_str_last_char_index(const struct RopeStr *str) {
 	return str_bytes(str) - str_last_char_size(str);
@@ -1,5 +1,7 @@
 #include "common.h"
+#include <grapheme.h>
 #include <rope.h>
+#include <stdlib.h>
 #include <string.h>
 #include <testlib.h>
 
@@ -912,6 +914,478 @@ test_cursor_move_to_oob(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_multi_edit(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "one two three four");
+	ASSERT_EQ(0, rv);
+
+	const size_t positions[] = {0, 4, 8, 18};
+	struct RopeCursor cursors[4] = {0};
+	for (size_t i = 0; i < 4; i++) {
+		rv = rope_cursor_init(&cursors[i], &r);
+		ASSERT_EQ(0, rv);
+		rv = rope_cursor_move_to(&cursors[i], ROPE_BYTE, positions[i], 0);
+		ASSERT_EQ(0, rv);
+	}
+
+	// Unsorted on purpose: the batch is applied in position order.
+	struct RopeEdit edits[] = {
+			{.byte_index = 18, .data = (const uint8_t *)"!", .byte_size = 1},
+			{.byte_index = 4, .delete_size = 3, .data = (const uint8_t *)"2",
+			 .byte_size = 1},
+			{.byte_index = 0, .delete_size = 3, .data = (const uint8_t *)"1",
+			 .byte_size = 1},
+			{.byte_index = 8, .delete_size = 5},
+	};
+	rv = rope_multi_edit(&r, edits, 4);
+	ASSERT_EQ(0, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("1 2  four!", str);
+	free(str);
+	check_integrity(r.root);
+
+	const size_t expected[] = {1, 3, 4, 10};
+	for (size_t i = 0; i < 4; i++) {
+		ASSERT_EQ(expected[i], cursors[i].byte_index);
+		rope_cursor_cleanup(&cursors[i]);
+	}
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_multi_edit_same_position(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "ac");
+	ASSERT_EQ(0, rv);
+
+	struct RopeCursor c = {0};
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 2, 0);
+	ASSERT_EQ(0, rv);
+
+	struct RopeEdit edits[] = {
+			{.byte_index = 1, .data = (const uint8_t *)"b", .byte_size = 1},
+			{.byte_index = 1, .data = (const uint8_t *)"B", .byte_size = 1},
+			{.byte_index = 1, .delete_size = 1},
+	};
+	rv = rope_multi_edit(&r, edits, 3);
+	ASSERT_EQ(0, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("abB", str);
+	free(str);
+	ASSERT_EQ(3u, c.byte_index);
+
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_multi_edit_partial(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "hello brave world");
+	ASSERT_EQ(0, rv);
+
+	const size_t positions[] = {1, 12, 17};
+	struct RopeCursor cursors[3] = {0};
+	for (size_t i = 0; i < 3; i++) {
+		rv = rope_cursor_init(&cursors[i], &r);
+		ASSERT_EQ(0, rv);
+		rv = rope_cursor_move_to(&cursors[i], ROPE_BYTE, positions[i], 0);
+		ASSERT_EQ(0, rv);
+	}
+
+	// The middle edit deletes its text, but its insert is too large. The
+	// edit behind it is applied, the one in front of it is not.
+	struct RopeEdit edits[] = {
+			{.byte_index = 0, .delete_size = 1, .data = (const uint8_t *)"J",
+			 .byte_size = 1},
+			{.byte_index = 6, .delete_size = 6, .data = (const uint8_t *)"x",
+			 .byte_size = SIZE_MAX},
+			{.byte_index = 17, .data = (const uint8_t *)"!", .byte_size = 1},
+	};
+	rv = rope_multi_edit(&r, edits, 3);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("hello world!", str);
+	free(str);
+	check_integrity(r.root);
+
+	const size_t expected[] = {1, 6, 12};
+	for (size_t i = 0; i < 3; i++) {
+		ASSERT_EQ(expected[i], cursors[i].byte_index);
+		rope_cursor_cleanup(&cursors[i]);
+	}
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_multi_edit_oob(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "hello");
+	ASSERT_EQ(0, rv);
+
+	struct RopeEdit overlapping[] = {
+			{.byte_index = 0, .delete_size = 3},
+			{.byte_index = 2, .delete_size = 1},
+	};
+	rv = rope_multi_edit(&r, overlapping, 2);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	struct RopeEdit past_end[] = {
+			{.byte_index = 4, .delete_size = 2},
+	};
+	rv = rope_multi_edit(&r, past_end, 1);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("hello", str);
+	free(str);
+
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_cursor_column(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rope_set_tab_width(&r, 4);
+
+	rope_node_free(r.root, &pool);
+	r.root = from_str(
+			&pool,
+			"[['first\\n\\tx', '\xe4\xb8\xad\xe6\x96\x87'], 'y\\nlast']");
+
+	struct RopeCursor c = {0};
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 3, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(3u, rope_cursor_column(&c));
+
+	// "\tx" and two wide characters on the second line
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 14, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(9u, rope_cursor_column(&c));
+
+	rv = rope_cursor_move_to_column(&c, 5);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(8u, c.byte_index);
+	ASSERT_EQ(5u, rope_cursor_column(&c));
+
+	// Inside the second wide character
+	rv = rope_cursor_move_to_column(&c, 8);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(11u, c.byte_index);
+
+	rv = rope_cursor_move_to_column(&c, 100);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(15u, c.byte_index);
+	ASSERT_EQ(10u, rope_cursor_column(&c));
+
+	rv = rope_cursor_move_to(&c, ROPE_LINE, 2, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to_column(&c, 100);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(rope_size(&r, ROPE_BYTE), c.byte_index);
+
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_cursor_column_single_leaf(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "\tab");
+	ASSERT_EQ(0, rv);
+
+	struct RopeCursor c = {0};
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_move_to_column(&c, 9);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(2u, c.byte_index);
+	ASSERT_EQ(9u, rope_cursor_column(&c));
+
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static size_t
+cursor_row(struct RopeCursor *cursor, size_t width) {
+	size_t row = 0;
+	int rv = rope_cursor_row(cursor, width, &row);
+	ASSERT_EQ(0, rv);
+	return row;
+}
+
+static void
+test_cursor_row(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	rope_node_free(r.root, &pool);
+	r.root = from_str(
+			&pool, "[['abcdefgh\\nab', 'cd\\n'], ['\\n', 'abcdefghij']]");
+
+	struct RopeCursor c = {0};
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	// Lines of 8, 4, 0 and 10 cells.
+	ASSERT_EQ(7u, rope_wrap_rows(&r, 4));
+	ASSERT_EQ(5u, rope_wrap_rows(&r, 8));
+
+	static const size_t row_starts[] = {0, 4, 9, 14, 15, 19, 23};
+	for (size_t row = 0; row < 7; row++) {
+		rv = rope_cursor_move_to_row(&c, 4, row);
+		ASSERT_EQ(0, rv);
+		ASSERT_EQ(row_starts[row], c.byte_index);
+		ASSERT_EQ(row, cursor_row(&c, 4));
+	}
+	rv = rope_cursor_move_to_row(&c, 4, 7);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	// Rows of 0 cells hold nothing.
+	size_t row = 0;
+	ASSERT_EQ(0u, rope_wrap_rows(&r, 0));
+	rv = rope_cursor_row(&c, 0, &row);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+	rv = rope_cursor_move_to_row(&c, 0, 0);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	// Behind the last cell of a full row
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 13, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(2u, cursor_row(&c, 4));
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 25, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(6u, cursor_row(&c, 4));
+
+	rv = rope_insert(&r, ROPE_BYTE, 0, (const uint8_t *)"\tx", 2);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(10u, rope_wrap_rows(&r, 4));
+	ASSERT_EQ(9u, cursor_row(&c, 4));
+
+	rope_set_tab_width(&r, 2);
+	ASSERT_EQ(8u, rope_wrap_rows(&r, 4));
+	ASSERT_EQ(7u, cursor_row(&c, 4));
+
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static size_t
+count_rows(struct Rope *rope, size_t width) {
+	char *str = rope_to_str(rope, 0);
+	size_t rows = 0;
+	size_t columns = 0;
+	for (char *p = str;; p++) {
+		if (*p == '\n' || *p == '\0') {
+			rows += columns == 0 ? 1 : (columns + width - 1) / width;
+			columns = 0;
+		} else {
+			columns++;
+		}
+		if (*p == '\0') {
+			break;
+		}
+	}
+	free(str);
+	return rows;
+}
+
+static void
+test_cursor_row_after_edits(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	uint64_t seed = 1;
+	for (size_t i = 0; i < 2000; i++) {
+		seed = seed * 6364136223846793005u + 1442695040888963407u;
+		const char *data = (seed >> 40) % 4 == 0 ? "\n" : "abcde";
+		const size_t index = (seed >> 20) % (rope_size(&r, ROPE_BYTE) + 1);
+		if ((seed >> 33) % 5 == 0 && index < rope_size(&r, ROPE_BYTE)) {
+			rv = rope_delete(&r, ROPE_BYTE, index, 1);
+		} else {
+			rv = rope_insert(
+					&r, ROPE_BYTE, index, (const uint8_t *)data, strlen(data));
+		}
+		ASSERT_EQ(0, rv);
+		if (i % 100 == 0) {
+			ASSERT_EQ(count_rows(&r, 7), rope_wrap_rows(&r, 7));
+		}
+	}
+	ASSERT_EQ(count_rows(&r, 7), rope_wrap_rows(&r, 7));
+	ASSERT_EQ(count_rows(&r, 13), rope_wrap_rows(&r, 13));
+	ASSERT_EQ(count_rows(&r, 7), rope_wrap_rows(&r, 7));
+
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_cursor_move_words(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "  foo bar, baz\nqux");
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_move_words(&c, 1);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(2u, c.byte_index);
+	rv = rope_cursor_move_words(&c, 2);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(9u, c.byte_index);
+	ASSERT_EQ(2u, rope_cursor_word(&c));
+	rv = rope_cursor_move_words(&c, 10);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(18u, c.byte_index);
+	rv = rope_cursor_move_words(&c, -1);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(15u, c.byte_index);
+	rv = rope_cursor_move_by(&c, ROPE_BYTE, -3);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_words(&c, -1);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(11u, c.byte_index);
+	rv = rope_cursor_move_words(&c, -10);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0u, c.byte_index);
+
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_cursor_move_words_leaves(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	uint64_t seed = 1;
+	for (size_t i = 0; i < 3000; i++) {
+		seed = seed * 6364136223846793005u + 1442695040888963407u;
+		static const char *const data[] = {"ab", "c", " ", ", ", "\n"};
+		const char *str = data[(seed >> 40) % 5];
+		const size_t index = (seed >> 20) % (rope_size(&r, ROPE_BYTE) + 1);
+		rv = rope_insert(
+				&r, ROPE_BYTE, index, (const uint8_t *)str, strlen(str));
+		ASSERT_EQ(0, rv);
+	}
+	char *str = rope_to_str(&r, 0);
+	const size_t size = strlen(str);
+	// Word starts of the whole text, segmented in one go.
+	bool *starts = calloc(size + 1, sizeof(bool));
+	ASSERT_NOT_NULL(starts);
+	for (size_t pos = 0; pos < size;) {
+		starts[pos] = str[pos] != ' ' && str[pos] != '\n';
+		pos += grapheme_next_word_break_utf8(&str[pos], size - pos);
+	}
+	starts[size] = true;
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < size; i += 7) {
+		rv = rope_cursor_move_to(&c, ROPE_BYTE, i, 0);
+		ASSERT_EQ(0, rv);
+		rv = rope_cursor_move_words(&c, 1);
+		ASSERT_EQ(0, rv);
+		size_t expected = i + 1;
+		while (!starts[expected]) {
+			expected++;
+		}
+		ASSERT_EQ(expected, c.byte_index);
+
+		rv = rope_cursor_move_to(&c, ROPE_BYTE, i, 0);
+		ASSERT_EQ(0, rv);
+		rv = rope_cursor_move_words(&c, -1);
+		ASSERT_EQ(0, rv);
+		expected = i;
+		while (expected > 0 && !starts[--expected]) {
+		}
+		ASSERT_EQ(expected, c.byte_index);
+	}
+
+	free(starts);
+	free(str);
+	rope_cursor_cleanup(&c);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
 DECLARE_TESTS
 TEST(cursor_basic)
 TEST(cursor_utf8)
@@ -937,4 +1411,14 @@ TEST(test_range_move_to_at)
 TEST(test_cursor_move_by_oob_forward)
 TEST(test_cursor_move_by_oob_backward)
 TEST(test_cursor_move_to_oob)
+TEST(test_multi_edit)
+TEST(test_multi_edit_same_position)
+TEST(test_multi_edit_partial)
+TEST(test_multi_edit_oob)
+TEST(test_cursor_column)
+TEST(test_cursor_column_single_leaf)
+TEST(test_cursor_row)
+TEST(test_cursor_row_after_edits)
+TEST(test_cursor_move_words)
+TEST(test_cursor_move_words_leaves)
 END_TESTS
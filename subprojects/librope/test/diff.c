@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+
+#include "common.h"
+#include <rope.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <testlib.h>
+#include <unistd.h>
+
+struct Collected {
+	struct RopeEdit edits[64];
+	char data[64][64];
+	size_t count;
+};
+
+static int
+collect(const struct RopeEdit *edit, void *userdata) {
+	struct Collected *collected = userdata;
+	ASSERT_GT(64, collected->count);
+	ASSERT_GT(64, edit->byte_size);
+	if (collected->count > 0) {
+		const struct RopeEdit *last = &collected->edits[collected->count - 1];
+		ASSERT_LE(last->byte_index + last->delete_size, edit->byte_index);
+	}
+	collected->edits[collected->count] = *edit;
+	memcpy(collected->data[collected->count], edit->data, edit->byte_size);
+	collected->count++;
+	return 0;
+}
+
+static void
+check_diff(const char *a, const char *b) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct Rope other = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&other, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, a);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&other, b);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_diff_apply(&r, &other);
+	ASSERT_EQ(0, rv);
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ(b, str);
+	free(str);
+	check_integrity(r.root);
+
+	rope_cleanup(&r);
+	rope_cleanup(&other);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_diff_equal(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct Rope other = {0};
+	struct Collected collected = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&other, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello\nWorld\n");
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&other, "Hello\nWorld\n");
+	ASSERT_EQ(0, rv);
+
+	rv = rope_diff(&r, &other, collect, &collected);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0u, collected.count);
+
+	rope_cleanup(&r);
+	rope_cleanup(&other);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_diff_lines(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct Rope other = {0};
+	struct Collected collected = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&other, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "a\nb\nc\nd\ne\n");
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&other, "a\nc\nd\nx\ne\nf\n");
+	ASSERT_EQ(0, rv);
+
+	rv = rope_diff(&r, &other, collect, &collected);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(3u, collected.count);
+	ASSERT_EQ(2u, collected.edits[0].byte_index);
+	ASSERT_EQ(2u, collected.edits[0].delete_size);
+	ASSERT_EQ(0u, collected.edits[0].byte_size);
+	ASSERT_EQ(8u, collected.edits[1].byte_index);
+	ASSERT_EQ(0u, collected.edits[1].delete_size);
+	ASSERT_STREQS("x\n", collected.data[1], 2);
+	ASSERT_EQ(10u, collected.edits[2].byte_index);
+	ASSERT_EQ(0u, collected.edits[2].delete_size);
+	ASSERT_STREQS("f\n", collected.data[2], 2);
+
+	rope_cleanup(&r);
+	rope_cleanup(&other);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_diff_empty(void) {
+	check_diff("", "");
+	check_diff("", "Hello\n");
+	check_diff("Hello\n", "");
+	check_diff("Hello", "Hello\n");
+	check_diff("abc", "xyz");
+}
+
+static void
+test_diff_random(void) {
+	char a[2048];
+	char b[2048];
+	uint32_t seed = 1;
+
+	for (int round = 0; round < 200; round++) {
+		size_t a_size = 0;
+		size_t b_size = 0;
+		const size_t lines = 1 + round % 40;
+		for (size_t i = 0; i < lines; i++) {
+			seed = seed * 1103515245 + 12345;
+			const char c = 'a' + (seed >> 16) % 6;
+			const unsigned mutation = (seed >> 20) % 8;
+			const size_t length = 1 + (seed >> 24) % 5;
+			if (mutation != 0) {
+				memset(&a[a_size], c, length);
+				a_size += length;
+				a[a_size++] = '\n';
+			}
+			if (mutation != 1) {
+				const char b_c = mutation == 2 ? c + 1 : c;
+				memset(&b[b_size], b_c, length);
+				b_size += length;
+				b[b_size++] = '\n';
+			}
+		}
+		a[a_size] = '\0';
+		b[b_size] = '\0';
+		check_diff(a, b);
+	}
+}
+
+static void
+test_diff_replace_all(void) {
+	// Too many changed lines for a line diff
+	const size_t lines = 3000;
+	char *a = malloc(lines * 2 + 1);
+	char *b = malloc(lines * 2 + 1);
+	ASSERT_NOT_NULL(a);
+	ASSERT_NOT_NULL(b);
+	for (size_t i = 0; i < lines; i++) {
+		memcpy(&a[i * 2], i % 2 ? "a\n" : "b\n", 2);
+		memcpy(&b[i * 2], i % 3 ? "a\n" : "c\n", 2);
+	}
+	a[lines * 2] = '\0';
+	b[lines * 2] = '\0';
+
+	check_diff(a, b);
+	free(a);
+	free(b);
+}
+
+static void
+test_diff_shared_leaves(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct Rope other = {0};
+	struct Collected collected = {0};
+	struct RopeRange range = {0};
+	struct RopeCursor cursor = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&other, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "");
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&other, "");
+	ASSERT_EQ(0, rv);
+
+	char line[32];
+	for (int i = 0; i < 20000; i++) {
+		snprintf(line, sizeof(line), "line %i\n", i);
+		rv = rope_append_str(&r, line);
+		ASSERT_EQ(0, rv);
+	}
+	rv = rope_to_range(&r, &range);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&cursor, &other);
+	ASSERT_EQ(0, rv);
+	rv = rope_range_copy_to(&range, &cursor, 0);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_move_to(&cursor, ROPE_LINE, 10000, 0);
+	ASSERT_EQ(0, rv);
+	const size_t byte_index = cursor.byte_index;
+	rv = rope_cursor_insert_str(&cursor, "new ", 0);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_diff(&r, &other, collect, &collected);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, collected.count);
+	ASSERT_EQ(byte_index, collected.edits[0].byte_index);
+	ASSERT_EQ(0u, collected.edits[0].delete_size);
+	ASSERT_STREQS("new ", collected.data[0], 4);
+
+	rope_cursor_cleanup(&cursor);
+	rope_range_cleanup(&range);
+	rope_cleanup(&r);
+	rope_cleanup(&other);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_diff_reload(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct Rope other = {0};
+	struct RopeCursor cursor = {0};
+	const char content[] = "first\nsecond\nthird\n";
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&other, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "first\n2nd\nthird\n");
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&other, "");
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_init(&cursor, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&cursor, ROPE_LINE, 2, 0);
+	ASSERT_EQ(0, rv);
+
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+	ASSERT_EQ((ssize_t)sizeof(content) - 1,
+			  write(fd, content, sizeof(content) - 1));
+	rv = rope_reload_fd(&r, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ(content, str);
+	free(str);
+	// The cursor still points to the start of the third line.
+	ASSERT_EQ(13u, cursor.byte_index);
+
+	rope_cursor_cleanup(&cursor);
+	rope_cleanup(&r);
+	rope_cleanup(&other);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_diff_equal)
+TEST(test_diff_lines)
+TEST(test_diff_empty)
+TEST(test_diff_random)
+TEST(test_diff_replace_all)
+TEST(test_diff_shared_leaves)
+TEST(test_diff_reload)
+END_TESTS
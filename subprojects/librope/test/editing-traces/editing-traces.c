@@ -12,11 +12,113 @@
 #include <time.h>
 #include <unistd.h>
 
-static const char *opts = "icv";
+#define LEAF_HISTOGRAM_SIZE 16
+
+static const char *opts = "bicv";
+static const struct option long_opts[] = {
+		{"bench", no_argument, NULL, 'b'},
+		{0},
+};
+static bool bench = false;
 static bool intermediate = false;
 static bool integrity_check = false;
 static int verbose = 0;
 
+struct BenchStats {
+	uint64_t *latencies;
+	size_t count;
+	size_t capacity;
+};
+
+static uint64_t
+now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int
+bench_record(struct BenchStats *stats, uint64_t latency) {
+	if (stats->count == stats->capacity) {
+		size_t capacity = stats->capacity ? stats->capacity * 2 : 4096;
+		uint64_t *latencies =
+				realloc(stats->latencies, capacity * sizeof(uint64_t));
+		if (latencies == NULL) {
+			return -1;
+		}
+		stats->latencies = latencies;
+		stats->capacity = capacity;
+	}
+	stats->latencies[stats->count++] = latency;
+	return 0;
+}
+
+static int
+cmp_latency(const void *a, const void *b) {
+	const uint64_t *la = a, *lb = b;
+	return (*la > *lb) - (*la < *lb);
+}
+
+static uint64_t
+bench_percentile(struct BenchStats *stats, size_t percentile) {
+	if (stats->count == 0) {
+		return 0;
+	}
+	return stats->latencies[(stats->count - 1) * percentile / 100];
+}
+
+static void
+bench_report(
+		struct BenchStats *stats, struct Rope *rope, const char *trace_path,
+		uint64_t total_ns) {
+	size_t histogram[LEAF_HISTOGRAM_SIZE] = {0};
+	size_t leaf_count = 0;
+	for (struct RopeNode *node = rope_node_first(rope->root); node;
+		 node = rope_node_next(node)) {
+		size_t byte_size = rope_node_size(node, ROPE_BYTE);
+		size_t bucket = 0;
+		while (byte_size > 1 && bucket < LEAF_HISTOGRAM_SIZE - 1) {
+			byte_size >>= 1;
+			bucket++;
+		}
+		histogram[bucket]++;
+		leaf_count++;
+	}
+
+	qsort(stats->latencies, stats->count, sizeof(uint64_t), cmp_latency);
+
+	json_object *report = json_object_new_object();
+	json_object_object_add(report, "trace", json_object_new_string(trace_path));
+	json_object_object_add(
+			report, "ops", json_object_new_uint64(stats->count));
+	json_object_object_add(
+			report, "ops_per_sec",
+			json_object_new_double(
+					total_ns ? (double)stats->count * 1e9 / (double)total_ns
+							 : 0));
+	json_object_object_add(
+			report, "p50_ns",
+			json_object_new_uint64(bench_percentile(stats, 50)));
+	json_object_object_add(
+			report, "p99_ns",
+			json_object_new_uint64(bench_percentile(stats, 99)));
+	json_object_object_add(
+			report, "peak_nodes",
+			json_object_new_uint64(rope->pool->peak_node_count));
+	json_object_object_add(report, "leaves", json_object_new_uint64(leaf_count));
+
+	// Bucket i counts leaves of [2^i, 2^(i+1)) bytes.
+	json_object *histogram_json = json_object_new_array();
+	for (size_t i = 0; i < LEAF_HISTOGRAM_SIZE; i++) {
+		json_object_array_add(
+				histogram_json, json_object_new_uint64(histogram[i]));
+	}
+	json_object_object_add(report, "leaf_size_histogram", histogram_json);
+
+	puts(json_object_to_json_string_ext(report, JSON_C_TO_STRING_PLAIN));
+	json_object_put(report);
+}
+
 static void
 write_file(const char *content, int fd) {
 	FILE *f = fdopen(fd, "w");
@@ -90,7 +192,8 @@ naive_patch(char **naive_content, size_t pos, size_t del, const char *ins) {
 
 static int
 run_patch(
-		struct RopeCursor *cursor, char **naive_content, json_object *txn_obj) {
+		struct RopeCursor *cursor, char **naive_content, json_object *txn_obj,
+		struct BenchStats *stats) {
 	int rv = 0;
 	char *last_good = NULL;
 	char *rope_content = NULL;
@@ -109,6 +212,7 @@ run_patch(
 		last_good = to_str(cursor->rope->root);
 	}
 
+	uint64_t start = bench ? now_ns() : 0;
 	rv = rope_cursor_move_to(cursor, ROPE_CHAR, pos, 0);
 	if (rv < 0) {
 		goto out;
@@ -121,6 +225,12 @@ run_patch(
 	if (rv < 0) {
 		goto out;
 	}
+	if (bench) {
+		rv = bench_record(stats, now_ns() - start);
+		if (rv < 0) {
+			goto out;
+		}
+	}
 	if (intermediate) {
 		naive_patch(naive_content, pos, del, data);
 
@@ -151,7 +261,8 @@ out:
 
 static int
 run_transaction(
-		struct RopeCursor *cursor, char **naive_content, json_object *txn_obj) {
+		struct RopeCursor *cursor, char **naive_content, json_object *txn_obj,
+		struct BenchStats *stats) {
 	int rv = 0;
 	json_object *patches_obj = json_object_object_get(txn_obj, "patches");
 	if (!patches_obj) {
@@ -161,7 +272,7 @@ run_transaction(
 	size_t len = json_object_array_length(patches_obj);
 	for (size_t i = 0; i < len; i++) {
 		json_object *patch_obj = json_object_array_get_idx(patches_obj, i);
-		rv = run_patch(cursor, naive_content, patch_obj);
+		rv = run_patch(cursor, naive_content, patch_obj, stats);
 		if (rv < 0) {
 			goto out;
 		}
@@ -172,7 +283,7 @@ out:
 }
 
 static int
-run_trace(json_object *trace) {
+run_trace(json_object *trace, const char *trace_path) {
 	char *actual_content = NULL;
 	json_object *start_content_obj = NULL;
 	json_object *end_content_obj = NULL;
@@ -181,6 +292,7 @@ run_trace(json_object *trace) {
 	struct RopePool pool = {0};
 	struct Rope rope = {0};
 	struct RopeCursor cursor = {0};
+	struct BenchStats stats = {0};
 	int rv = 0;
 
 	rv = rope_pool_init(&pool);
@@ -204,27 +316,33 @@ run_trace(json_object *trace) {
 	naive_content = strdup(start_content);
 
 	clock_t time = clock();
+	uint64_t start = now_ns();
 
 	size_t len = json_object_array_length(txns_obj);
 	for (size_t i = 0; i < len; i++) {
-		if (i % 50000 == 0) {
+		if (!bench && i % 50000 == 0) {
 			printf("Applying transaction %zu / %zu\n", i, len);
 		}
 		json_object *txn_obj = json_object_array_get_idx(txns_obj, i);
-		rv = run_transaction(&cursor, &naive_content, txn_obj);
+		rv = run_transaction(&cursor, &naive_content, txn_obj, &stats);
 		if (rv < 0) {
 			goto out;
 		}
 	}
 
-	fprintf(stderr, "finished in %.3lfms\n",
-			(double)(clock() - time) * 1000.0 / (double)CLOCKS_PER_SEC);
+	if (bench) {
+		bench_report(&stats, &rope, trace_path, now_ns() - start);
+	} else {
+		fprintf(stderr, "finished in %.3lfms\n",
+				(double)(clock() - time) * 1000.0 / (double)CLOCKS_PER_SEC);
+	}
 
 	const char *end_content = json_object_get_string(end_content_obj);
 	actual_content = rope_to_str(&rope, 0);
 	compare(end_content, actual_content, NULL, NULL);
 
 out:
+	free(stats.latencies);
 	free(naive_content);
 	free(actual_content);
 	rope_cleanup(&rope);
@@ -232,6 +350,169 @@ out:
 	return 0;
 }
 
+static int
+history_transaction(
+		struct RopeHistory *history, const size_t *revisions,
+		size_t revision_count, json_object *txn_obj,
+		struct RopeHistoryEdit **edits, size_t *edits_capacity) {
+	json_object *parents_obj = json_object_object_get(txn_obj, "parents");
+	json_object *patches_obj = json_object_object_get(txn_obj, "patches");
+	if (!parents_obj || !patches_obj) {
+		return -1;
+	}
+
+	// The transaction is based on the newest of its parents. Parents that
+	// were merged from other branches before that are approximated by it.
+	size_t revision = 0;
+	size_t parent_count = json_object_array_length(parents_obj);
+	for (size_t i = 0; i < parent_count; i++) {
+		json_object *parent_obj = json_object_array_get_idx(parents_obj, i);
+		const int64_t parent = json_object_get_int64(parent_obj);
+		// Parents are transactions that were replayed before this one.
+		if (parent < 0 || (uint64_t)parent >= revision_count) {
+			return -1;
+		}
+		size_t parent_revision = revisions[parent];
+		if (parent_revision > revision) {
+			revision = parent_revision;
+		}
+	}
+
+	size_t count = json_object_array_length(patches_obj);
+	if (count > *edits_capacity) {
+		struct RopeHistoryEdit *new_edits =
+				realloc(*edits, count * sizeof(**edits));
+		if (new_edits == NULL) {
+			return -1;
+		}
+		*edits = new_edits;
+		*edits_capacity = count;
+	}
+	for (size_t i = 0; i < count; i++) {
+		json_object *patch_obj = json_object_array_get_idx(patches_obj, i);
+		json_object *str_obj = json_object_array_get_idx(patch_obj, 2);
+		(*edits)[i] = (struct RopeHistoryEdit){
+				.index = json_object_get_int(
+						json_object_array_get_idx(patch_obj, 0)),
+				.delete_count = json_object_get_int(
+						json_object_array_get_idx(patch_obj, 1)),
+				.data = (const uint8_t *)json_object_get_string(str_obj),
+				.byte_size = json_object_get_string_len(str_obj),
+		};
+	}
+
+	return rope_history_apply(history, revision, *edits, count);
+}
+
+/*
+ * Replays a concurrent trace through a RopeHistory: every transaction is
+ * transformed from the revision of its newest parent to the current state.
+ * The merged content has to match endContent like the sequential replay
+ * does, so a wrong merge, e.g. of a transaction whose other parents were
+ * not covered by its newest one, fails with a diff.
+ */
+static int
+run_concurrent_trace(json_object *trace, const char *trace_path) {
+	char *actual_content = NULL;
+	size_t *revisions = NULL;
+	struct RopeHistoryEdit *edits = NULL;
+	size_t edits_capacity = 0;
+	json_object *start_content_obj = NULL;
+	json_object *end_content_obj = NULL;
+	json_object *txns_obj = NULL;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	struct RopeHistory history = {0};
+	struct BenchStats stats = {0};
+	int rv = 0;
+
+	rv = rope_pool_init(&pool);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_init(&rope, &pool);
+	if (rv < 0) {
+		goto out;
+	}
+	rv = rope_history_init(&history, &rope, ROPE_CP);
+	if (rv < 0) {
+		goto out;
+	}
+
+	start_content_obj = json_object_object_get(trace, "startContent");
+	end_content_obj = json_object_object_get(trace, "endContent");
+	txns_obj = json_object_object_get(trace, "txns");
+
+	if (start_content_obj) {
+		rv = rope_append_str(&rope, json_object_get_string(start_content_obj));
+		if (rv < 0) {
+			goto out;
+		}
+	}
+
+	size_t len = json_object_array_length(txns_obj);
+	revisions = calloc(len, sizeof(*revisions));
+	if (revisions == NULL) {
+		rv = -1;
+		goto out;
+	}
+
+	clock_t time = clock();
+	uint64_t start = now_ns();
+
+	for (size_t i = 0; i < len; i++) {
+		if (!bench && i % 50000 == 0) {
+			printf("Merging transaction %zu / %zu\n", i, len);
+		}
+		json_object *txn_obj = json_object_array_get_idx(txns_obj, i);
+		uint64_t txn_start = bench ? now_ns() : 0;
+		rv = history_transaction(
+				&history, revisions, i, txn_obj, &edits, &edits_capacity);
+		if (rv < 0) {
+			fprintf(stderr, "invalid transaction %zu\n", i);
+			goto out;
+		}
+		revisions[i] = rope_history_revision(&history);
+		if (bench) {
+			rv = bench_record(&stats, now_ns() - txn_start);
+			if (rv < 0) {
+				goto out;
+			}
+		}
+		if (integrity_check) {
+			check_integrity(rope.root);
+		}
+	}
+
+	if (bench) {
+		bench_report(&stats, &rope, trace_path, now_ns() - start);
+	} else {
+		fprintf(stderr, "finished in %.3lfms\n",
+				(double)(clock() - time) * 1000.0 / (double)CLOCKS_PER_SEC);
+	}
+
+	const char *end_content = json_object_get_string(end_content_obj);
+	actual_content = rope_to_str(&rope, 0);
+	compare(end_content, actual_content, NULL, NULL);
+
+out:
+	free(stats.latencies);
+	free(actual_content);
+	free(revisions);
+	free(edits);
+	rope_history_cleanup(&history);
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+	return rv;
+}
+
+static bool
+is_concurrent_trace(json_object *trace) {
+	json_object *kind_obj = json_object_object_get(trace, "kind");
+	return kind_obj &&
+			strcmp(json_object_get_string(kind_obj), "concurrent") == 0;
+}
+
 int
 main(int argc, char *argv[]) {
 	int rv = 0;
@@ -239,8 +520,11 @@ main(int argc, char *argv[]) {
 
 	int opt;
 
-	while ((opt = getopt(argc, argv, opts)) != -1) {
+	while ((opt = getopt_long(argc, argv, opts, long_opts, NULL)) != -1) {
 		switch (opt) {
+		case 'b':
+			bench = true;
+			break;
 		case 'c':
 			integrity_check = true;
 			break;
@@ -258,6 +542,11 @@ main(int argc, char *argv[]) {
 	argc -= optind;
 	argv += optind;
 
+	if (bench) {
+		// Measure the rope only: the naive shadow copy is never updated.
+		intermediate = false;
+	}
+
 	if (argc < 1) {
 		fprintf(stderr, "Usage: %s [options] <trace-file>\n", argv[0]);
 		return EXIT_FAILURE;
@@ -269,7 +558,11 @@ main(int argc, char *argv[]) {
 		goto out;
 	}
 
-	rv = run_trace(trace);
+	if (is_concurrent_trace(trace)) {
+		rv = run_concurrent_trace(trace, argv[0]);
+	} else {
+		rv = run_trace(trace, argv[0]);
+	}
 
 out:
 	json_object_put(trace);
@@ -0,0 +1,255 @@
+#include "common.h"
+#include <rope.h>
+#include <string.h>
+#include <testlib.h>
+
+#define EDIT(i, d, s) \
+	{ \
+		.index = (i), \
+		.delete_count = (d), \
+		.data = (const uint8_t *)(s), \
+		.byte_size = sizeof(s) - 1, \
+	}
+
+static void
+assert_content(struct Rope *r, const char *expected) {
+	char *str = rope_to_str(r, 0);
+	ASSERT_STREQ(expected, str);
+	free(str);
+	check_integrity(r->root);
+}
+
+static void
+test_history_sequential(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit first[] = {EDIT(5, 0, " World")};
+	rv = rope_history_apply(&h, 0, first, 1);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, rope_history_revision(&h));
+
+	struct RopeHistoryEdit second[] = {EDIT(0, 1, "J")};
+	rv = rope_history_apply(&h, 1, second, 1);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(3u, rope_history_revision(&h));
+
+	assert_content(&r, "Jello World");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_concurrent_insert(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "ac");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit first[] = {EDIT(1, 0, "b")};
+	rv = rope_history_apply(&h, 0, first, 1);
+	ASSERT_EQ(0, rv);
+
+	// Based on revision 0, so it does not know about "b" yet.
+	struct RopeHistoryEdit second[] = {EDIT(2, 0, "d")};
+	rv = rope_history_apply(&h, 0, second, 1);
+	ASSERT_EQ(0, rv);
+
+	// Same position as "b": the later edit goes behind it.
+	struct RopeHistoryEdit third[] = {EDIT(1, 0, "B")};
+	rv = rope_history_apply(&h, 0, third, 1);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "abBcd");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_delete_keeps_concurrent_insert(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123456789");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit insert[] = {EDIT(5, 0, "x")};
+	rv = rope_history_apply(&h, 0, insert, 1);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit delete[] = {EDIT(2, 6, "")};
+	rv = rope_history_apply(&h, 0, delete, 1);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "01x89");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_overlapping_delete(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123456789");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit first[] = {EDIT(2, 4, "")};
+	rv = rope_history_apply(&h, 0, first, 1);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit second[] = {EDIT(4, 4, "ab")};
+	rv = rope_history_apply(&h, 0, second, 1);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "01ab89");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_sequential_edits_in_one_apply(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "abc");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit remote[] = {EDIT(0, 0, "123")};
+	rv = rope_history_apply(&h, 0, remote, 1);
+	ASSERT_EQ(0, rv);
+
+	// Each edit sees the previous one: "abc" -> "aXbc" -> "aXbYc" -> "XbYc"
+	struct RopeHistoryEdit local[] = {
+			EDIT(1, 0, "X"),
+			EDIT(3, 0, "Y"),
+			EDIT(0, 1, ""),
+	};
+	rv = rope_history_apply(&h, 0, local, 3);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "123XbYc");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_multibyte(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "\xc3\xa4\xc3\xb6");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit first[] = {EDIT(0, 0, "\xe2\x82\xac")};
+	rv = rope_history_apply(&h, 0, first, 1);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit second[] = {EDIT(1, 1, "u")};
+	rv = rope_history_apply(&h, 0, second, 1);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "\xe2\x82\xac\xc3\xa4u");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_history_trim(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeHistory h = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "");
+	ASSERT_EQ(0, rv);
+	rv = rope_history_init(&h, &r, ROPE_CP);
+	ASSERT_EQ(0, rv);
+
+	struct RopeHistoryEdit edit[] = {EDIT(0, 0, "a")};
+	for (size_t i = 0; i < 4; i++) {
+		rv = rope_history_apply(&h, i, edit, 1);
+		ASSERT_EQ(0, rv);
+	}
+
+	rope_history_trim(&h, 3);
+	ASSERT_EQ(4u, rope_history_revision(&h));
+
+	rv = rope_history_apply(&h, 2, edit, 1);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+	rv = rope_history_apply(&h, 5, edit, 1);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+
+	rv = rope_history_apply(&h, 3, edit, 1);
+	ASSERT_EQ(0, rv);
+
+	assert_content(&r, "aaaaa");
+	rope_history_cleanup(&h);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_history_sequential)
+TEST(test_history_concurrent_insert)
+TEST(test_history_delete_keeps_concurrent_insert)
+TEST(test_history_overlapping_delete)
+TEST(test_history_sequential_edits_in_one_apply)
+TEST(test_history_multibyte)
+TEST(test_history_trim)
+END_TESTS
@@ -1,4 +1,5 @@
 #include <rope.h>
+#include <stdlib.h>
 #include <string.h>
 #include <testlib.h>
 
@@ -187,6 +188,85 @@ test_librope_delete_utf8(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_librope_stats(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeCursor cursor = {0};
+	struct RopeStats stats = {0};
+	uint8_t data[1000];
+	memset(data, 'a', sizeof(data));
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello");
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&cursor, &r);
+	ASSERT_EQ(0, rv);
+
+	rope_stats(&r, &stats);
+	ASSERT_EQ(0u, stats.depth);
+	ASSERT_EQ(0u, stats.branch_count);
+	ASSERT_EQ(1u, stats.leaf_count);
+	ASSERT_EQ(1u, stats.leaf_histogram[0]);
+	ASSERT_EQ(5u, stats.inline_bytes);
+	ASSERT_EQ(0u, stats.heap_bytes);
+	ASSERT_EQ(1u, stats.cursor_count);
+
+	rv = rope_append(&r, data, sizeof(data));
+	ASSERT_EQ(0, rv);
+	// Splits the heap leaf into two that share the heap.
+	rv = rope_insert(&r, ROPE_BYTE, 505, (const uint8_t *)"b", 1);
+	ASSERT_EQ(0, rv);
+
+	rope_stats(&r, &stats);
+	ASSERT_EQ(1006u, stats.byte_count);
+	ASSERT_EQ(stats.byte_count, stats.inline_bytes + stats.heap_bytes);
+	ASSERT_EQ(1000u, stats.shared_bytes);
+	ASSERT_EQ(stats.leaf_count, stats.branch_count + 1);
+	size_t leaf_count = 0;
+	for (size_t i = 0; i < ROPE_STATS_BUCKETS; i++) {
+		leaf_count += stats.leaf_histogram[i];
+	}
+	ASSERT_EQ(stats.leaf_count, leaf_count);
+	ASSERT_EQ(2u, stats.leaf_histogram[5]);
+
+	rope_cursor_cleanup(&cursor);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_librope_end_cursor(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeCursor cursor = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello");
+	ASSERT_EQ(0, rv);
+
+	rv = rope_to_end_cursor(&r, &cursor);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(5u, cursor.byte_index);
+	rv = rope_cursor_insert_str(&cursor, " World", 0);
+	ASSERT_EQ(0, rv);
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("Hello World", str);
+	free(str);
+
+	rope_cursor_cleanup(&cursor);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
 DECLARE_TESTS
 TEST(test_librope_insert)
 TEST(test_librope_split_insert)
@@ -194,4 +274,6 @@ TEST(test_librope_split_delete)
 TEST(test_librope_tail_delete)
 TEST(test_librope_head_delete)
 TEST(test_librope_delete_utf8)
+TEST(test_librope_stats)
+TEST(test_librope_end_cursor)
 END_TESTS
@@ -0,0 +1,447 @@
+#include "common.h"
+#include <rope.h>
+#include <stdlib.h>
+#include <string.h>
+#include <testlib.h>
+
+static void
+assert_marker(struct RopeMarker *marker, size_t start, size_t end) {
+	ASSERT_EQ(start, rope_marker_start(marker));
+	ASSERT_EQ(end, rope_marker_end(marker));
+}
+
+struct Collected {
+	uint64_t values[64];
+	size_t starts[64];
+	size_t ends[64];
+	size_t count;
+};
+
+static void
+collect(struct RopeMarker *marker, size_t start, size_t end, void *userdata) {
+	struct Collected *collected = userdata;
+	ASSERT_GT(64, collected->count);
+	collected->values[collected->count] = marker->value;
+	collected->starts[collected->count] = start;
+	collected->ends[collected->count] = end;
+	collected->count++;
+}
+
+static void
+test_marker_query(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123456789abcdefghij");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	const size_t ranges[][2] = {{12, 15}, {0, 4}, {3, 8}, {10, 10}, {6, 18}};
+	struct RopeMarker markers[5] = {0};
+	for (size_t i = 0; i < 5; i++) {
+		markers[i].value = i;
+		rv = rope_markers_add(&m, &markers[i], ranges[i][0], ranges[i][1]);
+		ASSERT_EQ(0, rv);
+	}
+
+	struct Collected collected = {0};
+	rope_markers_query(&m, 0, 20, collect, &collected);
+	ASSERT_EQ(5, collected.count);
+	const uint64_t all[] = {1, 2, 4, 3, 0};
+	for (size_t i = 0; i < 5; i++) {
+		ASSERT_EQ(all[i], collected.values[i]);
+		ASSERT_EQ(ranges[all[i]][0], collected.starts[i]);
+		ASSERT_EQ(ranges[all[i]][1], collected.ends[i]);
+	}
+
+	collected.count = 0;
+	rope_markers_query(&m, 4, 10, collect, &collected);
+	ASSERT_EQ(2, collected.count);
+	ASSERT_EQ(2, collected.values[0]);
+	ASSERT_EQ(4, collected.values[1]);
+
+	collected.count = 0;
+	rope_markers_query(&m, 10, 11, collect, &collected);
+	ASSERT_EQ(2, collected.count);
+	ASSERT_EQ(4, collected.values[0]);
+	ASSERT_EQ(3, collected.values[1]);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_marker_insert(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello World");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	struct RopeMarker marker = {0};
+	rv = rope_markers_add(&m, &marker, 6, 11);
+	ASSERT_EQ(0, rv);
+
+	// In front of the marker
+	rv = rope_cursor_insert_str(&c, ">> ", 0);
+	ASSERT_EQ(0, rv);
+	assert_marker(&marker, 9, 14);
+
+	// Inside of the marker
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 11, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_insert_str(&c, "--", 0);
+	ASSERT_EQ(0, rv);
+	assert_marker(&marker, 9, 16);
+
+	// At the start and end of the marker
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 9, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_insert_str(&c, "[", 0);
+	ASSERT_EQ(0, rv);
+	assert_marker(&marker, 10, 17);
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 17, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_insert_str(&c, "]", 0);
+	ASSERT_EQ(0, rv);
+	assert_marker(&marker, 10, 17);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ(">> Hello [Wo--rld]", str);
+	free(str);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_marker_delete(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123456789");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	struct RopeMarker inside = {0};
+	struct RopeMarker overlap_start = {0};
+	struct RopeMarker overlap_end = {0};
+	struct RopeMarker around = {0};
+	struct RopeMarker behind = {0};
+	rv = rope_markers_add(&m, &inside, 4, 5);
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_add(&m, &overlap_start, 5, 8);
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_add(&m, &overlap_end, 1, 4);
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_add(&m, &around, 2, 7);
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_add(&m, &behind, 8, 10);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_cursor_move_to(&c, ROPE_BYTE, 3, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_delete(&c, ROPE_BYTE, 3);
+	ASSERT_EQ(0, rv);
+
+	assert_marker(&inside, 3, 3);
+	assert_marker(&overlap_start, 3, 5);
+	assert_marker(&overlap_end, 1, 3);
+	assert_marker(&around, 2, 4);
+	assert_marker(&behind, 5, 7);
+
+	rope_clear(&r);
+	assert_marker(&behind, 0, 0);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_marker_remove(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123456789");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	struct RopeMarker markers[8] = {0};
+	for (size_t i = 0; i < 8; i++) {
+		markers[i].value = i;
+		rv = rope_markers_add(&m, &markers[i], i, i + 2);
+		ASSERT_EQ(0, rv);
+	}
+	rv = rope_cursor_insert_str(&c, "ab", 0);
+	ASSERT_EQ(0, rv);
+
+	rope_markers_remove(&m, &markers[3]);
+	rope_markers_remove(&m, &markers[0]);
+	rope_markers_remove(&m, &markers[7]);
+
+	struct Collected collected = {0};
+	rope_markers_query(&m, 0, 12, collect, &collected);
+	const uint64_t expected[] = {1, 2, 4, 5, 6};
+	ASSERT_EQ(5, collected.count);
+	for (size_t i = 0; i < 5; i++) {
+		ASSERT_EQ(expected[i], collected.values[i]);
+		ASSERT_EQ(expected[i] + 2, collected.starts[i]);
+	}
+
+	rope_markers_clear(&m);
+	collected.count = 0;
+	rope_markers_query(&m, 0, 12, collect, &collected);
+	ASSERT_EQ(0, collected.count);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_marker_multi_edit(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "one two three four");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	struct RopeMarker words[4] = {0};
+	const size_t ranges[][2] = {{0, 3}, {4, 7}, {8, 13}, {14, 18}};
+	for (size_t i = 0; i < 4; i++) {
+		rv = rope_markers_add(&m, &words[i], ranges[i][0], ranges[i][1]);
+		ASSERT_EQ(0, rv);
+	}
+
+	struct RopeEdit edits[] = {
+			{.byte_index = 18, .data = (const uint8_t *)"!", .byte_size = 1},
+			{.byte_index = 4, .delete_size = 3, .data = (const uint8_t *)"2",
+			 .byte_size = 1},
+			{.byte_index = 8, .delete_size = 5},
+	};
+	rv = rope_multi_edit(&r, edits, 3);
+	ASSERT_EQ(0, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("one 2  four!", str);
+	free(str);
+
+	assert_marker(&words[0], 0, 3);
+	assert_marker(&words[1], 5, 5);
+	assert_marker(&words[2], 6, 6);
+	assert_marker(&words[3], 7, 11);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_marker_oob(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "0123");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+
+	struct RopeMarker marker = {0};
+	rv = rope_markers_add(&m, &marker, 2, 5);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+	rv = rope_markers_add(&m, &marker, 3, 2);
+	ASSERT_EQ(-ROPE_ERROR_OOB, rv);
+	rv = rope_markers_add(&m, &marker, 4, 4);
+	ASSERT_EQ(0, rv);
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+model_damage(
+		size_t *start, size_t *end, size_t byte_index, size_t delete_size,
+		size_t insert_size) {
+	const size_t delete_end = byte_index + delete_size;
+	if (*start >= delete_end) {
+		*start = *start - delete_size + insert_size;
+	} else if (*start >= byte_index) {
+		*start = byte_index + insert_size;
+	}
+	if (*end > byte_index && *end >= delete_end) {
+		*end = *end - delete_size + insert_size;
+	} else if (*end > byte_index) {
+		*end = byte_index;
+	}
+	if (*end < *start) {
+		*end = *start;
+	}
+}
+
+static void
+test_marker_random(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	struct RopeMarkers m = {0};
+	struct RopeCursor c = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "");
+	ASSERT_EQ(0, rv);
+	rv = rope_markers_init(&m, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&c, &r);
+	ASSERT_EQ(0, rv);
+	uint8_t data[16];
+	memset(data, 'x', sizeof(data));
+	rv = rope_append(&r, (uint8_t *)"0123456789abcdef", 16);
+	ASSERT_EQ(0, rv);
+
+	enum { COUNT = 48 };
+	struct RopeMarker markers[COUNT] = {0};
+	size_t starts[COUNT];
+	size_t ends[COUNT];
+	bool added[COUNT] = {0};
+	srand(4);
+
+	for (size_t round = 0; round < 2000; round++) {
+		const size_t size = rope_size(&r, ROPE_BYTE);
+		const size_t i = rand() % COUNT;
+		const int op = rand() % 4;
+		if (op == 0 && !added[i]) {
+			starts[i] = rand() % (size + 1);
+			ends[i] = starts[i] + rand() % (size - starts[i] + 1);
+			rv = rope_markers_add(&m, &markers[i], starts[i], ends[i]);
+			ASSERT_EQ(0, rv);
+			added[i] = true;
+		} else if (op == 0) {
+			rope_markers_remove(&m, &markers[i]);
+			added[i] = false;
+		} else {
+			const size_t byte_index = rand() % (size + 1);
+			size_t delete_size = 0;
+			size_t insert_size = 0;
+			if (op == 1 || size > 256) {
+				delete_size = rand() % CX_MIN(size - byte_index + 1, 8);
+			}
+			if (op != 1) {
+				insert_size = 1 + rand() % sizeof(data);
+			}
+			rv = rope_cursor_move_to(&c, ROPE_BYTE, byte_index, 0);
+			ASSERT_EQ(0, rv);
+			rv = rope_cursor_delete(&c, ROPE_BYTE, delete_size);
+			ASSERT_EQ(0, rv);
+			rv = rope_cursor_insert_data(&c, data, insert_size, 0);
+			ASSERT_EQ(0, rv);
+			for (size_t j = 0; j < COUNT; j++) {
+				model_damage(
+						&starts[j], &ends[j], byte_index, delete_size, 0);
+				model_damage(&starts[j], &ends[j], byte_index, 0, insert_size);
+			}
+		}
+
+		const size_t from = rand() % (size + 1);
+		const size_t to = from + rand() % 32;
+		struct Collected collected = {0};
+		size_t expected = 0;
+		rope_markers_query(&m, from, to, collect, &collected);
+		for (size_t j = 0; j < COUNT; j++) {
+			if (!added[j]) {
+				continue;
+			}
+			assert_marker(&markers[j], starts[j], ends[j]);
+			const bool empty = starts[j] == ends[j];
+			if (starts[j] < to &&
+				(ends[j] > from || (empty && starts[j] >= from))) {
+				expected++;
+			}
+		}
+		ASSERT_EQ(expected, collected.count);
+		for (size_t j = 1; j < collected.count; j++) {
+			ASSERT_LE(collected.starts[j - 1], collected.starts[j]);
+		}
+	}
+
+	rope_cursor_cleanup(&c);
+	rope_markers_cleanup(&m);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_marker_query)
+TEST(test_marker_insert)
+TEST(test_marker_delete)
+TEST(test_marker_remove)
+TEST(test_marker_multi_edit)
+TEST(test_marker_oob)
+TEST(test_marker_random)
+END_TESTS
@@ -706,6 +706,268 @@ test_compact_subtree_with_deep_sibling(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_chores_coarsen_cold(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	char buffer[600] = {0};
+	memset(buffer, 'A', sizeof(buffer));
+
+	struct RopeNode *root = rope_node_new(&pool);
+	for (int i = 0; i < 4; i++) {
+		rv = rope_node_insert_right(
+				rope_node_last(root), (const uint8_t *)buffer, sizeof(buffer),
+				0, &pool);
+		ASSERT_EQ(0, rv);
+	}
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(root));
+
+	rv = rope_node_chores(root, &pool);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(ROPE_NODE_LEAF, rope_node_type(root));
+	ASSERT_EQ(sizeof(buffer) * 4, rope_node_size(root, ROPE_BYTE));
+	ASSERT_EQ(sizeof(buffer) * 4, rope_node_size(root, ROPE_CHAR));
+	ASSERT_TRUE(rope_str_is_compressed(&root->data.leaf));
+
+	size_t byte_size = 0;
+	const uint8_t *data = rope_node_value(root, &byte_size);
+	ASSERT_EQ(sizeof(buffer) * 4, byte_size);
+	for (size_t i = 0; i < byte_size; i++) {
+		ASSERT_EQ('A', data[i]);
+	}
+	ASSERT_TRUE(rope_str_is_compressed(&root->data.leaf));
+
+	check_integrity(root);
+	rope_node_free(root, &pool);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_chores_keep_hot_fine(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	char buffer[600] = {0};
+	memset(buffer, 'A', sizeof(buffer));
+
+	struct RopeNode *root = rope_node_new(&pool);
+	for (int i = 0; i < 4; i++) {
+		rv = rope_node_insert_right(
+				rope_node_last(root), (const uint8_t *)buffer, sizeof(buffer),
+				0, &pool);
+		ASSERT_EQ(0, rv);
+	}
+	struct RopeNode *hot = rope_node_left(root);
+	struct RopeNode *cold = rope_node_right(root);
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(hot));
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(cold));
+
+	rope_node_touch(rope_node_first(root));
+	ASSERT_EQ(1u, rope_node_heat(root));
+	ASSERT_EQ(1u, rope_node_heat(hot));
+	ASSERT_EQ(0u, rope_node_heat(cold));
+
+	rv = rope_node_chores(root, &pool);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(root));
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(hot));
+	ASSERT_EQ(ROPE_NODE_LEAF, rope_node_type(cold));
+	ASSERT_EQ(0u, rope_node_heat(root));
+	ASSERT_EQ(sizeof(buffer) * 4, rope_node_size(root, ROPE_BYTE));
+	check_integrity(root);
+
+	rv = rope_node_chores(root, &pool);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(ROPE_NODE_LEAF, rope_node_type(root));
+	ASSERT_EQ(sizeof(buffer) * 4, rope_node_size(root, ROPE_BYTE));
+
+	check_integrity(root);
+	rope_node_free(root, &pool);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+check_coarsened(struct RopeNode *node) {
+	if (ROPE_NODE_IS_LEAF(node)) {
+		return;
+	}
+	const size_t byte_size = rope_node_size(node, ROPE_BYTE);
+	ASSERT_LT((size_t)ROPE_NODE_COLD_LEAF_SIZE, byte_size);
+	check_coarsened(rope_node_left(node));
+	check_coarsened(rope_node_right(node));
+}
+
+static void
+test_chores_coarsen_rotated(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	const size_t sizes[] = {100, 100, 1000, 1000, 2000, 1500, 1500};
+	char leaves[7][2048] = {0};
+	char json[sizeof(leaves) + 64] = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < 7; i++) {
+		memset(leaves[i], 'a' + i, sizes[i]);
+	}
+	snprintf(
+			json, sizeof(json),
+			"[[\"%s\",\"%s\"],[[[\"%s\",\"%s\"],\"%s\"],"
+			"[\"%s\",\"%s\"]]]",
+			leaves[0], leaves[1], leaves[2], leaves[3], leaves[4], leaves[5],
+			leaves[6]);
+	struct RopeNode *root = from_str(&pool, json);
+
+	// Coarsening the left subtree rotates the root, which must not make the
+	// walk skip the subtrees on the right.
+	rv = rope_node_chores(root, &pool);
+	ASSERT_EQ(0, rv);
+
+	check_integrity(root);
+	check_coarsened(root);
+	ASSERT_EQ(7200u, rope_node_size(root, ROPE_BYTE));
+
+	rope_node_free(root, &pool);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_chores_keep_tags(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	struct RopeNode *root = from_str(&pool, "['Left','Right']");
+	rope_node_add_tags(rope_node_left(root), 0x01);
+
+	rv = rope_node_chores(root, &pool);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(ROPE_NODE_BRANCH, rope_node_type(root));
+	ASSERT_EQ(0x01u, rope_node_tags(rope_node_left(root)));
+	ASSERT_EQ(0x00u, rope_node_tags(rope_node_right(root)));
+
+	check_integrity(root);
+	rope_node_free(root, &pool);
+	rope_pool_cleanup(&pool);
+}
+
+static size_t
+wrap_width(const struct RopeSummaries *summaries, const struct RopeNode *node) {
+	const struct RopeSummary *summary = rope_summaries_find(summaries, node);
+	if (summary == NULL || (node->bits & ROPE_NODE_SUMMARY) == 0) {
+		return 0;
+	}
+	return summary->wrap_width;
+}
+
+static void
+test_node_wrap_cache(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct RopeSummaries summaries = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	struct RopeNode *root =
+			from_str(&pool, "[['abc\\nde', 'f'], ['ghij\\n', 'k']]");
+	struct RopeNode *left = rope_node_left(root);
+	struct RopeNode *right = rope_node_right(root);
+
+	// "abc", "defghij" and "k" take 2, 4 and 1 rows.
+	ASSERT_EQ(7u, rope_node_wrap_rows(root, &summaries, 2, 8));
+	ASSERT_EQ(2u, wrap_width(&summaries, left));
+	ASSERT_EQ(2u, wrap_width(&summaries, right));
+
+	rv = rope_node_skip(rope_node_left(right), ROPE_BYTE, 2);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(2u, wrap_width(&summaries, left));
+	ASSERT_EQ(0u, wrap_width(&summaries, right));
+	ASSERT_EQ(0u, wrap_width(&summaries, root));
+
+	ASSERT_EQ(6u, rope_node_wrap_rows(root, &summaries, 2, 8));
+	size_t first_row = 0;
+	ASSERT_EQ(1u, rope_node_row_to_line(root, &summaries, 4, 2, 8, &first_row));
+	ASSERT_EQ(2u, first_row);
+	ASSERT_EQ(2u, rope_node_line_to_row(root, &summaries, 1, 2, 8));
+	ASSERT_EQ(5u, rope_node_line_to_row(root, &summaries, 2, 2, 8));
+
+	// Without a table nothing is cached.
+	ASSERT_EQ(4u, rope_node_wrap_rows(root, NULL, 3, 8));
+	ASSERT_EQ(2u, wrap_width(&summaries, root));
+
+	check_integrity(root);
+	rope_node_free(root, &pool);
+	rope_summaries_cleanup(&summaries);
+	rope_pool_cleanup(&pool);
+}
+
+static bool
+has_words(const struct RopeSummaries *summaries, const struct RopeNode *node) {
+	const struct RopeSummary *summary = rope_summaries_find(summaries, node);
+	return summary != NULL && (node->bits & ROPE_NODE_SUMMARY) &&
+			summary->has_words;
+}
+
+static void
+test_node_word_cache(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct RopeWords words = {0};
+	struct RopeSummaries summaries = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	struct RopeNode *root =
+			from_str(&pool, "[['ab cd', 'ef.'], [' gh', 'i']]");
+	struct RopeNode *left = rope_node_left(root);
+	struct RopeNode *right = rope_node_right(root);
+
+	// "ab", "cdef", "." and "ghi" span leaves.
+	rope_node_words(root, &summaries, &words);
+	ASSERT_EQ(4u, words.starts);
+	ASSERT_TRUE(has_words(&summaries, left));
+	ASSERT_TRUE(has_words(&summaries, right));
+	ASSERT_EQ(2u, rope_node_byte_to_word(root, &summaries, 4));
+	ASSERT_EQ(3u, rope_node_byte_to_word(root, &summaries, 9));
+	ASSERT_EQ(4u, rope_node_byte_to_word(root, &summaries, 10));
+	ASSERT_EQ(0u, rope_node_word_to_byte(root, &summaries, 0));
+	ASSERT_EQ(3u, rope_node_word_to_byte(root, &summaries, 1));
+	ASSERT_EQ(7u, rope_node_word_to_byte(root, &summaries, 2));
+	ASSERT_EQ(9u, rope_node_word_to_byte(root, &summaries, 3));
+	ASSERT_EQ(12u, rope_node_word_to_byte(root, &summaries, 4));
+
+	rv = rope_node_skip(rope_node_left(right), ROPE_BYTE, 1);
+	ASSERT_EQ(0, rv);
+	ASSERT_TRUE(has_words(&summaries, left));
+	ASSERT_FALSE(has_words(&summaries, right));
+	ASSERT_FALSE(has_words(&summaries, root));
+
+	rope_node_words(root, &summaries, &words);
+	ASSERT_EQ(4u, words.starts);
+	ASSERT_EQ(8u, rope_node_word_to_byte(root, &summaries, 3));
+
+	check_integrity(root);
+	rope_node_free(root, &pool);
+	rope_summaries_cleanup(&summaries);
+	rope_pool_cleanup(&pool);
+}
+
 DECLARE_TESTS
 TEST(test_node_split_inline_middle)
 TEST(test_node_insert_right)
@@ -725,11 +987,17 @@ TEST(test_test_utf8_sequence_sliding_right)
 TEST(test_test_utf8_sequence_sliding_left)
 TEST(test_node_balance_preserves_sizes)
 TEST(test_node_rotate_preserves_sizes)
-NO_TEST(test_compact_simple_branch)
-NO_TEST(test_compact_deeply_nested_tree)
-NO_TEST(test_compact_size_boundary_exceeds_limit)
-NO_TEST(test_compact_on_leaf_is_noop)
-NO_TEST(test_compact_tags_persist)
-NO_TEST(test_compact_subtree_avl_consistency)
-NO_TEST(test_compact_subtree_with_deep_sibling)
+TEST(test_compact_simple_branch)
+TEST(test_compact_deeply_nested_tree)
+TEST(test_compact_size_boundary_exceeds_limit)
+TEST(test_compact_on_leaf_is_noop)
+TEST(test_compact_tags_persist)
+TEST(test_compact_subtree_avl_consistency)
+TEST(test_compact_subtree_with_deep_sibling)
+TEST(test_chores_coarsen_cold)
+TEST(test_chores_keep_hot_fine)
+TEST(test_chores_coarsen_rotated)
+TEST(test_chores_keep_tags)
+TEST(test_node_wrap_cache)
+TEST(test_node_word_cache)
 END_TESTS
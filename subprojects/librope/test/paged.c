@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+
+#include "common.h"
+#include <rope.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <testlib.h>
+#include <unistd.h>
+
+static int
+write_file(const char *content, size_t size) {
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+	for (size_t written = 0; written < size;) {
+		ssize_t rv = write(fd, &content[written], size - written);
+		ASSERT_LT(0, rv);
+		written += (size_t)rv;
+	}
+	return fd;
+}
+
+static void
+check_mapped(const char *content, size_t size) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope expected = {0};
+	struct Rope mapped = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&expected, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&mapped, &pool);
+	ASSERT_EQ(0, rv);
+	// Appending everything at once splits the data over and over again.
+	for (size_t pos = 0; pos < size;) {
+		const char *newline = memchr(&content[pos], '\n', size - pos);
+		const size_t end = newline ? (size_t)(newline - content) + 1 : size;
+		rv = rope_append(&expected, (const uint8_t *)&content[pos], end - pos);
+		ASSERT_EQ(0, rv);
+		pos = end;
+	}
+
+	int fd = write_file(content, size);
+	rv = rope_map_fd(&mapped, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	check_integrity(mapped.root);
+	for (enum RopeUnit unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+		ASSERT_EQ(rope_size(&expected, unit), rope_size(&mapped, unit));
+	}
+	char *str = rope_to_str(&mapped, 0);
+	ASSERT_EQ(size, strlen(str));
+	ASSERT_EQ(0, memcmp(content, str, size));
+	free(str);
+
+	struct RopeCursor cursor = {0};
+	struct RopeCursor expected_cursor = {0};
+	rv = rope_cursor_init(&cursor, &mapped);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_init(&expected_cursor, &expected);
+	ASSERT_EQ(0, rv);
+	const size_t lines = rope_size(&mapped, ROPE_LINE);
+	for (size_t line = 0; line <= lines; line += lines / 7 + 1) {
+		rv = rope_cursor_move_to(&cursor, ROPE_LINE, line, 0);
+		ASSERT_EQ(0, rv);
+		rv = rope_cursor_move_to(&expected_cursor, ROPE_LINE, line, 0);
+		ASSERT_EQ(0, rv);
+		ASSERT_EQ(expected_cursor.byte_index, cursor.byte_index);
+		ASSERT_EQ(
+				rope_cursor_index(&expected_cursor, ROPE_CHAR, 0),
+				rope_cursor_index(&cursor, ROPE_CHAR, 0));
+	}
+	rope_cursor_cleanup(&expected_cursor);
+	rope_cursor_cleanup(&cursor);
+
+	rope_cleanup(&expected);
+	rope_cleanup(&mapped);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_paged_empty(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "Hello");
+	ASSERT_EQ(0, rv);
+
+	int fd = write_file("", 0);
+	rv = rope_map_fd(&r, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+	ASSERT_EQ(0, rope_size(&r, ROPE_BYTE));
+
+	rv = rope_map_file(&r, "/nonexistent/rope");
+	ASSERT_GT(0, rv);
+
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_paged_small(void) {
+	const char content[] = "Hello\n\tWörld\n";
+	check_mapped(content, sizeof(content) - 1);
+}
+
+static void
+test_paged_lines(void) {
+	// Large enough to be scanned in more than one segment.
+	const size_t size = (size_t)9 * 1024 * 1024;
+	char *content = malloc(size + 1);
+	ASSERT_NOT_NULL(content);
+	size_t pos = 0;
+	for (size_t line = 0; pos < size; line++) {
+		pos += snprintf(
+				&content[pos], size + 1 - pos, "%zu\tä文\xcc\x81 line\n", line);
+	}
+
+	check_mapped(content, size);
+	free(content);
+}
+
+static void
+test_paged_long_line(void) {
+	// Lines longer than a leaf are split between codepoints.
+	const size_t size = 300 * 1024;
+	char *content = malloc(size);
+	ASSERT_NOT_NULL(content);
+	content[0] = 'x';
+	for (size_t i = 1; i + 3 <= size; i += 3) {
+		memcpy(&content[i], "\xe6\x96\x87", 3);
+	}
+	content[size - 2] = '\n';
+	content[size - 1] = 'y';
+
+	check_mapped(content, size);
+	free(content);
+}
+
+static void
+test_paged_edit(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	const size_t size = 200 * 1024;
+	char *content = malloc(size + 1);
+	ASSERT_NOT_NULL(content);
+	for (size_t i = 0; i < size; i++) {
+		content[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+	}
+	content[size] = '\0';
+	int fd = write_file(content, size);
+	rv = rope_map_fd(&r, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	struct RopeCursor cursor = {0};
+	rv = rope_cursor_init(&cursor, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&cursor, ROPE_LINE, 1500, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1500 * 64, cursor.byte_index);
+	rv = rope_cursor_delete(&cursor, ROPE_BYTE, 64);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_insert_str(&cursor, "inserted\n", 0);
+	ASSERT_EQ(0, rv);
+	check_integrity(r.root);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_EQ(0, memcmp(content, str, 1500 * 64));
+	ASSERT_EQ(0, memcmp("inserted\n", &str[1500 * 64], 9));
+	ASSERT_STREQ(&content[1501 * 64], &str[1500 * 64 + 9]);
+	free(str);
+
+	rope_cursor_cleanup(&cursor);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+	free(content);
+}
+
+DECLARE_TESTS
+TEST(test_paged_empty)
+TEST(test_paged_small)
+TEST(test_paged_lines)
+TEST(test_paged_long_line)
+TEST(test_paged_edit)
+END_TESTS
@@ -394,6 +394,155 @@ range_multinode(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+range_copy_to(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	rope_node_free(r.root, &pool);
+	r.root = from_str(&pool, "[['Hello',' '],['Wor','ld']]");
+
+	struct RopeRange range = {0};
+	rv = rope_range_init(&range, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(rope_range_start(&range), ROPE_CHAR, 4, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(rope_range_end(&range), ROPE_CHAR, 9, 0);
+	ASSERT_EQ(0, rv);
+
+	struct RopeCursor target = {0};
+	rv = rope_cursor_init(&target, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&target, ROPE_CHAR, 11, 0);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_range_copy_to(&range, &target, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(16u, rope_cursor_index(&target, ROPE_CHAR, 0));
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_STREQ("Hello Worldo Wor", str);
+	free(str);
+	check_integrity(r.root);
+
+	rope_cursor_cleanup(&target);
+	rope_range_cleanup(&range);
+	rope_cleanup(&r);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+range_copy_to_shares_leaves(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope source = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&source, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	char *content = malloc(64 * 1024 + 1);
+	ASSERT_NOT_NULL(content);
+	for (size_t i = 0; i < 64 * 1024; i++) {
+		content[i] = i % 64 == 63 ? '\n' : 'a' + (char)(i % 26);
+	}
+	content[64 * 1024] = '\0';
+	rv = rope_append_str(&source, content);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&r, "<>");
+	ASSERT_EQ(0, rv);
+
+	struct RopeNode *source_leaf = rope_node_next(rope_node_first(source.root));
+	struct RopeStrHeap *heap = source_leaf->data.leaf.data.heap.str;
+	const uint32_t ref_count = heap->ref_count;
+
+	struct RopeRange range = {0};
+	rv = rope_range_init(&range, &source);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(
+			rope_range_end(&range), ROPE_BYTE, 64 * 1024, 0);
+	ASSERT_EQ(0, rv);
+
+	struct RopeCursor target = {0};
+	rv = rope_cursor_init(&target, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&target, ROPE_BYTE, 1, 0);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_range_copy_to(&range, &target, 0);
+	ASSERT_EQ(0, rv);
+
+	char *str = rope_to_str(&r, 0);
+	ASSERT_EQ('<', str[0]);
+	ASSERT_EQ(0, memcmp(content, &str[1], 64 * 1024));
+	ASSERT_STREQ(">", &str[64 * 1024 + 1]);
+	free(str);
+	check_integrity(r.root);
+
+	// The copied leaves reference the source buffer instead of duplicating it.
+	struct RopeNode *leaf = rope_node_next(rope_node_first(r.root));
+	ASSERT_EQ(heap, leaf->data.leaf.data.heap.str);
+	ASSERT_LT(ref_count, heap->ref_count);
+
+	rope_cursor_cleanup(&target);
+	rope_range_cleanup(&range);
+	free(content);
+	rope_cleanup(&r);
+	rope_cleanup(&source);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+range_copy_to_stitches(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope source = {0};
+	struct Rope r = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&source, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&r, &pool);
+	ASSERT_EQ(0, rv);
+
+	// U+0301 COMBINING ACUTE ACCENT joins the "e" in front of the copy.
+	rope_node_free(source.root, &pool);
+	source.root = from_str(&pool, "['\xcc\x81" "a','b']");
+	rv = rope_append_str(&r, "e");
+	ASSERT_EQ(0, rv);
+
+	struct RopeRange range = {0};
+	rv = rope_range_init(&range, &source);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(rope_range_end(&range), ROPE_BYTE, 4, 0);
+	ASSERT_EQ(0, rv);
+
+	struct RopeCursor target = {0};
+	rv = rope_cursor_init(&target, &r);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(&target, ROPE_BYTE, 1, 0);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_range_copy_to(&range, &target, 0);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(3u, rope_size(&r, ROPE_CHAR));
+	check_integrity(r.root);
+
+	rope_cursor_cleanup(&target);
+	rope_range_cleanup(&range);
+	rope_cleanup(&r);
+	rope_cleanup(&source);
+	rope_pool_cleanup(&pool);
+}
+
 DECLARE_TESTS
 TEST(range_basic)
 TEST(range_insert_delete)
@@ -404,4 +553,7 @@ TEST(range_ordering)
 TEST(range_insert_raw)
 TEST(range_utf8)
 TEST(range_multinode)
+TEST(range_copy_to)
+TEST(range_copy_to_shares_leaves)
+TEST(range_copy_to_stitches)
 END_TESTS
@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+
+#include "common.h"
+#include <rope.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <testlib.h>
+#include <unistd.h>
+
+static struct RopeNode *
+next_filled(struct RopeNode *node) {
+	while (node && rope_node_size(node, ROPE_BYTE) == 0) {
+		node = rope_node_next(node);
+	}
+	return node;
+}
+
+static void
+check_round_trip(struct Rope *rope) {
+	int rv = 0;
+	struct Rope restored = {0};
+
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+
+	rv = rope_serialize(rope, fd);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_init(&restored, rope->pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_deserialize_fd(&restored, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	check_integrity(restored.root);
+	for (enum RopeUnit unit = 0; unit < ROPE_UNIT_COUNT; unit++) {
+		ASSERT_EQ(rope_size(rope, unit), rope_size(&restored, unit));
+	}
+	char *expected = rope_to_str(rope, 0);
+	char *actual = rope_to_str(&restored, 0);
+	ASSERT_STREQ(expected, actual);
+	free(expected);
+	free(actual);
+
+	struct RopeNode *node = next_filled(rope_node_first(rope->root));
+	struct RopeNode *restored_node =
+			next_filled(rope_node_first(restored.root));
+	for (; node; node = next_filled(rope_node_next(node))) {
+		ASSERT_NOT_NULL(restored_node);
+		ASSERT_EQ(rope_node_tags(node), rope_node_tags(restored_node));
+		restored_node = next_filled(rope_node_next(restored_node));
+	}
+	ASSERT_NULL(restored_node);
+
+	rope_cleanup(&restored);
+}
+
+static void
+test_serialize_empty(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+
+	check_round_trip(&rope);
+
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_serialize_round_trip(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	char buffer[4096] = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < sizeof(buffer) - 1; i++) {
+		buffer[i] = "a\nbc\xc3\xa4 "[i % 7];
+	}
+	rv = rope_append_str(&rope, buffer);
+	ASSERT_EQ(0, rv);
+	rv = rope_insert(&rope, ROPE_CHAR, 5, (const uint8_t *)"short", 5);
+	ASSERT_EQ(0, rv);
+	rv = rope_insert(&rope, ROPE_BYTE, 0, (const uint8_t *)"\xf0\x9f\x98\x80", 4);
+	ASSERT_EQ(0, rv);
+	rope_node_add_tags(rope_node_last(rope.root), 0x4);
+
+	check_round_trip(&rope);
+
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_serialize_edit_restored(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	struct Rope restored = {0};
+	char buffer[2048] = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&restored, &pool);
+	ASSERT_EQ(0, rv);
+
+	memset(buffer, 'x', sizeof(buffer) - 1);
+	rv = rope_append_str(&rope, buffer);
+	ASSERT_EQ(0, rv);
+
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+	rv = rope_serialize(&rope, fd);
+	ASSERT_EQ(0, rv);
+	rv = rope_deserialize_fd(&restored, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	rv = rope_insert(&restored, ROPE_BYTE, 100, (const uint8_t *)"y", 1);
+	ASSERT_EQ(0, rv);
+	rv = rope_delete(&restored, ROPE_BYTE, 0, 10);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(sizeof(buffer) - 10, rope_size(&restored, ROPE_BYTE));
+	check_integrity(restored.root);
+
+	rope_cleanup(&restored);
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_serialize_slow_leaf(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	struct Rope restored = {0};
+	struct RopeCursor cursor = {0};
+	uint8_t *data = NULL;
+	const size_t size = 4 * ROPE_STR_FAST_SIZE;
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&restored, &pool);
+	ASSERT_EQ(0, rv);
+
+	struct RopeNode *node = rope_node_new(&pool);
+	ASSERT_NOT_NULL(node);
+	rv = rope_str_alloc(&node->data.leaf, size, &data);
+	ASSERT_EQ(0, rv);
+	for (size_t i = 0; i < size; i++) {
+		data[i] = "abc\n"[i % 4];
+	}
+	rope_str_alloc_commit(&node->data.leaf, size);
+	rv = rope_cursor_init(&cursor, &rope);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_insert_node(&cursor, node);
+	ASSERT_EQ(0, rv);
+	rope_cursor_cleanup(&cursor);
+
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+	rv = rope_serialize(&rope, fd);
+	ASSERT_EQ(0, rv);
+	rv = rope_deserialize_fd(&restored, fd);
+	ASSERT_EQ(0, rv);
+	close(fd);
+
+	// The dimensions are restored, so the leaf is not scanned again.
+	node = next_filled(rope_node_first(restored.root));
+	struct RopeStr *leaf = &node->data.leaf;
+	ASSERT_TRUE(rope_str_is_slow(leaf));
+	ASSERT_EQ(size, leaf->data.heap.slow_dim[ROPE_BYTE]);
+	ASSERT_EQ(size / 4, leaf->data.heap.slow_dim[ROPE_LINE]);
+	ASSERT_EQ(size / 4 * 3, leaf->data.heap.slow_dim[ROPE_COLUMN]);
+	ASSERT_EQ(1u, leaf->data.heap.slow_last_char_size);
+
+	rope_cleanup(&restored);
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_serialize_compressed(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	char buffer[8192] = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < sizeof(buffer) - 1; i++) {
+		buffer[i] = 'a' + i / 512;
+	}
+	rv = rope_append_str(&rope, buffer);
+	ASSERT_EQ(0, rv);
+	size_t compressed = 0;
+	struct RopeNode *node = rope_node_first(rope.root);
+	for (; node; node = rope_node_next(node)) {
+		rv = rope_str_compress(&node->data.leaf, &pool.str_cache);
+		ASSERT_EQ(0, rv);
+		compressed += rope_str_is_compressed(&node->data.leaf);
+	}
+	ASSERT_LT(ROPE_STR_CACHE_SLOTS, compressed);
+
+	check_round_trip(&rope);
+
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_serialize_reject_garbage(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	char garbage[128] = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&rope, "Hello");
+	ASSERT_EQ(0, rv);
+
+	int fd = memfd_create("rope", MFD_CLOEXEC);
+	ASSERT_LE(0, fd);
+	memset(garbage, 0xff, sizeof(garbage));
+	ASSERT_EQ((ssize_t)sizeof(garbage), write(fd, garbage, sizeof(garbage)));
+
+	rv = rope_deserialize_fd(&rope, fd);
+	ASSERT_EQ(-ROPE_ERROR_INVALID_FORMAT, rv);
+	close(fd);
+
+	char *str = rope_to_str(&rope, 0);
+	ASSERT_STREQ("Hello", str);
+	free(str);
+
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_serialize_empty)
+TEST(test_serialize_round_trip)
+TEST(test_serialize_edit_restored)
+TEST(test_serialize_slow_leaf)
+TEST(test_serialize_compressed)
+TEST(test_serialize_reject_garbage)
+END_TESTS
@@ -440,6 +440,32 @@ test_str_slow_str(void) {
 	rope_str_cleanup(&str);
 }
 
+static void
+test_str_slow_str_trim(void) {
+	uint8_t buffer[4096];
+	for (size_t i = 0; i < sizeof(buffer); i += 4) {
+		memcpy(&buffer[i], "a\xc3\xa4\n", 4);
+	}
+	int rv = 0;
+	struct RopeStr str = {0};
+	rv = rope_str_init(&str, buffer, sizeof(buffer));
+	ASSERT_EQ(rv, 0);
+
+	ASSERT_EQ(sizeof(buffer) / 4 * 3, rope_str_size(&str, ROPE_CHAR));
+	ASSERT_EQ(sizeof(buffer) / 4, rope_str_size(&str, ROPE_LINE));
+
+	rv = rope_str_trim(&str, ROPE_LINE, 1, 500);
+	ASSERT_EQ(rv, 0);
+
+	ASSERT_EQ(500 * 4, rope_str_size(&str, ROPE_BYTE));
+	ASSERT_EQ(500 * 3, rope_str_size(&str, ROPE_CHAR));
+	ASSERT_EQ(500 * 3, rope_str_size(&str, ROPE_CP));
+	ASSERT_EQ(500, rope_str_size(&str, ROPE_LINE));
+	ASSERT_EQ(500 * 4 - 1, rope_str_last_char_index(&str));
+
+	rope_str_cleanup(&str);
+}
+
 static void
 test_str_should_stitch_utf8_break(void) {
 	const size_t split = 6;
@@ -490,6 +516,236 @@ test_str_should_stitch_utf8_grapheme_break(void) {
 	ASSERT_STREQ("World", (const char *)rope_str_data(&right, NULL) + 6);
 }
 
+static void
+test_str_columns(void) {
+	int rv = 0;
+	struct RopeStr str = {0};
+	// "a", tab, U+4E2D, U+1F600, "e" + U+0301, newline
+	const char data[] = "a\t\xe4\xb8\xad\xf0\x9f\x98\x80" "e\xcc\x81\n";
+	rv = rope_str_init(&str, (const uint8_t *)data, sizeof(data) - 1);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(6u, rope_str_size(&str, ROPE_COLUMN));
+	ASSERT_EQ(1u, rope_str_size(&str, ROPE_TAB));
+
+	ASSERT_EQ(0u, rope_str_column_to_byte(&str, 0, 4));
+	ASSERT_EQ(1u, rope_str_column_to_byte(&str, 4, 4));
+	ASSERT_EQ(2u, rope_str_column_to_byte(&str, 5, 4));
+	// Inside the wide character
+	ASSERT_EQ(2u, rope_str_column_to_byte(&str, 6, 4));
+	ASSERT_EQ(5u, rope_str_column_to_byte(&str, 7, 4));
+	ASSERT_EQ(9u, rope_str_column_to_byte(&str, 9, 4));
+
+	rope_str_cleanup(&str);
+}
+
+static void
+test_str_slow_str_columns(void) {
+	// U+4E2D repeated, too long for a normal string
+	uint8_t buffer[3 * 1024];
+	for (size_t i = 0; i < sizeof(buffer); i += 3) {
+		memcpy(&buffer[i], "\xe4\xb8\xad", 3);
+	}
+	int rv = 0;
+	struct RopeStr str = {0};
+	rv = rope_str_init(&str, buffer, sizeof(buffer));
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(2 * 1024u, rope_str_size(&str, ROPE_COLUMN));
+	ASSERT_EQ(0u, rope_str_size(&str, ROPE_TAB));
+
+	rope_str_cleanup(&str);
+}
+
+static void
+check_lz_round_trip(const uint8_t *data, size_t size) {
+	uint8_t compressed[8192];
+	uint8_t decompressed[4096];
+	int rv = 0;
+
+	const size_t compressed_size =
+			rope_lz_compress(data, size, compressed, sizeof(compressed));
+	ASSERT_LT(0u, compressed_size);
+	rv = rope_lz_decompress(compressed, compressed_size, decompressed, size);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0, memcmp(data, decompressed, size));
+}
+
+static void
+test_str_lz_round_trip(void) {
+	uint8_t buffer[4096] = {0};
+
+	check_lz_round_trip(buffer, 0);
+	check_lz_round_trip((const uint8_t *)"abc", 3);
+
+	memset(buffer, 'x', sizeof(buffer));
+	check_lz_round_trip(buffer, sizeof(buffer));
+
+	for (size_t i = 0; i < sizeof(buffer); i++) {
+		buffer[i] = "Hello\tWorld\n"[i % 12] + i / 1000;
+	}
+	check_lz_round_trip(buffer, sizeof(buffer));
+
+	uint32_t seed = 1;
+	for (size_t i = 0; i < sizeof(buffer); i++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[i] = seed >> 24;
+	}
+	check_lz_round_trip(buffer, sizeof(buffer));
+}
+
+static void
+test_str_lz_invalid(void) {
+	uint8_t buffer[64];
+	uint8_t compressed[64];
+	int rv = 0;
+	memset(buffer, 'x', sizeof(buffer));
+
+	const size_t size =
+			rope_lz_compress(buffer, sizeof(buffer), compressed, 64);
+	ASSERT_LT(0u, size);
+	ASSERT_EQ(0u, rope_lz_compress(buffer, sizeof(buffer), compressed, 2));
+
+	rv = rope_lz_decompress(compressed, size, buffer, sizeof(buffer) - 1);
+	ASSERT_EQ(-ROPE_ERROR_INVALID_FORMAT, rv);
+	rv = rope_lz_decompress(compressed, size - 1, buffer, sizeof(buffer));
+	ASSERT_EQ(-ROPE_ERROR_INVALID_FORMAT, rv);
+	// A match that refers to bytes in front of the output
+	const uint8_t bad_offset[] = {0x10, 'x', 0x02, 0x00};
+	rv = rope_lz_decompress(bad_offset, sizeof(bad_offset), buffer, 5);
+	ASSERT_EQ(-ROPE_ERROR_INVALID_FORMAT, rv);
+}
+
+static void
+test_str_compress(void) {
+	int rv = 0;
+	struct RopeStrCache cache = {0};
+	struct RopeStr str = {0};
+	struct RopeStr clone = {0};
+	uint8_t buffer[2 * 1024];
+	for (size_t i = 0; i < sizeof(buffer); i++) {
+		buffer[i] = i % 64 == 63 ? '\n' : 'a' + i % 7;
+	}
+	rv = rope_str_init(&str, buffer, sizeof(buffer));
+	ASSERT_EQ(0, rv);
+	const size_t lines = rope_str_size(&str, ROPE_LINE);
+
+	rv = rope_str_compress(&str, &cache);
+	ASSERT_EQ(0, rv);
+	ASSERT_TRUE(rope_str_is_compressed(&str));
+	ASSERT_EQ(sizeof(buffer), rope_str_size(&str, ROPE_BYTE));
+	ASSERT_EQ(lines, rope_str_size(&str, ROPE_LINE));
+
+	rv = rope_str_clone(&clone, &str);
+	ASSERT_EQ(0, rv);
+	rv = rope_str_trim(&clone, ROPE_LINE, 1, 2);
+	ASSERT_EQ(0, rv);
+	ASSERT_FALSE(rope_str_is_compressed(&clone));
+	ASSERT_TRUE(rope_str_is_compressed(&str));
+	size_t byte_size = 0;
+	const uint8_t *data = rope_str_data(&clone, &byte_size);
+	ASSERT_EQ(128u, byte_size);
+	ASSERT_EQ(0, memcmp(&buffer[64], data, byte_size));
+	rv = rope_str_compress(&clone, &cache);
+	ASSERT_EQ(0, rv);
+	ASSERT_TRUE(rope_str_is_compressed(&clone));
+
+	data = rope_str_data(&str, &byte_size);
+	ASSERT_TRUE(rope_str_is_compressed(&str));
+	ASSERT_EQ(sizeof(buffer), byte_size);
+	ASSERT_EQ(0, memcmp(buffer, data, byte_size));
+
+	// Strings that share the compressed data share its cache slot.
+	rope_str_cleanup(&clone);
+	rv = rope_str_clone(&clone, &str);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(data, rope_str_data(&clone, NULL));
+
+	rope_str_cleanup(&clone);
+	rope_str_cleanup(&str);
+}
+
+static void
+test_str_compress_cache(void) {
+	int rv = 0;
+	struct RopeStrCache cache = {0};
+	struct RopeStr strs[ROPE_STR_CACHE_SLOTS + 1] = {0};
+	uint8_t buffer[1024];
+	const uint8_t *data[ROPE_STR_CACHE_SLOTS + 1] = {0};
+
+	for (size_t i = 0; i <= ROPE_STR_CACHE_SLOTS; i++) {
+		memset(buffer, 'a' + i, sizeof(buffer));
+		rv = rope_str_init(&strs[i], buffer, sizeof(buffer));
+		ASSERT_EQ(0, rv);
+		rv = rope_str_compress(&strs[i], &cache);
+		ASSERT_EQ(0, rv);
+		ASSERT_TRUE(rope_str_is_compressed(&strs[i]));
+	}
+
+	// The data stays valid while fewer than ROPE_STR_CACHE_SLOTS other
+	// compressed strings are read.
+	for (size_t i = 0; i < ROPE_STR_CACHE_SLOTS; i++) {
+		data[i] = rope_str_data(&strs[i], NULL);
+	}
+	data[0] = rope_str_data(&strs[0], NULL);
+	data[ROPE_STR_CACHE_SLOTS] =
+			rope_str_data(&strs[ROPE_STR_CACHE_SLOTS], NULL);
+	ASSERT_EQ(data[1], data[ROPE_STR_CACHE_SLOTS]);
+	for (size_t i = 0; i <= ROPE_STR_CACHE_SLOTS; i++) {
+		if (i == 1) {
+			continue;
+		}
+		for (size_t j = 0; j < sizeof(buffer); j++) {
+			ASSERT_EQ('a' + i, data[i][j]);
+		}
+	}
+
+	// Released strings free their slot.
+	rope_str_cleanup(&strs[0]);
+	memset(buffer, 'x', sizeof(buffer));
+	rv = rope_str_init(&strs[0], buffer, sizeof(buffer));
+	ASSERT_EQ(0, rv);
+	rv = rope_str_compress(&strs[0], &cache);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ('x', rope_str_data(&strs[0], NULL)[0]);
+	ASSERT_EQ('a' + 2, data[2][0]);
+
+	// Strings larger than a slot are not compressed.
+	struct RopeStr large = {0};
+	uint8_t large_buffer[ROPE_NODE_COLD_LEAF_SIZE + 1] = {0};
+	rv = rope_str_init(&large, large_buffer, sizeof(large_buffer));
+	ASSERT_EQ(0, rv);
+	rv = rope_str_compress(&large, &cache);
+	ASSERT_EQ(0, rv);
+	ASSERT_FALSE(rope_str_is_compressed(&large));
+
+	rope_str_cleanup(&large);
+	for (size_t i = 0; i <= ROPE_STR_CACHE_SLOTS; i++) {
+		rope_str_cleanup(&strs[i]);
+	}
+}
+
+static void
+test_str_compress_incompressible(void) {
+	int rv = 0;
+	struct RopeStrCache cache = {0};
+	struct RopeStr str = {0};
+	uint8_t buffer[512];
+	uint32_t seed = 1;
+	for (size_t i = 0; i < sizeof(buffer); i++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[i] = seed >> 24;
+	}
+	rv = rope_str_init(&str, buffer, sizeof(buffer));
+	ASSERT_EQ(0, rv);
+
+	rv = rope_str_compress(&str, &cache);
+	ASSERT_EQ(0, rv);
+	ASSERT_FALSE(rope_str_is_compressed(&str));
+
+	rope_str_cleanup(&str);
+}
+
 DECLARE_TESTS
 TEST(test_str_init)
 TEST(test_str_split)
@@ -511,7 +767,15 @@ TEST(test_str_move_heap)
 TEST(test_str_freeable_inline)
 TEST(test_str_inline_append_overflow)
 TEST(test_str_slow_str)
+TEST(test_str_slow_str_trim)
 TEST(test_str_should_stitch_utf8_break)
 TEST(test_str_should_stitch_grapheme_break)
 TEST(test_str_should_stitch_utf8_grapheme_break)
+TEST(test_str_columns)
+TEST(test_str_slow_str_columns)
+TEST(test_str_lz_round_trip)
+TEST(test_str_lz_invalid)
+TEST(test_str_compress)
+TEST(test_str_compress_cache)
+TEST(test_str_compress_incompressible)
 END_TESTS
@@ -0,0 +1,93 @@
+#include <e_broadcast.h>
+#include <stdlib.h>
+#include <string.h>
+#include <testlib.h>
+
+#define RECIPIENTS 3
+
+static void
+test_broadcast_shared(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope message = {0};
+	struct Rope outputs[RECIPIENTS] = {0};
+	struct EBroadcast broadcast = {0};
+	char data[5000];
+	char expected[sizeof(data) + 16];
+
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = 'a' + i % 26;
+	}
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&message, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append(&message, (const uint8_t *)data, sizeof(data));
+	ASSERT_EQ(0, rv);
+
+	rv = e_broadcast_init(&broadcast, &message);
+	ASSERT_EQ(0, rv);
+	rope_cleanup(&message);
+
+	for (size_t i = 0; i < RECIPIENTS; i++) {
+		rv = rope_init(&outputs[i], &pool);
+		ASSERT_EQ(0, rv);
+		rv = rope_append_str(&outputs[i], "pong\n");
+		ASSERT_EQ(0, rv);
+		rv = e_broadcast_queue(&broadcast, &outputs[i]);
+		ASSERT_EQ(0, rv);
+		rv = rope_append_str(&outputs[i], "pong\n");
+		ASSERT_EQ(0, rv);
+	}
+	e_broadcast_cleanup(&broadcast);
+
+	for (size_t i = 0; i < RECIPIENTS; i++) {
+		struct RopeStats stats = {0};
+		rope_stats(&outputs[i], &stats);
+		// The message is shared by all outputs.
+		ASSERT_EQ(sizeof(data), stats.shared_bytes);
+	}
+
+	memcpy(expected, "pong\n", 5);
+	memcpy(&expected[5], data, sizeof(data));
+	memcpy(&expected[5 + sizeof(data)], "pong\n", 6);
+	for (size_t i = 0; i < RECIPIENTS; i++) {
+		char *str = rope_to_str(&outputs[i], 0);
+		ASSERT_STREQ(expected, str);
+		free(str);
+		rope_cleanup(&outputs[i]);
+	}
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_broadcast_empty(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope message = {0};
+	struct Rope output = {0};
+	struct EBroadcast broadcast = {0};
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&message, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&output, &pool);
+	ASSERT_EQ(0, rv);
+
+	rv = e_broadcast_init(&broadcast, &message);
+	ASSERT_EQ(0, rv);
+	rv = e_broadcast_queue(&broadcast, &output);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0, rope_size(&output, ROPE_BYTE));
+
+	e_broadcast_cleanup(&broadcast);
+	rope_cleanup(&output);
+	rope_cleanup(&message);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_broadcast_shared)
+TEST(test_broadcast_empty)
+END_TESTS
@@ -0,0 +1,87 @@
+#include <e_command.h>
+#include <string.h>
+#include <testlib.h>
+
+static const char *const names[] = {
+#define DEF(cmd) #cmd,
+#include <e_command.def.h>
+#undef DEF
+};
+
+static enum ECommandId
+lookup(struct Rope *rope, const char *name) {
+	int rv = 0;
+	struct RopeRange range = {0};
+
+	rope_clear(rope);
+	rv = rope_append_str(rope, name);
+	ASSERT_EQ(0, rv);
+	rv = rope_to_range(rope, &range);
+	ASSERT_EQ(0, rv);
+	const enum ECommandId command = e_command_lookup(&range);
+	rope_range_cleanup(&range);
+	return command;
+}
+
+static void
+test_command_lookup(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < E_COMMAND_COUNT; i++) {
+		ASSERT_EQ(i, lookup(&rope, names[i]));
+	}
+	ASSERT_EQ(E_COMMAND_ping, lookup(&rope, "ping"));
+	ASSERT_EQ(E_COMMAND_COUNT, lookup(&rope, ""));
+	ASSERT_EQ(E_COMMAND_COUNT, lookup(&rope, "pin"));
+	ASSERT_EQ(E_COMMAND_COUNT, lookup(&rope, "pingg"));
+	ASSERT_EQ(E_COMMAND_COUNT, lookup(&rope, "a very long command name"));
+
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_command_lookup_leaves(void) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope rope = {0};
+	struct RopeRange range = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&rope, &pool);
+	ASSERT_EQ(0, rv);
+
+	// Large data is split into leaves, so the name spans two of them.
+	char data[ROPE_STR_FAST_SIZE * 2];
+	const size_t offset = ROPE_STR_FAST_SIZE - 4;
+	memset(data, 'x', sizeof(data));
+	memcpy(&data[offset], "shutdown", 8);
+	rv = rope_append(&rope, (const uint8_t *)data, sizeof(data));
+	ASSERT_EQ(0, rv);
+
+	rv = rope_to_range(&rope, &range);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(rope_range_end(&range), ROPE_BYTE, offset + 8, 0);
+	ASSERT_EQ(0, rv);
+	rv = rope_cursor_move_to(rope_range_start(&range), ROPE_BYTE, offset, 0);
+	ASSERT_EQ(0, rv);
+	size_t index = 0;
+	struct RopeNode *node = rope_cursor_node(rope_range_start(&range), &index);
+	ASSERT_GT(strlen("shutdown"), rope_node_size(node, ROPE_BYTE) - index);
+	ASSERT_EQ(E_COMMAND_shutdown, e_command_lookup(&range));
+
+	rope_range_cleanup(&range);
+	rope_cleanup(&rope);
+	rope_pool_cleanup(&pool);
+}
+
+DECLARE_TESTS
+TEST(test_command_lookup)
+TEST(test_command_lookup_leaves)
+END_TESTS
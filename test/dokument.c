@@ -0,0 +1,99 @@
+#include <e_dokument.h>
+#include <e_klient.h>
+#include <e_konstrukt.h>
+#include <e_struktur.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <testlib.h>
+#include <unistd.h>
+
+static int
+new_klient(struct EKonstrukt *k, union EStruktur *klient) {
+	int fds[2] = {0};
+	int rv = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	ASSERT_EQ(0, rv);
+	rv = e_klient_new(klient, k, fds[0], fds[0]);
+	ASSERT_EQ(0, rv);
+	return fds[1];
+}
+
+static void
+assert_content(union EStruktur *dokument, const char *expected) {
+	char *content = rope_to_str(&dokument->dokument->content, 0);
+	ASSERT_STREQ(expected, content);
+	free(content);
+}
+
+static void
+test_dokument_concurrent_edits(void) {
+	int rv = 0;
+	struct EKonstrukt k = {0};
+	union EStruktur dokument = {0};
+	union EStruktur first = {0};
+	union EStruktur second = {0};
+	struct RopeHistory *history = NULL;
+
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_dokument_new(&dokument, &k);
+	ASSERT_EQ(0, rv);
+	history = &dokument.dokument->history;
+	int first_fd = new_klient(&k, &first);
+	int second_fd = new_klient(&k, &second);
+	rv = e_dokument_join(&dokument, &first);
+	ASSERT_EQ(0, rv);
+	rv = e_dokument_join(&dokument, &second);
+	ASSERT_EQ(0, rv);
+
+	const struct RopeHistoryEdit hello = {
+			.data = (const uint8_t *)"hello", .byte_size = 5};
+	rv = e_dokument_edit(&dokument, &first, 0, &hello, 1);
+	ASSERT_EQ(0, rv);
+
+	// Both klients edit revision 1 without seeing each other.
+	const struct RopeHistoryEdit prefix = {
+			.data = (const uint8_t *)"A", .byte_size = 1};
+	const struct RopeHistoryEdit suffix = {
+			.index = 5, .data = (const uint8_t *)"!", .byte_size = 1};
+	rv = e_dokument_edit(&dokument, &first, 1, &prefix, 1);
+	ASSERT_EQ(0, rv);
+	rv = e_dokument_edit(&dokument, &second, 1, &suffix, 1);
+	ASSERT_EQ(0, rv);
+	assert_content(&dokument, "Ahello!");
+	ASSERT_EQ(3u, rope_history_revision(history));
+	ASSERT_EQ(1u, history->first_revision);
+
+	// The history is kept until every klient has seen it.
+	rv = e_dokument_acknowledge(&dokument, &first, 3);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, history->first_revision);
+	rv = e_dokument_acknowledge(&dokument, &second, 4);
+	ASSERT_EQ(-EINVAL, rv);
+	rv = e_dokument_acknowledge(&dokument, &second, 3);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(3u, history->first_revision);
+	ASSERT_EQ(0u, history->log.count);
+	rv = e_dokument_edit(&dokument, &second, 1, &suffix, 1);
+	ASSERT_GT(0, rv);
+	assert_content(&dokument, "Ahello!");
+
+	// Klients that left don't hold the history back.
+	rv = e_dokument_edit(&dokument, &first, 3, &prefix, 1);
+	ASSERT_EQ(0, rv);
+	close(second_fd);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, k.klient_count);
+	rv = e_dokument_acknowledge(&dokument, &first, 4);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(4u, history->first_revision);
+	assert_content(&dokument, "AAhello!");
+
+	close(first_fd);
+	e_cleanup(&k);
+}
+
+DECLARE_TESTS
+TEST(test_dokument_concurrent_edits)
+END_TESTS
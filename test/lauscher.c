@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+
+#include <e_command.h>
+#include <e_konstrukt.h>
+#include <e_lauscher.h>
+#include <e_struktur.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <testlib.h>
+#include <unistd.h>
+
+static const struct ECommand commands[E_COMMAND_COUNT] = {
+		[E_COMMAND_ping] = {.name = "ping", .function = e_command_ping},
+		[E_COMMAND_stats] = {.name = "stats", .function = e_command_stats},
+};
+
+#define OUTPUT_MESSAGE_SIZE (128 * 1024)
+
+static int
+connect_klient(const char *path) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	strcpy(addr.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	ASSERT_LE(0, fd);
+	int rv = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+	ASSERT_EQ(0, rv);
+	return fd;
+}
+
+static void
+test_lauscher_klients(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	char reply[16] = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+
+	int first = connect_klient(path);
+	int second = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(2u, k.klient_count);
+
+	ASSERT_EQ(5, write(second, "ping\n", 5));
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(5, read(second, reply, sizeof(reply)));
+	ASSERT_STREQ("pong\n", reply);
+
+	close(first);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, k.klient_count);
+
+	close(second);
+	e_cleanup(&k);
+	ASSERT_EQ(-1, access(path, F_OK));
+	rmdir(dir);
+}
+
+static void
+test_lauscher_fairness(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	char pings[1000 * 5];
+	char reply[sizeof(pings)] = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+
+	int chatty = connect_klient(path);
+	int quiet = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+
+	for (size_t i = 0; i < sizeof(pings); i += 5) {
+		memcpy(&pings[i], "ping\n", 5);
+	}
+	ASSERT_EQ((ssize_t)sizeof(pings), write(chatty, pings, sizeof(pings)));
+	ASSERT_EQ(5, write(quiet, "ping\n", 5));
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+
+	// The chatty klient is deferred and the quiet one still gets its turn.
+	ASSERT_EQ(5, recv(quiet, reply, sizeof(reply), MSG_DONTWAIT));
+	ASSERT_EQ(1u, k.deferred_count);
+	ssize_t size = recv(chatty, reply, sizeof(reply), MSG_DONTWAIT);
+	ASSERT_LT(0, size);
+	ASSERT_GT((ssize_t)sizeof(pings), size);
+
+	while (k.deferred_count > 0) {
+		rv = e_handle_event(&k);
+		ASSERT_EQ(0, rv);
+	}
+	for (;;) {
+		const ssize_t rest =
+				recv(chatty, &reply[size], sizeof(reply) - size, MSG_DONTWAIT);
+		if (rest <= 0) {
+			break;
+		}
+		size += rest;
+	}
+	ASSERT_EQ((ssize_t)sizeof(pings), size);
+
+	close(chatty);
+	close(quiet);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+test_lauscher_out_of_fds(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	struct rlimit limit = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+	int fd = connect_klient(path);
+
+	// The connection waits in the backlog while accept() fails.
+	ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &limit));
+	struct rlimit exhausted = limit;
+	exhausted.rlim_cur = dup(fd);
+	close(exhausted.rlim_cur);
+	ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &exhausted));
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0u, k.klient_count);
+	ASSERT_EQ(1u, k.deferred_count);
+
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(1u, k.klient_count);
+
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+test_lauscher_in_use(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	union EStruktur failed = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+
+	// A failed lauscher is released and leaves the bound socket alone.
+	rv = e_lauscher_new(&failed, &k, path);
+	ASSERT_EQ(-EADDRINUSE, rv);
+	ASSERT_NULL(failed.any);
+	ASSERT_EQ(1u, k.lauscher_count);
+	int fd = connect_klient(path);
+
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+output_notify(union EStruktur *klient) {
+	int rv = 0;
+	struct EBroadcast broadcast = {0};
+	uint8_t *data = NULL;
+
+	// A single leaf, as appending large data to a rope is slow.
+	rv = rope_str_alloc(&broadcast.message, OUTPUT_MESSAGE_SIZE, &data);
+	ASSERT_EQ(0, rv);
+	memset(data, 0, OUTPUT_MESSAGE_SIZE);
+	rope_str_alloc_commit(&broadcast.message, OUTPUT_MESSAGE_SIZE);
+	rv = klient->base->type->notify(klient, &broadcast);
+	ASSERT_EQ(0, rv);
+
+	e_broadcast_cleanup(&broadcast);
+}
+
+/*
+ * Reads from `fd` until `size` bytes arrived and returns the last ones in
+ * `tail`.
+ */
+static void
+output_drain(struct EKonstrukt *k, int fd, size_t size, char *tail) {
+	static char buffer[64 * 1024];
+	size_t received = 0;
+
+	while (received < size) {
+		const ssize_t rv = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (rv < 0) {
+			ASSERT_EQ(EAGAIN, errno);
+			ASSERT_EQ(0, e_handle_event(k));
+			continue;
+		}
+		ASSERT_LT(0, rv);
+		received += rv;
+		if (rv >= 16) {
+			memcpy(tail, &buffer[rv - 16], 16);
+		} else {
+			memmove(tail, &tail[rv], 16 - rv);
+			memcpy(&tail[16 - rv], buffer, rv);
+		}
+	}
+	ASSERT_EQ(size, received);
+}
+
+static void
+test_lauscher_output_coalesce(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	union EStruktur klient = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	char tail[16] = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	k.output_high_mark = 64 * 1024;
+	k.output_low_mark = 16 * 1024;
+	k.output_policy = E_OUTPUT_COALESCE;
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+	int fd = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	rv = e_list_get(&klient, &k, &k.klients, 0);
+	ASSERT_EQ(0, rv);
+	// Most of a message stays in the output buffer.
+	const int sndbuf = 16 * 1024;
+	rv = setsockopt(
+			klient.klient->writer_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+			sizeof(sndbuf));
+	ASSERT_EQ(0, rv);
+
+	output_notify(&klient);
+	ASSERT_TRUE(klient.klient->lagging);
+	// Both are replaced by a single resync.
+	output_notify(&klient);
+	output_notify(&klient);
+	ASSERT_EQ(2u, klient.klient->coalesced_count);
+
+	output_drain(&k, fd, OUTPUT_MESSAGE_SIZE + 7, tail);
+	ASSERT_STREQS("resync\n", &tail[9], 7);
+	ASSERT_FALSE(klient.klient->lagging);
+	ASSERT_LE((size_t)OUTPUT_MESSAGE_SIZE, klient.klient->output_peak);
+
+	e_struktur_release(&klient);
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+test_lauscher_output_pause(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	union EStruktur klient = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	char tail[16] = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	k.output_high_mark = 64 * 1024;
+	k.output_low_mark = 16 * 1024;
+	k.output_policy = E_OUTPUT_PAUSE;
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+	int fd = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	rv = e_list_get(&klient, &k, &k.klients, 0);
+	ASSERT_EQ(0, rv);
+	// Most of a message stays in the output buffer.
+	const int sndbuf = 16 * 1024;
+	rv = setsockopt(
+			klient.klient->writer_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+			sizeof(sndbuf));
+	ASSERT_EQ(0, rv);
+
+	output_notify(&klient);
+	ASSERT_TRUE(klient.klient->lagging);
+	struct Rope *output = &klient.klient->output_buffer;
+	const size_t size = rope_size(output, ROPE_BYTE);
+	ASSERT_EQ(5, write(fd, "ping\n", 5));
+	ASSERT_EQ(0, e_handle_event(&k));
+	// The ping waits until the klient read its output.
+	ASSERT_EQ(size, rope_size(output, ROPE_BYTE));
+
+	output_drain(&k, fd, OUTPUT_MESSAGE_SIZE + 5, tail);
+	ASSERT_STREQS("pong\n", &tail[11], 5);
+	ASSERT_EQ(0u, rope_size(&klient.klient->input_buffer, ROPE_BYTE));
+
+	e_struktur_release(&klient);
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+test_lauscher_output_disconnect(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	union EStruktur klient = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	k.output_high_mark = 64 * 1024;
+	k.output_low_mark = 16 * 1024;
+	k.output_policy = E_OUTPUT_DISCONNECT;
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+	int fd = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+	rv = e_list_get(&klient, &k, &k.klients, 0);
+	ASSERT_EQ(0, rv);
+	// Most of a message stays in the output buffer.
+	const int sndbuf = 16 * 1024;
+	rv = setsockopt(
+			klient.klient->writer_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+			sizeof(sndbuf));
+	ASSERT_EQ(0, rv);
+
+	output_notify(&klient);
+	ASSERT_TRUE(klient.klient->overflowed);
+	ASSERT_EQ(0u, rope_size(&klient.klient->output_buffer, ROPE_BYTE));
+	e_struktur_release(&klient);
+
+	ASSERT_EQ(0, e_handle_event(&k));
+	ASSERT_EQ(0u, k.klient_count);
+
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+static void
+test_lauscher_stats(void) {
+	int rv = 0;
+	struct EKonstrukt k = {.commands = commands};
+	union EStruktur lauscher = {0};
+	char dir[] = "/tmp/e-test-XXXXXX";
+	char path[64];
+	char reply[128] = {0};
+
+	ASSERT_NOT_NULL(mkdtemp(dir));
+	snprintf(path, sizeof(path), "%s/socket", dir);
+	rv = e_init(&k, 0, NULL);
+	ASSERT_EQ(0, rv);
+	rv = e_lauscher_new(&lauscher, &k, path);
+	ASSERT_EQ(0, rv);
+	int fd = connect_klient(path);
+	rv = e_handle_event(&k);
+	ASSERT_EQ(0, rv);
+
+	ASSERT_EQ(6, write(fd, "stats\n", 6));
+	ASSERT_EQ(0, e_handle_event(&k));
+	ASSERT_LT(0, read(fd, reply, sizeof(reply) - 1));
+	ASSERT_STREQS("stats 1\nklient ", reply, 15);
+
+	close(fd);
+	e_cleanup(&k);
+	rmdir(dir);
+}
+
+DECLARE_TESTS
+TEST(test_lauscher_klients)
+TEST(test_lauscher_fairness)
+TEST(test_lauscher_in_use)
+TEST(test_lauscher_out_of_fds)
+TEST(test_lauscher_output_coalesce)
+TEST(test_lauscher_output_pause)
+TEST(test_lauscher_output_disconnect)
+TEST(test_lauscher_stats)
+END_TESTS
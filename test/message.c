@@ -1,5 +1,6 @@
 #include <e_konstrukt.h>
 #include <e_struktur.h>
+#include <stdio.h>
 #include <testlib.h>
 #include <string.h>
 
@@ -242,6 +243,55 @@ test_message_parse_escape_quoted(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_message_parse_escape_long(void) {
+	int rv = 0;
+	char data[256];
+	char expected[256];
+
+	struct RopePool pool = {0};
+	struct Rope message = {0};
+	struct EMessageParser parser = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_init(&message, &pool);
+	ASSERT_EQ(0, rv);
+
+	// Longer than an inline leaf and spread over several leaves.
+	memset(data, 'a', 100);
+	memset(expected, 'a', 100);
+	strcpy(&data[100], "\\tb");
+	strcpy(&expected[100], "\tb");
+	for (size_t i = 0; i < 4; i++) {
+		rv = rope_append_str(&message, data);
+		ASSERT_EQ(0, rv);
+	}
+	rv = rope_append_str(&message, "\n");
+	ASSERT_EQ(0, rv);
+
+	rv = e_message_parser_init(&parser, &message);
+	ASSERT_EQ(0, rv);
+
+	struct RopeRange field = {0};
+	bool has_next = e_message_parser_next(&parser, &field, &rv);
+	ASSERT_TRUE(has_next);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(&parser.unescape_buffer, field.rope);
+	ASSERT_TRUE(ROPE_NODE_IS_LEAF(parser.unescape_buffer.root));
+	char *buf = rope_range_to_cstr(&field, 0);
+	ASSERT_EQ(4 * 102, strlen(buf));
+	for (size_t i = 0; i < 4; i++) {
+		ASSERT_STREQS(expected, &buf[i * 102], 102);
+	}
+	free(buf);
+	rope_range_cleanup(&field);
+
+	e_message_parser_cleanup(&parser);
+	rope_cleanup(&message);
+	rope_pool_cleanup(&pool);
+}
+
 static void
 test_message_parse_sized(void) {
 	int rv = 0;
@@ -433,6 +483,67 @@ test_message_parse_multiple_spaces(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_message_parse_terminator(void) {
+	int rv = 0;
+
+	struct RopePool pool = {0};
+	struct Rope message = {0};
+	struct EMessageParser parser = {0};
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_init(&message, &pool);
+	ASSERT_EQ(0, rv);
+
+	rv = rope_append_str(&message, "set @EOF a\\tb\nline 1\n@EOFx\n");
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&message, "line 2\n@EOF\n");
+	ASSERT_EQ(0, rv);
+
+	rv = e_message_parser_init(&parser, &message);
+	ASSERT_EQ(0, rv);
+
+	bool has_next = false;
+	struct RopeRange field = {0};
+
+	has_next = e_message_parser_next(&parser, &field, &rv);
+	ASSERT_TRUE(has_next);
+	ASSERT_EQ(0, rv);
+	// Fields without escapes point into the message.
+	ASSERT_EQ(&message, field.rope);
+	char *buf = rope_range_to_cstr(&field, 0);
+	ASSERT_STREQ("set", buf);
+	free(buf);
+
+	has_next = e_message_parser_next(&parser, &field, &rv);
+	ASSERT_TRUE(has_next);
+	ASSERT_EQ(0, rv);
+	buf = rope_range_to_cstr(&field, 0);
+	ASSERT_STREQ("line 1\n@EOFx\nline 2\n", buf);
+	free(buf);
+
+	has_next = e_message_parser_next(&parser, &field, &rv);
+	ASSERT_TRUE(has_next);
+	ASSERT_EQ(0, rv);
+	buf = rope_range_to_cstr(&field, 0);
+	ASSERT_STREQ("a\tb", buf);
+	free(buf);
+
+	has_next = e_message_parser_next(&parser, &field, &rv);
+	ASSERT_FALSE(has_next);
+	ASSERT_EQ(0, rv);
+	rope_range_cleanup(&field);
+
+	rv = e_message_parse_consume(&parser);
+	ASSERT_EQ(0, rv);
+	ASSERT_EQ(0, rope_size(&message, ROPE_BYTE));
+
+	e_message_parser_cleanup(&parser);
+	rope_cleanup(&message);
+	rope_pool_cleanup(&pool);
+}
+
 static void
 test_message_parse_missing_newline(void) {
 	int rv = 0;
@@ -511,16 +622,139 @@ test_message_parse_sized_missing_newline(void) {
 	rope_pool_cleanup(&pool);
 }
 
+static void
+test_message_framer(void) {
+	int rv = 0;
+	const char *messages[] = {
+			"ping\n",
+			"\"a\\\" @5\" 'b\\n' x\\ @y\n",
+			"set @3 @EOF @2x\nabc\nline\n@EOFx\n@EOF\nde\n",
+			"sized @0\n\n",
+			"\n",
+	};
+	struct EMessageFramer framer = {0};
+	e_message_framer_init(&framer);
+
+	for (size_t i = 0; i < sizeof(messages) / sizeof(*messages); i++) {
+		const uint8_t *data = (const uint8_t *)messages[i];
+		const size_t size = strlen(messages[i]);
+		size_t consumed = 0;
+
+		// Byte by byte, like from many short reads.
+		for (size_t j = 0; j < size; j++) {
+			rv = e_message_framer_feed(&framer, &data[j], 1, &consumed);
+			ASSERT_EQ(j == size - 1 ? 1 : 0, rv);
+			ASSERT_EQ(1, consumed);
+		}
+		ASSERT_EQ(size, framer.size);
+		e_message_framer_reset(&framer);
+
+		// The message stops in front of the next one.
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "%sping\n", messages[i]);
+		rv = e_message_framer_feed(
+				&framer, (const uint8_t *)buffer, strlen(buffer), &consumed);
+		ASSERT_EQ(1, rv);
+		ASSERT_EQ(size, consumed);
+		e_message_framer_reset(&framer);
+	}
+
+	e_message_framer_cleanup(&framer);
+}
+
+static void
+test_message_framer_size_overflow(void) {
+	int rv = 0;
+	char buffer[64];
+	size_t consumed = 0;
+	struct EMessageFramer framer = {0};
+	e_message_framer_init(&framer);
+
+	snprintf(buffer, sizeof(buffer), "set @%zu\n", SIZE_MAX);
+	rv = e_message_framer_feed(
+			&framer, (const uint8_t *)buffer, strlen(buffer), &consumed);
+	ASSERT_EQ(0, rv);
+	e_message_framer_reset(&framer);
+
+	// One more than SIZE_MAX.
+	buffer[strlen(buffer) - 2]++;
+	rv = e_message_framer_feed(
+			&framer, (const uint8_t *)buffer, strlen(buffer), &consumed);
+	ASSERT_EQ(-1, rv);
+
+	e_message_framer_cleanup(&framer);
+}
+
+/*
+ * Frames `data` and parses it with the payload offsets of the framer.
+ */
+static void
+check_framed(const char *data, const char **fields, size_t count, int error) {
+	int rv = 0;
+	struct RopePool pool = {0};
+	struct Rope message = {0};
+	struct EMessageFramer framer = {0};
+	struct EMessageParser parser = {0};
+	struct RopeRange field = {0};
+	size_t consumed = 0;
+	size_t i = 0;
+
+	rv = rope_pool_init(&pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_init(&message, &pool);
+	ASSERT_EQ(0, rv);
+	rv = rope_append_str(&message, data);
+	ASSERT_EQ(0, rv);
+	e_message_framer_init(&framer);
+	rv = e_message_framer_feed(
+			&framer, (const uint8_t *)data, strlen(data), &consumed);
+	ASSERT_EQ(1, rv);
+
+	rv = e_message_parser_init_framed(&parser, &message, &framer);
+	ASSERT_EQ(0, rv);
+	while (e_message_parser_next(&parser, &field, &rv) && rv == 0) {
+		ASSERT_GT(count, i);
+		char *buf = rope_range_to_cstr(&field, 0);
+		ASSERT_STREQ(fields[i], buf);
+		free(buf);
+		i++;
+	}
+	ASSERT_EQ(error, rv);
+	ASSERT_EQ(count, i);
+
+	rope_range_cleanup(&field);
+	e_message_parser_cleanup(&parser);
+	e_message_framer_cleanup(&framer);
+	rope_cleanup(&message);
+	rope_pool_cleanup(&pool);
+}
+
+static void
+test_message_parse_framed(void) {
+	const char *fields[] = {"set", "abc", "line\n@EOFx\n", "de", "x"};
+	check_framed(
+			"set @3 @EOF @2x\nabc\nline\n@EOFx\n@EOF\nde\n", fields, 5, 0);
+
+	// The framer doesn't check the newline behind sized payloads.
+	const char *missing_newline[] = {"abc"};
+	check_framed("abc @5\nabcdeX", missing_newline, 1, -1);
+}
+
 DECLARE_TESTS
 TEST(test_message_parse_field)
 TEST(test_message_parse_double_quoted)
 TEST(test_message_parse_single_quoted)
 TEST(test_message_parse_escape_unquoted)
 TEST(test_message_parse_escape_quoted)
+TEST(test_message_parse_escape_long)
 TEST(test_message_parse_sized)
 TEST(test_message_parse_mixed)
 TEST(test_message_parse_empty)
 TEST(test_message_parse_multiple_spaces)
+TEST(test_message_parse_terminator)
 TEST(test_message_parse_missing_newline)
 TEST(test_message_parse_sized_missing_newline)
+TEST(test_message_framer)
+TEST(test_message_framer_size_overflow)
+TEST(test_message_parse_framed)
 END_TESTS